@@ -0,0 +1,370 @@
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <stats.h>
+#include <utils.h>
+
+namespace Utils {
+  bool g_use_colors = true;
+  unsigned g_timer_period = 1;
+};
+
+using namespace std;
+
+// Runs a fixed matrix of (domain, arguments) entries on the domain binaries
+// with warmups and repetitions, and reports for each entry the wall-clock
+// time, throughput (backups, expansions and decisions per second of the
+// time.raw reported by the binary), number of states and peak RSS. Each
+// line of the matrix is
+//
+//   <name> <domain> <argument>*
+//
+// where the binary is <root>/<domain>/<domain> and the arguments are the
+// ones given to it (seed, requests and instance). Lines starting with #
+// are comments. Stats are read back from the binary with --stats csv.
+//
+// With --baseline <file>, the median times are compared with the ones in
+// the stats lines of a previous run, and entries slower by more than the
+// threshold are reported as regressions (exit status 1). With --no-stats,
+// binaries are run without --stats, for binaries of older revisions that
+// predate it, and only wall-clock times and peak RSS are reported.
+
+struct entry_t {
+    string name_;
+    string domain_;
+    vector<string> arguments_;
+};
+
+// fields of the records written by one run of a binary
+struct run_t {
+    double wall_time_;
+    long peak_rss_;     // in KB
+    double time_raw_;
+    double backups_;
+    double expansions_;
+    double decisions_;
+    double states_;
+    run_t()
+      : wall_time_(0), peak_rss_(0), time_raw_(0),
+        backups_(0), expansions_(0), decisions_(0), states_(0) {
+    }
+    bool operator<(const run_t &run) const { return wall_time_ < run.wall_time_; }
+};
+
+bool read_matrix(const string &filename, vector<entry_t> &entries) {
+    ifstream is(filename.c_str());
+    if( !is ) return false;
+    string line;
+    while( getline(is, line) ) {
+        istringstream iss(line);
+        entry_t entry;
+        if( !(iss >> entry.name_) || (entry.name_[0] == '#') ) continue;
+        if( !(iss >> entry.domain_) ) {
+            cout << Utils::error() << "missing domain for '" << entry.name_ << "' in '" << filename << "'" << endl;
+            return false;
+        }
+        for( string argument; iss >> argument; )
+            entry.arguments_.push_back(argument);
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+// split a line of CSV into cells, removing quotes
+void split_csv(const string &line, vector<string> &cells) {
+    cells.clear();
+    string cell;
+    bool quoted = false;
+    for( int i = 0, isz = line.size(); i < isz; ++i ) {
+        char c = line[i];
+        if( quoted ) {
+            if( (c == '"') && (i + 1 < isz) && (line[i + 1] == '"') ) {
+                cell += c;
+                ++i;
+            } else if( c == '"' ) {
+                quoted = false;
+            } else {
+                cell += c;
+            }
+        } else if( c == '"' ) {
+            quoted = true;
+        } else if( c == ',' ) {
+            cells.push_back(cell);
+            cell.clear();
+        } else {
+            cell += c;
+        }
+    }
+    cells.push_back(cell);
+}
+
+// add up the figures of all solve and eval records in the stats file
+bool read_stats(const string &filename, run_t &run) {
+    ifstream is(filename.c_str());
+    if( !is ) return false;
+    string line;
+    vector<string> cells;
+    getline(is, line);
+    while( getline(is, line) ) {
+        split_csv(line, cells);
+        if( cells.size() != 5 ) continue;
+        const string &type = cells[1], &key = cells[3];
+        double value = strtod(cells[4].c_str(), 0);
+        if( (type != "solve") && (type != "eval") ) continue;
+        if( key == "time.raw" )
+            run.time_raw_ += value;
+        else if( key == "hash.updates" )
+            run.backups_ += value;
+        else if( key == "problem.expansions" )
+            run.expansions_ += value;
+        else if( key == "other.decisions" )
+            run.decisions_ += value;
+        else if( key == "hash.size" )
+            run.states_ += value;
+    }
+    return true;
+}
+
+// run the binary of the entry with output discarded; returns false if
+// it couldn't be run or didn't exit normally
+bool run_entry(const string &root, const entry_t &entry, bool stats, run_t &run) {
+    string binary = root + "/" + entry.domain_ + "/" + entry.domain_;
+    char stats_file[] = "/tmp/bench-stats-XXXXXX";
+    int fd = mkstemp(stats_file);
+    if( fd == -1 ) {
+        cout << Utils::error() << "cannot create temporary file: " << strerror(errno) << endl;
+        return false;
+    }
+    close(fd);
+
+    vector<string> arguments;
+    arguments.push_back(binary);
+    arguments.push_back("--no-colors");
+    if( stats ) {
+        arguments.push_back("--stats");
+        arguments.push_back(string("csv:") + stats_file);
+    }
+    arguments.insert(arguments.end(), entry.arguments_.begin(), entry.arguments_.end());
+    vector<char*> argv;
+    for( int i = 0, isz = arguments.size(); i < isz; ++i )
+        argv.push_back(const_cast<char*>(arguments[i].c_str()));
+    argv.push_back(0);
+
+    double start_time = Utils::read_monotonic_time();
+    pid_t pid = fork();
+    if( pid == 0 ) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, 1);
+        execv(binary.c_str(), &argv[0]);
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    bool ok = (pid != -1) && (wait4(pid, &status, 0, &usage) == pid);
+    run.wall_time_ = Utils::read_monotonic_time() - start_time;
+    ok = ok && WIFEXITED(status) && (WEXITSTATUS(status) == 0) && (!stats || read_stats(stats_file, run));
+    if( ok ) run.peak_rss_ = usage.ru_maxrss;
+    unlink(stats_file);
+
+    if( !ok ) {
+        cout << Utils::error() << "run of '" << entry.name_ << "' failed:";
+        for( int i = 0, isz = arguments.size(); i < isz; ++i )
+            cout << " " << arguments[i];
+        cout << endl;
+    }
+    return ok;
+}
+
+// median times by entry name in the stats lines of a previous run
+bool read_baseline(const string &filename, map<string, double> &baseline) {
+    ifstream is(filename.c_str());
+    if( !is ) return false;
+    string line;
+    while( getline(is, line) ) {
+        if( (line.find("stats:") == string::npos) || (line.find(" type=bench ") == string::npos) ) continue;
+        istringstream iss(line);
+        string name, token;
+        double time = -1;
+        while( iss >> token ) {
+            if( token.compare(0, 5, "name=") == 0 )
+                name = token.substr(5);
+            else if( token.compare(0, 5, "time=") == 0 )
+                time = strtod(token.substr(5).c_str(), 0);
+        }
+        if( !name.empty() && (time >= 0) ) baseline[name] = time;
+    }
+    return true;
+}
+
+void usage(ostream &os) {
+    os << "usage: bench [--no-colors] [--root <dir>] [{-w | --warmups} <n>] [{-n | --repetitions} <n>] [--only <name-prefix>] [--baseline <file>] [--threshold <fraction>] [--no-stats] [--stats {json | csv}:{<file> | -}] <matrix>" << endl;
+}
+
+int main(int argc, const char **argv) {
+    string root = "..";
+    unsigned warmups = 1;
+    unsigned repetitions = 3;
+    string only;
+    string baseline_file;
+    float threshold = 0.1;
+    bool stats = true;
+    Stats::sink_t *sink = 0;
+    cout << fixed;
+
+    // parse arguments
+    for( ++argv, --argc; (argc > 1) && (**argv == '-'); ++argv, --argc ) {
+        if( string(*argv) == "--no-colors" ) {
+            Utils::g_use_colors = false;
+        } else if( string(*argv) == "--root" ) {
+            root = argv[1];
+            ++argv;
+            --argc;
+        } else if( ((*argv)[1] == 'w') || (string(*argv) == "--warmups") ) {
+            warmups = strtoul(argv[1], 0, 0);
+            ++argv;
+            --argc;
+        } else if( ((*argv)[1] == 'n') || (string(*argv) == "--repetitions") ) {
+            repetitions = Utils::max(1ul, strtoul(argv[1], 0, 0));
+            ++argv;
+            --argc;
+        } else if( string(*argv) == "--only" ) {
+            only = argv[1];
+            ++argv;
+            --argc;
+        } else if( string(*argv) == "--baseline" ) {
+            baseline_file = argv[1];
+            ++argv;
+            --argc;
+        } else if( string(*argv) == "--threshold" ) {
+            threshold = strtod(argv[1], 0);
+            ++argv;
+            --argc;
+        } else if( string(*argv) == "--no-stats" ) {
+            stats = false;
+        } else if( string(*argv) == "--stats" ) {
+            delete sink;
+            sink = Stats::make_sink(argv[1]);
+            if( sink == 0 ) {
+                cout << Utils::error() << "invalid stats sink '" << argv[1] << "' (expected json:<file> or csv:<file>)" << endl;
+                exit(-1);
+            }
+            ++argv;
+            --argc;
+        } else {
+            usage(cout);
+            exit(-1);
+        }
+    }
+    if( argc != 1 ) {
+        usage(cout);
+        exit(-1);
+    }
+
+    vector<entry_t> entries;
+    if( !read_matrix(argv[0], entries) ) {
+        cout << Utils::error() << "cannot read matrix '" << argv[0] << "'" << endl;
+        exit(-1);
+    }
+
+    map<string, double> baseline;
+    if( !baseline_file.empty() && !read_baseline(baseline_file, baseline) )
+        cout << Utils::warning() << "cannot read baseline '" << baseline_file << "'; no comparisons will be made" << endl;
+
+    unsigned failures = 0, regressions = 0;
+    for( int i = 0, isz = entries.size(); i < isz; ++i ) {
+        const entry_t &entry = entries[i];
+        if( entry.name_.compare(0, only.size(), only) != 0 ) continue;
+        cout << "bench: " << entry.name_ << endl;
+
+        bool ok = true;
+        vector<run_t> runs;
+        for( unsigned r = 0; ok && (r < warmups + repetitions); ++r ) {
+            run_t run;
+            ok = run_entry(root, entry, stats, run);
+            if( ok && (r >= warmups) ) runs.push_back(run);
+        }
+        if( !ok ) {
+            ++failures;
+            continue;
+        }
+
+        // figures of the run with median wall-clock time
+        sort(runs.begin(), runs.end());
+        const run_t &median = runs[runs.size() / 2];
+        long peak_rss = 0;
+        for( int j = 0, jsz = runs.size(); j < jsz; ++j )
+            peak_rss = Utils::max(peak_rss, runs[j].peak_rss_);
+        double time_raw = Utils::max(median.time_raw_, 1e-6);
+
+        cout << Utils::green() << "stats:" << Utils::normal()
+             << " type=bench"
+             << " name=" << entry.name_
+             << " domain=" << entry.domain_
+             << " repetitions=" << runs.size()
+             << Utils::green() << " time=" << median.wall_time_ << Utils::normal()
+             << " time.min=" << runs.front().wall_time_
+             << " time.max=" << runs.back().wall_time_;
+        if( stats ) {
+            cout << " time.raw=" << median.time_raw_
+                 << " backups/s=" << median.backups_ / time_raw
+                 << " expansions/s=" << median.expansions_ / time_raw
+                 << " decisions/s=" << median.decisions_ / time_raw
+                 << " states=" << (unsigned long)median.states_;
+        }
+        cout << " peak-rss=" << peak_rss;
+
+        Stats::record_t record("bench");
+        record.add("name", entry.name_)
+              .add("domain", entry.domain_)
+              .add("repetitions", (unsigned)runs.size())
+              .add("time", median.wall_time_)
+              .add("time.min", runs.front().wall_time_)
+              .add("time.max", runs.back().wall_time_);
+        if( stats ) {
+            record.add("time.raw", median.time_raw_)
+                  .add("backups/s", median.backups_ / time_raw)
+                  .add("expansions/s", median.expansions_ / time_raw)
+                  .add("decisions/s", median.decisions_ / time_raw)
+                  .add("states", (unsigned long)median.states_);
+        }
+        record.add("peak-rss", peak_rss);
+
+        map<string, double>::const_iterator it = baseline.find(entry.name_);
+        if( it != baseline.end() ) {
+            double ratio = it->second > 0 ? median.wall_time_ / it->second : 1;
+            string status = ratio > 1 + threshold ? "regression" : (ratio < 1 - threshold ? "improvement" : "ok");
+            if( status == "regression" ) ++regressions;
+            cout << " baseline=" << it->second
+                 << " ratio=" << ratio
+                 << " status=" << (status == "regression" ? Utils::red() : Utils::normal()) << status << Utils::normal();
+            record.add("baseline", it->second)
+                  .add("ratio", ratio)
+                  .add("status", status);
+        }
+        cout << endl;
+        if( sink != 0 ) sink->write(record);
+    }
+
+    if( failures > 0 )
+        cout << Utils::error() << failures << " entry(ies) failed" << endl;
+    if( regressions > 0 )
+        cout << Utils::error() << regressions << " regression(s) above threshold=" << threshold << endl;
+    delete sink;
+    return (failures > 0) || (regressions > 0) ? 1 : 0;
+}
+
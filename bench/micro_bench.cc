@@ -0,0 +1,366 @@
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <bdd_priority_queue.h>
+#include <hash.h>
+#include <random.h>
+#include <stats.h>
+#include <utils.h>
+
+#include "../ctp3/graph.h"
+
+namespace Utils {
+  bool g_use_colors = true;
+  unsigned g_timer_period = 1;
+};
+
+using namespace std;
+
+// Microbenchmarks of the engine primitives: hash tables, bounded priority
+// queues, sampling from distributions, random generators, tokenization of
+// requests and the shortest-path algorithms of ctp3. Each benchmark is
+// repeated, doubling the number of repetitions, until it runs for at least
+// --min-time seconds, and is reported in a stats line with the time per
+// operation. The checksum depends on the results of the operations so
+// they aren't optimized away, and should be the same across builds.
+
+struct options_t {
+    float min_time_;
+    string only_;
+    Stats::sink_t *sink_;
+    options_t() : min_time_(.2), sink_(0) { }
+};
+
+// run(repetitions) performs repetitions * ops_per_repetition operations
+// and returns a checksum
+typedef function<double(unsigned repetitions)> benchmark_fn_t;
+
+void measure(const options_t &options, const string &name, const string &parameter, size_t ops_per_repetition, const benchmark_fn_t &run) {
+    if( name.compare(0, options.only_.size(), options.only_) != 0 ) return;
+
+    run(1); // warmup
+    unsigned repetitions = 1;
+    double elapsed_time = 0, checksum = 0;
+    for( ;; ) {
+        double start_time = Utils::read_monotonic_time();
+        checksum = run(repetitions);
+        elapsed_time = Utils::read_monotonic_time() - start_time;
+        if( (elapsed_time >= options.min_time_) || (repetitions >= (1U << 30)) ) break;
+        repetitions <<= 1;
+    }
+
+    size_t num_operations = size_t(repetitions) * ops_per_repetition;
+    double ns_per_op = num_operations == 0 ? 0 : 1e9 * elapsed_time / num_operations;
+    cout << Utils::green() << "stats:" << Utils::normal()
+         << " type=micro"
+         << " name=" << name
+         << " param=" << parameter
+         << " #ops=" << num_operations
+         << " checksum=" << checksum
+         << " time=" << elapsed_time
+         << Utils::green() << " ns/op=" << ns_per_op << Utils::normal()
+         << endl;
+
+    if( options.sink_ != 0 ) {
+        Stats::record_t record("micro");
+        record.add("name", name)
+              .add("param", parameter)
+              .add("#ops", (unsigned long)num_operations)
+              .add("checksum", checksum)
+              .add("time", elapsed_time)
+              .add("ns/op", ns_per_op);
+        options.sink_->write(record);
+    }
+}
+
+// Hash tables: states with a multiplicative hash, as in the domains
+struct state_t {
+    unsigned key_;
+    state_t(unsigned key = 0) : key_(key) { }
+    size_t hash() const { return key_ * 2654435761U; }
+    bool operator==(const state_t &s) const { return key_ == s.key_; }
+};
+
+void hash_benchmarks(const options_t &options) {
+    const unsigned sizes[] = { 1000, 100000, 1000000 };
+    for( int i = 0; i < 3; ++i ) {
+        unsigned size = sizes[i];
+        string parameter = "size=" + to_string(size);
+
+        measure(options, "hash.insert", parameter, size, [size](unsigned repetitions) {
+            double checksum = 0;
+            for( unsigned r = 0; r < repetitions; ++r ) {
+                Hash::hash_map_t<state_t> table;
+                for( unsigned k = 0; k < size; ++k )
+                    table.data_ptr(state_t(k))->update(k);
+                checksum += table.size();
+            }
+            return checksum;
+        });
+
+        Hash::hash_map_t<state_t> table;
+        for( unsigned k = 0; k < size; ++k )
+            table.update(state_t(2 * k), k);
+
+        measure(options, "hash.lookup-hit", parameter, size, [size, &table](unsigned repetitions) {
+            double checksum = 0;
+            for( unsigned r = 0; r < repetitions; ++r ) {
+                for( unsigned k = 0; k < size; ++k )
+                    checksum += table.value(state_t(2 * ((k * 7919U) % size)));
+            }
+            return checksum;
+        });
+
+        measure(options, "hash.lookup-miss", parameter, size, [size, &table](unsigned repetitions) {
+            double checksum = 0;
+            for( unsigned r = 0; r < repetitions; ++r ) {
+                for( unsigned k = 0; k < size; ++k )
+                    checksum += table.value(state_t(2 * ((k * 7919U) % size) + 1));
+            }
+            return checksum;
+        });
+    }
+}
+
+// Bounded priority queues: elements ordered by |delta| as the tips in aot
+struct tip_t {
+    float delta_;
+};
+
+struct min_priority_t {
+    bool operator()(const tip_t *n1, const tip_t *n2) const {
+        return fabs(n1->delta_) > fabs(n2->delta_);
+    }
+};
+
+struct max_priority_t {
+    bool operator()(const tip_t *n1, const tip_t *n2) const {
+        return fabs(n2->delta_) > fabs(n1->delta_);
+    }
+};
+
+// push 4 * capacity tips (the last 3/4 of them may evict others) and pop all
+template<typename Q> void queue_benchmark(const options_t &options, const string &name, unsigned capacity) {
+    vector<tip_t> tips(4 * capacity);
+    Random::set_seed(0);
+    for( int i = 0, isz = tips.size(); i < isz; ++i )
+        tips[i].delta_ = Random::uniform(-1, 1);
+
+    measure(options, name, "capacity=" + to_string(capacity), tips.size(), [capacity, &tips](unsigned repetitions) {
+        Q queue(capacity);
+        double checksum = 0;
+        for( unsigned r = 0; r < repetitions; ++r ) {
+            for( int i = 0, isz = tips.size(); i < isz; ++i ) {
+                tip_t *tip = &tips[i];
+                checksum += queue.push(tip).second ? 1 : 0;
+            }
+            while( !queue.empty() ) {
+                checksum += fabs(queue.top()->delta_);
+                queue.pop();
+            }
+        }
+        return checksum;
+    });
+}
+
+void queue_benchmarks(const options_t &options) {
+    typedef std::bdd_priority_queue<tip_t*, min_priority_t, max_priority_t> heap_queue_t;
+    typedef std::bdd_sorted_queue<tip_t*, min_priority_t, max_priority_t> sorted_queue_t;
+    const unsigned capacities[] = { 16, 256, 4096 };
+    for( int i = 0; i < 3; ++i ) {
+        queue_benchmark<heap_queue_t>(options, "queue.heap", capacities[i]);
+        queue_benchmark<sorted_queue_t>(options, "queue.sorted", capacities[i]);
+    }
+}
+
+// Sampling k indices from a distribution over n outcomes
+void sampling_benchmarks(const options_t &options) {
+    const int ns[] = { 2, 8, 64 };
+    const int k = 100;
+    for( int i = 0; i < 3; ++i ) {
+        int n = ns[i];
+        vector<float> cdf(n);
+        Random::set_seed(0);
+        float total = 0;
+        for( int j = 0; j < n; ++j ) {
+            total += Random::uniform();
+            cdf[j] = total;
+        }
+        for( int j = 0; j < n; ++j ) cdf[j] /= total;
+        cdf[n - 1] = 1;
+
+        string parameter = "n=" + to_string(n) + ",k=" + to_string(k);
+        measure(options, "sampling.independent", parameter, k, [n, k, &cdf](unsigned repetitions) {
+            Random::set_seed(0);
+            vector<int> indices;
+            double checksum = 0;
+            for( unsigned r = 0; r < repetitions; ++r ) {
+                Utils::stochastic_sampling(n, &cdf[0], k, indices);
+                checksum += indices[r % k];
+            }
+            return checksum;
+        });
+        measure(options, "sampling.universal", parameter, k, [n, k, &cdf](unsigned repetitions) {
+            Random::set_seed(0);
+            vector<int> indices;
+            double checksum = 0;
+            for( unsigned r = 0; r < repetitions; ++r ) {
+                Utils::stochastic_universal_sampling(n, &cdf[0], k, indices);
+                checksum += indices[r % k];
+            }
+            return checksum;
+        });
+    }
+}
+
+// Random generators of the calling thread, and switching streams
+void random_benchmarks(const options_t &options) {
+    const unsigned batch = 1000;
+    measure(options, "random.uniform", "-", batch, [batch](unsigned repetitions) {
+        Random::set_seed(0);
+        double checksum = 0;
+        for( unsigned r = 0; r < repetitions * batch; ++r )
+            checksum += Random::uniform();
+        return checksum;
+    });
+    measure(options, "random.real", "-", batch, [batch](unsigned repetitions) {
+        Random::set_seed(0);
+        double checksum = 0;
+        for( unsigned r = 0; r < repetitions * batch; ++r )
+            checksum += Random::real();
+        return checksum;
+    });
+    measure(options, "random.random", "max=10", batch, [batch](unsigned repetitions) {
+        Random::set_seed(0);
+        double checksum = 0;
+        for( unsigned r = 0; r < repetitions * batch; ++r )
+            checksum += Random::random(10);
+        return checksum;
+    });
+    measure(options, "random.stream", "-", batch, [batch](unsigned repetitions) {
+        Random::stream_t stream(Random::seed48(0, 0));
+        double checksum = 0;
+        for( unsigned r = 0; r < repetitions * batch; ++r ) {
+            Random::scoped_stream_t scoped(stream);
+            checksum += Random::uniform();
+        }
+        return checksum;
+    });
+}
+
+// Parsing of requests as done by the dispatcher
+void tokenize_benchmarks(const options_t &options) {
+    const string request = "uct(width=1000,horizon=50,parameter=-0.15,random-ties=true,policy=greedy(heuristic=min-min(algorithm=lrtdp(epsilon=.001,heuristic=zero()))))";
+    measure(options, "tokenize", "length=" + to_string(request.size()), 1, [&request](unsigned repetitions) {
+        double checksum = 0;
+        for( unsigned r = 0; r < repetitions; ++r ) {
+            multimap<string, string> parameters;
+            Utils::tokenize(request, parameters);
+            checksum += parameters.size();
+        }
+        return checksum;
+    });
+}
+
+// Shortest paths in a ctp3 graph with all edges unknown (optimistic)
+void graph_benchmarks(const options_t &options, const string &filename) {
+    CTP::graph_t graph;
+    ifstream is(filename.c_str());
+    if( !is || !graph.parse(is) ) {
+        cout << Utils::error() << "cannot read graph '" << filename << "'" << endl;
+        return;
+    }
+
+    int num_nodes = graph.num_nodes_;
+    vector<unsigned> k_bitmap(1 + graph.num_edges_ / 32, 0), b_bitmap(1 + graph.num_edges_ / 32, 0);
+    string parameter = "graph=" + filename + ",nodes=" + to_string(num_nodes) + ",edges=" + to_string(graph.num_edges_);
+
+    measure(options, "ctp3.bfs", parameter, 1, [&](unsigned repetitions) {
+        double checksum = 0;
+        for( unsigned r = 0; r < repetitions; ++r )
+            checksum += graph.bfs(r % num_nodes, num_nodes - 1, &k_bitmap[0], &b_bitmap[0], true);
+        return checksum;
+    });
+    measure(options, "ctp3.dijkstra", parameter, 1, [&](unsigned repetitions) {
+        vector<int> distances(num_nodes);
+        double checksum = 0;
+        for( unsigned r = 0; r < repetitions; ++r ) {
+            graph.dijkstra(r % num_nodes, &distances[0], &k_bitmap[0], &b_bitmap[0], true);
+            checksum += distances[num_nodes - 1];
+        }
+        return checksum;
+    });
+    measure(options, "ctp3.floyd-warshall", parameter, 1, [&](unsigned repetitions) {
+        vector<int> distances(num_nodes * num_nodes);
+        double checksum = 0;
+        for( unsigned r = 0; r < repetitions; ++r ) {
+            graph.floyd_warshall(&distances[0], &k_bitmap[0], &b_bitmap[0], true);
+            checksum += distances[num_nodes - 1];
+        }
+        return checksum;
+    });
+}
+
+void usage(ostream &os) {
+    os << "usage: micro_bench [--no-colors] [--min-time <seconds>] [--only <name-prefix>] [--graph <file>] [--stats {json | csv}:{<file> | -}]" << endl;
+}
+
+int main(int argc, const char **argv) {
+    options_t options;
+    string graph_file = "../ctp3/AAAI-graphs/test00_100_T.graph";
+    cout << fixed;
+
+    // parse arguments
+    for( ++argv, --argc; (argc > 0) && (**argv == '-'); ++argv, --argc ) {
+        if( string(*argv) == "--no-colors" ) {
+            Utils::g_use_colors = false;
+        } else if( (argc > 1) && (string(*argv) == "--min-time") ) {
+            options.min_time_ = strtod(argv[1], 0);
+            ++argv;
+            --argc;
+        } else if( (argc > 1) && (string(*argv) == "--only") ) {
+            options.only_ = argv[1];
+            ++argv;
+            --argc;
+        } else if( (argc > 1) && (string(*argv) == "--graph") ) {
+            graph_file = argv[1];
+            ++argv;
+            --argc;
+        } else if( (argc > 1) && (string(*argv) == "--stats") ) {
+            delete options.sink_;
+            options.sink_ = Stats::make_sink(argv[1]);
+            if( options.sink_ == 0 ) {
+                cout << Utils::error() << "invalid stats sink '" << argv[1] << "' (expected json:<file> or csv:<file>)" << endl;
+                exit(-1);
+            }
+            ++argv;
+            --argc;
+        } else {
+            usage(cout);
+            exit(-1);
+        }
+    }
+    if( argc != 0 ) {
+        usage(cout);
+        exit(-1);
+    }
+
+    hash_benchmarks(options);
+    queue_benchmarks(options);
+    sampling_benchmarks(options);
+    random_benchmarks(options);
+    tokenize_benchmarks(options);
+    if( string("ctp3").compare(0, options.only_.size(), options.only_) == 0 || (options.only_.compare(0, 4, "ctp3") == 0) )
+        graph_benchmarks(options, graph_file);
+
+    delete options.sink_;
+    return 0;
+}
+
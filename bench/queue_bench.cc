@@ -0,0 +1,178 @@
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <bdd_priority_queue.h>
+#include <utils.h>
+
+namespace Utils {
+  bool g_use_colors = true;
+  unsigned g_timer_period = 1;
+};
+
+using namespace std;
+
+// Replays the operations on the queues of tips recorded by aot() with
+// queue-trace=<file> on each implementation of the bounded queue, and
+// reports the time per operation. Tips are ordered by |delta| as in aot.
+
+struct tip_t {
+    float delta_;
+};
+
+struct min_priority_t {
+    bool operator()(const tip_t *n1, const tip_t *n2) const {
+        return fabs(n1->delta_) > fabs(n2->delta_);
+    }
+};
+
+struct max_priority_t {
+    bool operator()(const tip_t *n1, const tip_t *n2) const {
+        return fabs(n2->delta_) > fabs(n1->delta_);
+    }
+};
+
+struct operation_t {
+    enum kind_t { Push, PopInside, PopOutside, Clear };
+    kind_t kind_;
+    tip_t *tip_;
+    operation_t(kind_t kind, tip_t *tip = 0) : kind_(kind), tip_(tip) { }
+};
+
+struct trace_t {
+    string filename_;
+    unsigned capacity_;
+    vector<tip_t> tips_;
+    vector<operation_t> operations_;
+    trace_t() : capacity_(1) { }
+
+    bool read(const string &filename) {
+        ifstream is(filename.c_str());
+        if( !is ) return false;
+        filename_ = filename;
+
+        // first pass creates the tips, so pointers to them remain valid
+        vector<pair<operation_t::kind_t, float> > ops;
+        string op, arg;
+        while( is >> op ) {
+            if( op == "capacity" ) {
+                is >> capacity_;
+            } else if( op == "push" ) {
+                is >> arg;
+                ops.push_back(make_pair(operation_t::Push, strtof(arg.c_str(), 0)));
+            } else if( op == "pop" ) {
+                is >> arg;
+                ops.push_back(make_pair(arg == "in" ? operation_t::PopInside : operation_t::PopOutside, 0.0f));
+            } else if( op == "clear" ) {
+                ops.push_back(make_pair(operation_t::Clear, 0.0f));
+            } else {
+                cout << Utils::error() << "unexpected '" << op << "' in trace '" << filename << "'" << endl;
+                return false;
+            }
+        }
+
+        tips_.reserve(ops.size());
+        for( int i = 0, isz = ops.size(); i < isz; ++i ) {
+            if( ops[i].first == operation_t::Push ) {
+                tips_.push_back(tip_t());
+                tips_.back().delta_ = ops[i].second;
+                operations_.push_back(operation_t(operation_t::Push, &tips_.back()));
+            } else {
+                operations_.push_back(operation_t(ops[i].first));
+            }
+        }
+        return true;
+    }
+};
+
+// replay trace on a pair of queues (inside/outside the best policy) and
+// return a checksum of the popped deltas
+template<typename Q> double replay(const trace_t &trace, Q &inside, Q &outside) {
+    double checksum = 0;
+    for( int i = 0, isz = trace.operations_.size(); i < isz; ++i ) {
+        const operation_t &op = trace.operations_[i];
+        if( op.kind_ == operation_t::Push ) {
+            tip_t *tip = op.tip_;
+            if( copysignf(1, tip->delta_) == 1 )
+                inside.push(tip);
+            else
+                outside.push(tip);
+        } else if( op.kind_ == operation_t::PopInside ) {
+            checksum += fabs(inside.top()->delta_);
+            inside.pop();
+        } else if( op.kind_ == operation_t::PopOutside ) {
+            checksum += fabs(outside.top()->delta_);
+            outside.pop();
+        } else {
+            while( !inside.empty() ) inside.pop();
+            while( !outside.empty() ) outside.pop();
+        }
+    }
+    return checksum;
+}
+
+template<typename Q> void benchmark(const string &name, const trace_t &trace, unsigned repetitions) {
+    Q inside(trace.capacity_), outside(trace.capacity_);
+    double checksum = 0;
+    float start_time = Utils::read_time_in_seconds();
+    for( unsigned r = 0; r < repetitions; ++r ) {
+        inside.clear();
+        outside.clear();
+        checksum = replay(trace, inside, outside);
+    }
+    float elapsed_time = Utils::read_time_in_seconds() - start_time;
+    size_t num_operations = size_t(repetitions) * trace.operations_.size();
+    cout << "stats: type=queue name=" << name
+         << " trace=" << trace.filename_
+         << " capacity=" << trace.capacity_
+         << " #ops=" << num_operations
+         << " checksum=" << checksum
+         << " time=" << elapsed_time
+         << " ns/op=" << (num_operations == 0 ? 0 : 1e9 * elapsed_time / num_operations)
+         << endl;
+}
+
+void usage(ostream &os) {
+    os << "usage: queue_bench [--no-colors] [{-n | --repetitions} <n>] <trace>+" << endl;
+}
+
+int main(int argc, const char **argv) {
+    unsigned repetitions = 1;
+    cout << fixed;
+
+    // parse arguments
+    for( ++argv, --argc; (argc > 0) && (**argv == '-'); ++argv, --argc ) {
+        if( string(*argv) == "--no-colors" ) {
+            Utils::g_use_colors = false;
+        } else if( (argc > 1) && (((*argv)[1] == 'n') || (string(*argv) == "--repetitions")) ) {
+            repetitions = strtoul(argv[1], 0, 0);
+            ++argv;
+            --argc;
+        } else {
+            usage(cout);
+            exit(-1);
+        }
+    }
+    if( argc == 0 ) {
+        usage(cout);
+        exit(-1);
+    }
+
+    typedef std::bdd_priority_queue<tip_t*, min_priority_t, max_priority_t> heap_queue_t;
+    typedef std::bdd_sorted_queue<tip_t*, min_priority_t, max_priority_t> sorted_queue_t;
+    for( ; argc > 0; ++argv, --argc ) {
+        trace_t trace;
+        if( !trace.read(*argv) ) {
+            cout << Utils::error() << "cannot read trace '" << *argv << "'" << endl;
+            exit(-1);
+        }
+        benchmark<heap_queue_t>("heap", trace, repetitions);
+        benchmark<sorted_queue_t>("sorted", trace, repetitions);
+    }
+    return 0;
+}
+
@@ -20,10 +20,6 @@
 #define WORDS_FOR_EDGES 9 // max. 288 edges
 
 
-inline unsigned rotation(unsigned x) {
-    return (x << 16) | (x >> 16);
-}
-
 template<typename T> struct print_bits_t {
     T field_;
     int base_;
@@ -61,11 +57,9 @@ struct state_info_t {
     }
 
     size_t hash() const {
-        unsigned rv = 0;
-        for( int i = 0; i < words_for_edges_; ++i )
-            rv = rv ^ known_[i];
+        size_t rv = 0;
         for( int i = 0; i < words_for_edges_; ++i )
-            rv = rv ^ rotation(blocked_[i]);
+            rv = Hash::combine(rv, (size_t(known_[i]) << 32) | blocked_[i]);
         return rv;
     }
 
@@ -305,7 +299,12 @@ struct state_t {
         cache_.print_stats(os);
     }
 
-    size_t hash() const { return info_.hash(); }
+    size_t hash() const {
+        size_t rv = Hash::combine(info_.hash(), current_);
+        for( int i = 0; i < words_for_nodes_; ++i )
+            rv = Hash::combine(rv, visited_[i]);
+        return rv;
+    }
 
     void compute_heuristic() const {
         if( heuristic_ == -1 ) {
@@ -654,6 +653,30 @@ class problem_t : public Problem::problem_t<state_t> {
 
         if( use_cache_ ) next_cache_.insert(s, a, outcomes);
     }
+    virtual Problem::scenario_t<state_t>* sample_scenario() const;
+
+    // serialized state: current node, then known, blocked and visited words
+    virtual size_t state_size() const {
+        return sizeof(int) + (2 * state_t::words_for_edges_ + state_t::words_for_nodes_) * sizeof(unsigned);
+    }
+    virtual void serialize(const state_t &s, char *bytes) const {
+        size_t edge_bytes = state_t::words_for_edges_ * sizeof(unsigned);
+        memcpy(bytes, &s.current_, sizeof(int));
+        bytes += sizeof(int);
+        memcpy(bytes, s.info_.known_, edge_bytes);
+        memcpy(bytes + edge_bytes, s.info_.blocked_, edge_bytes);
+        memcpy(bytes + 2 * edge_bytes, s.visited_, state_t::words_for_nodes_ * sizeof(unsigned));
+    }
+    virtual bool deserialize(const char *bytes, state_t &s) const {
+        size_t edge_bytes = state_t::words_for_edges_ * sizeof(unsigned);
+        s.clear();
+        memcpy(&s.current_, bytes, sizeof(int));
+        bytes += sizeof(int);
+        memcpy(s.info_.known_, bytes, edge_bytes);
+        memcpy(s.info_.blocked_, bytes + edge_bytes, edge_bytes);
+        memcpy(s.visited_, bytes + 2 * edge_bytes, state_t::words_for_nodes_ * sizeof(unsigned));
+        return true;
+    }
     virtual void print(std::ostream &os) const { }
 
     void print_stats(std::ostream &os) {
@@ -661,6 +684,42 @@ class problem_t : public Problem::problem_t<state_t> {
     }
 };
 
+// Scenario given by a weather sampled at the beginning of the trial, which
+// fixes the status of the edges revealed by each move
+class weather_scenario_t : public Problem::scenario_t<state_t> {
+    const problem_t &problem_;
+    state_t weather_;
+
+  public:
+    weather_scenario_t(const problem_t &problem)
+      : problem_(problem), weather_(0) {
+        const CTP::graph_t &graph = problem_.graph_;
+        for( int e = 0; e < graph.num_edges_; ++e )
+            weather_.info_.set_edge_status(e, Random::real() < graph.prob(e) ? false : true);
+    }
+    virtual ~weather_scenario_t() { }
+
+    virtual std::pair<state_t, bool> sample(const state_t &s, Problem::action_t a) const {
+        std::vector<std::pair<state_t, float> > outcomes;
+        problem_.next(s, a, outcomes);
+        for( int i = 0, isz = outcomes.size(); i < isz; ++i ) {
+            const state_t &next = outcomes[i].first;
+            bool consistent = true;
+            for( int e = 0; consistent && (e < problem_.graph_.num_edges_); ++e ) {
+                if( !s.known(e) && next.known(e) )
+                    consistent = next.traversable(e) == weather_.traversable(e);
+            }
+            if( consistent ) return std::make_pair(next, true);
+        }
+        assert(0);
+        return std::make_pair(outcomes[0].first, true);
+    }
+};
+
+inline Problem::scenario_t<state_t>* problem_t::sample_scenario() const {
+    return new weather_scenario_t(*this);
+}
+
 inline std::ostream& operator<<(std::ostream &os, const problem_t &p) {
     p.print(os);
     return os;
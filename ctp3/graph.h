@@ -35,16 +35,14 @@ struct graph_t {
     std::vector<std::vector<int> > at_;
     int *edges_;
     int *h_opt_;
-    int *in_queue_;
 
     graph_t(bool with_shortcut = false, int shortcut_cost = 1000)
       : num_nodes_(0), num_edges_(0),
         with_shortcut_(with_shortcut), shortcut_cost_(shortcut_cost),
-        edges_(0), h_opt_(0), in_queue_(0) { }
+        edges_(0), h_opt_(0) { }
     ~graph_t() {
         delete[] edges_;
         delete[] h_opt_;
-        delete[] in_queue_;
     }
 
     int heuristic(int node) const { return h_opt_[node]; }
@@ -123,7 +121,6 @@ struct graph_t {
 
         // compute optimistic shortest-paths to goal
         h_opt_ = new int[num_nodes_];
-        in_queue_ = new int[num_nodes_];
         for( int node = 0; node < num_nodes_; ++node )
             h_opt_[node] = INT_MAX;
 
@@ -185,14 +182,16 @@ struct graph_t {
             const unsigned *b_bitmap,
             bool optimistic = false) const {
 
-        static std::priority_queue<std::pair<int, std::pair<int, int> >,
-                                   std::vector<std::pair<int, std::pair<int, int> > >,
-                                   bfs_open_list_cmp> queue;
+        // scratch space is per thread so that rollouts can run in parallel
+        static thread_local std::priority_queue<std::pair<int, std::pair<int, int> >,
+                                                std::vector<std::pair<int, std::pair<int, int> > >,
+                                                bfs_open_list_cmp> queue;
+        static thread_local std::vector<int> in_queue;
 
         int cost_to_goal = INT_MAX;
-        memset(in_queue_, 0, num_nodes_ * sizeof(int));
+        in_queue.assign(num_nodes_, 0);
         queue.push(std::make_pair(start, std::make_pair(0, heuristic(start))));
-        in_queue_[start] = 1;
+        in_queue[start] = 1;
         while( !queue.empty() ) {
             std::pair<int, std::pair<int, int> > p = queue.top();
             queue.pop();
@@ -208,9 +207,9 @@ struct graph_t {
                     const edge_t &edge = edge_list_[idx];
                     int cost = p.second.first + edge.cost_;
                     int next = p.first == edge.to_ ? edge.from_ : edge.to_;
-                    if( in_queue_[next] == 0 ) {
+                    if( in_queue[next] == 0 ) {
                         queue.push(std::make_pair(next, std::make_pair(cost, heuristic(next))));
-                        in_queue_[next] = 1;
+                        in_queue[next] = 1;
                     }
                 }
             }
@@ -226,9 +225,9 @@ struct graph_t {
                   const unsigned *b_bitmap,
                   bool optimistic = false) const {
 
-        static std::priority_queue<std::pair<int, int>,
-                                   std::vector<std::pair<int, int> >,
-                                   open_list_cmp> queue;
+        static thread_local std::priority_queue<std::pair<int, int>,
+                                                std::vector<std::pair<int, int> >,
+                                                open_list_cmp> queue;
 
         // initialization
         for( int node = 0; node < num_nodes_; ++node )
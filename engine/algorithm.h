@@ -19,9 +19,11 @@
 #ifndef ALGORITHM_H
 #define ALGORITHM_H
 
+#include "checkpoint.h"
 #include "dispatcher.h"
 #include "heuristic.h"
 #include "problem.h"
+#include "spill.h"
 
 #include <map>
 #include <string>
@@ -37,10 +39,45 @@ template<typename T> class algorithm_t {
     const Problem::problem_t<T> &problem_;
     const Heuristic::heuristic_t<T> *heuristic_;
     unsigned seed_;
+    mutable Checkpoint::checkpointer_t<T> *checkpointer_;
+    size_t max_memory_;
+    std::string spill_;
+
+    // resume from the snapshot of the checkpointer, if any; returns the
+    // number of trials (or iterations) done before the snapshot
+    size_t resume(Problem::hash_t<T> &hash) const {
+        return checkpointer_ == 0 ? 0 : checkpointer_->resume(hash, name());
+    }
+    // memory budget of the hash table and file where evicted entries are
+    // spilled, for algorithms that support them
+    void set_memory_parameters(const std::multimap<std::string, std::string> &parameters) {
+        std::multimap<std::string, std::string>::const_iterator it = parameters.find("max-memory");
+        if( it != parameters.end() ) max_memory_ = Utils::parse_bytes(it->second);
+        it = parameters.find("spill");
+        if( it != parameters.end() ) spill_ = it->second;
+    }
+    std::string memory_name() const {
+        return (max_memory_ == 0 ? std::string("") : std::string(",max-memory=") + std::to_string(max_memory_)) +
+               (spill_.empty() ? std::string("") : std::string(",spill=") + spill_);
+    }
+    void setup_memory(Problem::hash_t<T> &hash) const {
+        hash.set_max_memory(max_memory_);
+        if( !spill_.empty() && (hash.cold_store() == 0) ) {
+            Spill::store_t<T> *store = new Spill::store_t<T>(problem_, spill_);
+            if( !store->open() ) exit(1);
+            hash.set_cold_store(store);
+        }
+    }
+
+    // called between trials (or iterations), when the hash table is consistent
+    void checkpoint(const Problem::hash_t<T> &hash, size_t trials) const {
+        if( (checkpointer_ != 0) && checkpointer_->due() )
+            checkpointer_->snapshot(hash, name(), trials);
+    }
 
   public:
     algorithm_t(const Problem::problem_t<T> &problem)
-      : problem_(problem), heuristic_(0), seed_(g_seed) {
+      : problem_(problem), heuristic_(0), seed_(g_seed), checkpointer_(0), max_memory_(0) {
     }
     virtual ~algorithm_t() { }
     virtual algorithm_t<T>* clone() const = 0;
@@ -48,6 +85,12 @@ template<typename T> class algorithm_t {
     virtual void set_parameters(const std::multimap<std::string, std::string> &parameters, Dispatcher::dispatcher_t<T> &dispatcher) = 0;
     virtual void solve(const T &s, Problem::hash_t<T> &hash) const = 0;
     virtual void reset_stats(Problem::hash_t<T> &hash) const = 0;
+    virtual bool supports_checkpoints() const { return false; }
+    void set_checkpointer(Checkpoint::checkpointer_t<T> *checkpointer) const { checkpointer_ = checkpointer; }
+    size_t max_memory() const { return max_memory_; }
+    void set_max_memory(size_t max_memory) { max_memory_ = max_memory; }
+    const std::string& spill() const { return spill_; }
+    void set_spill(const std::string &spill) { spill_ = spill; }
     unsigned seed() const { return seed_; }
     const Problem::problem_t<T>& problem() const { return problem_; }
     const Heuristic::heuristic_t<T>* heuristic() const { return heuristic_; }
@@ -21,9 +21,11 @@
 
 #include "policy.h"
 #include "bdd_priority_queue.h"
+#include "parallel.h"
 
 #include <iostream>
 #include <iomanip>
+#include <fstream>
 #include <sstream>
 #include <cassert>
 #include <limits>
@@ -45,143 +47,336 @@ namespace Policy {
 
 namespace AOT {
 
-template<typename T> class aot_t; // Forward reference
+////////////////////////////////////////////////
+//
+// Strategies
+//
+
+// The variants of AOT are instances of aot_t for the following strategies,
+// which are bound at compile time: the selection of tips to expand (by
+// delta or at random), how values are stored and combined (a plain value
+// or g + w * h as in aot-gh), and how tips are expanded (one node, or a
+// path that follows the base policy as in aot-path). Tips selected by delta
+// are kept in bounded queues, implemented by a dual min/max heap or by a
+// heap that is sorted once before the tips are taken.
+
+struct delta_selection_t {
+    static std::string name() { return "delta"; }
+};
+struct random_selection_t {
+    static std::string name() { return "random"; }
+};
+
+struct node_expansion_t {
+    static const bool path = false;
+};
+struct path_expansion_t {
+    static const bool path = true;
+};
+
+struct heap_queue_t {
+    static std::string name() { return "heap"; }
+};
+struct sorted_queue_t {
+    static std::string name() { return "sorted"; }
+};
+
+// Plain value: a single estimate of the cost-to-go
+struct plain_value_t {
+    static const bool weighted = false;
+    float value_;
+
+    float value(float w) const { return value_; }
+    void set_value(float cost, float estimate) { value_ = cost + estimate; }
+    void clear_value() { value_ = 0; }
+    void add_value(float probability, const plain_value_t &child) {
+        value_ += probability * child.value_;
+    }
+    void discount_value(float cost, float discount) {
+        value_ = cost + discount * value_;
+    }
+    void add_estimate(float estimate, unsigned nsamples, unsigned new_nsamples) {
+        float new_val = value_ * nsamples + estimate;
+        value_ = new_val / new_nsamples;
+    }
+    void add_estimate(float cost, float discount, float estimate, unsigned nsamples, unsigned new_nsamples) {
+        float old_val = (value_ - cost) / discount;
+        float new_val = old_val * nsamples + estimate;
+        value_ = cost + discount * new_val / new_nsamples;
+    }
+    void print_value(std::ostream &os) const {
+        os << ",value=" << value_;
+    }
+};
+
+// Accumulated cost g and estimated cost-to-go h, compared by g + w * h
+struct gh_value_t {
+    static const bool weighted = true;
+    float gvalue_;
+    float hvalue_;
+
+    float value(float w) const { return gvalue_ + w * hvalue_; }
+    void set_value(float cost, float estimate) {
+        gvalue_ = cost;
+        hvalue_ = estimate;
+    }
+    void clear_value() {
+        gvalue_ = 0;
+        hvalue_ = 0;
+    }
+    void add_value(float probability, const gh_value_t &child) {
+        gvalue_ += probability * child.gvalue_;
+        hvalue_ += probability * child.hvalue_;
+    }
+    void discount_value(float cost, float discount) {
+        gvalue_ = cost + discount * gvalue_;
+        hvalue_ *= discount;
+    }
+    void add_estimate(float estimate, unsigned nsamples, unsigned new_nsamples) {
+        float new_val = hvalue_ * nsamples + estimate;
+        hvalue_ = new_val / new_nsamples;
+    }
+    void add_estimate(float cost, float discount, float estimate, unsigned nsamples, unsigned new_nsamples) {
+        float old_val = hvalue_ / discount;
+        float new_val = old_val * nsamples + estimate;
+        hvalue_ = discount * new_val / new_nsamples;
+    }
+    void print_value(std::ostream &os) const {
+        os << ",g=" << gvalue_ << ",h=" << hvalue_;
+    }
+};
 
 ////////////////////////////////////////////////
 //
 // AND/OR Tree
 //
 
-template<typename T> struct node_t {
-    float value_;
+template<typename T, typename V> struct state_node_t;
+template<typename T, typename V> struct action_node_t;
+
+// Nodes are allocated from arenas and are never deleted individually, so
+// there are no virtual methods: the kind_ tag tells which type a node_t is.
+template<typename T, typename V> struct node_t : public V {
+    enum kind_t { State, Action };
+
+    kind_t kind_;
     float delta_;
     unsigned nsamples_;
     bool in_best_policy_;
     bool in_queue_;
     bool in_pq_;
 
-    node_t(float value = 0, float delta = 0)
-      : value_(value),
-        delta_(delta),
-        nsamples_(0),
-        in_best_policy_(false),
-        in_queue_(false),
-        in_pq_(false) {
+    node_t(kind_t kind) : kind_(kind) {
+        initialize();
     }
-    virtual ~node_t() { }
 
-    virtual void print(std::ostream &os, bool indent = true) const = 0;
-    virtual void expand(const aot_t<T> *policy,
-                        std::vector<node_t<T>*> &nodes_to_propagate) = 0;
-    virtual void propagate(const aot_t<T> *policy) = 0;
+    void initialize() {
+        V::clear_value();
+        delta_ = 0;
+        nsamples_ = 0;
+        in_best_policy_ = false;
+        in_queue_ = false;
+        in_pq_ = false;
+    }
+
+    bool is_state_node() const { return kind_ == State; }
+    void print(std::ostream &os, bool indent = true) const;
+};
+
+// Edge from an action node to one of its outcomes. The edges of an action
+// node are stored contiguously, and the edges that enter a state node are
+// chained through next_parent_.
+template<typename T, typename V> struct edge_t {
+    float probability_;
+    state_node_t<T, V> *child_;
+    action_node_t<T, V> *parent_;
+    edge_t<T, V> *next_parent_;
 };
 
-template<typename T> struct state_node_t;
-template<typename T> struct action_node_t : public node_t<T> {
-    using node_t<T>::value_;
-    using node_t<T>::delta_;
+template<typename T, typename V> struct action_node_t : public node_t<T, V> {
+    using node_t<T, V>::delta_;
 
     Problem::action_t action_;
     float action_cost_;
 
-    state_node_t<T> *parent_;
-    std::vector<std::pair<float, state_node_t<T>*> > children_;
+    state_node_t<T, V> *parent_;
+    edge_t<T, V> *children_;
+    unsigned num_children_;
+
+    action_node_t() : node_t<T, V>(node_t<T, V>::Action) { }
 
-    action_node_t(Problem::action_t action) : action_(action) { }
-    virtual ~action_node_t() { }
+    void initialize(Problem::action_t action) {
+        node_t<T, V>::initialize();
+        action_ = action;
+        action_cost_ = 0;
+        parent_ = 0;
+        children_ = 0;
+        num_children_ = 0;
+    }
 
-    bool is_leaf() const { return children_.empty(); }
+    bool is_leaf() const { return num_children_ == 0; }
     void update_value(float discount) {
-        value_ = 0;
-        for( unsigned i = 0, isz = children_.size(); i < isz; ++i ) {
-            value_ += children_[i].first * children_[i].second->value_;
+        V::clear_value();
+        for( unsigned i = 0; i < num_children_; ++i ) {
+            V::add_value(children_[i].probability_, *children_[i].child_);
         }
-        value_ = action_cost_ + discount * value_;
+        V::discount_value(action_cost_, discount);
     }
 
-    virtual void print(std::ostream &os, bool indent = true) const {
+    void print(std::ostream &os, bool indent = true) const {
         if( indent ) os << std::setw(2 * parent_->depth_) << "";
-        os << "[action=" << action_
-           << ",value=" << value_
-           << ",delta=" << delta_
+        os << "[action=" << action_;
+        V::print_value(os);
+        os << ",delta=" << delta_
            << "]";
     }
-    virtual void expand(const aot_t<T> *policy,
-                        std::vector<node_t<T>*> &nodes_to_propagate) {
-        policy->expand(this, nodes_to_propagate);
-    }
-    virtual void propagate(const aot_t<T> *policy) {
-        policy->propagate(this);
-    }
 };
 
-template<typename T> struct state_node_t : public node_t<T> {
-    using node_t<T>::value_;
-    using node_t<T>::delta_;
+template<typename T, typename V> struct state_node_t : public node_t<T, V> {
+    using node_t<T, V>::delta_;
 
-    const T state_;
+    T state_;
     bool is_goal_;
     bool is_dead_end_;
     unsigned depth_;
 
-    std::vector<std::pair<int, action_node_t<T>*> > parents_;
-    std::vector<action_node_t<T>*> children_;
+    edge_t<T, V> *parents_;
+    unsigned num_parents_;
+    action_node_t<T, V> *children_;
+    unsigned num_children_;
+
+    state_node_t() : node_t<T, V>(node_t<T, V>::State) { }
+
+    void initialize(const T &state, unsigned depth) {
+        node_t<T, V>::initialize();
+        state_ = state;
+        is_goal_ = false;
+        is_dead_end_ = false;
+        depth_ = depth;
+        parents_ = 0;
+        num_parents_ = 0;
+        children_ = 0;
+        num_children_ = 0;
+    }
 
-    state_node_t(const T &state, unsigned depth = 0)
-      : state_(state),
-        is_goal_(false),
-        is_dead_end_(false),
-        depth_(depth) {
+    void add_parent(edge_t<T, V> *edge) {
+        edge->next_parent_ = parents_;
+        parents_ = edge;
+        ++num_parents_;
     }
-    virtual ~state_node_t() { }
 
     Problem::action_t best_action(bool random_ties) const {
+        float value = V::value(1.0);
         std::vector<Problem::action_t> actions;
-        actions.reserve(random_ties ? children_.size() : 1);
-        for( unsigned i = 0, isz = children_.size(); i < isz; ++i ) {
-            action_node_t<T> *a_node = children_[i];
-            if( (a_node->value_ == value_) && (random_ties || actions.empty()) ) {
+        actions.reserve(random_ties ? num_children_ : 1);
+        for( unsigned i = 0; i < num_children_; ++i ) {
+            const action_node_t<T, V> *a_node = &children_[i];
+            if( (a_node->value(1.0) == value) && (random_ties || actions.empty()) ) {
                 actions.push_back(a_node->action_);
             }
-            //std::cout << "  state=" << state_ << ", value=" << a_node->value_ << std::endl;
+            //std::cout << "  state=" << state_ << ", value=" << a_node->value(1.0) << std::endl;
         }
         return actions.empty() ? Problem::noop : actions[Random::random(actions.size())];
     }
 
     bool is_leaf() const {
-        //return is_dead_end_ || (!is_goal_ && children_.empty());
-        return is_dead_end_ || is_goal_ || children_.empty();
+        //return is_dead_end_ || (!is_goal_ && num_children_ == 0);
+        return is_dead_end_ || is_goal_ || (num_children_ == 0);
     }
-    void update_value() {
+    void update_value(float w) {
         assert(!is_goal_);
         if( !is_dead_end_ ) {
-            value_ = std::numeric_limits<float>::max();
-            for( unsigned i = 0, isz = children_.size(); i < isz; ++i ) {
-                float child_value = children_[i]->value_;
-                if( child_value < value_ ) {
-                    value_ = child_value;
+            float value = std::numeric_limits<float>::max();
+            const action_node_t<T, V> *best = 0;
+            for( unsigned i = 0; i < num_children_; ++i ) {
+                float child_value = children_[i].value(w);
+                if( child_value < value ) {
+                    value = child_value;
+                    best = &children_[i];
                 }
             }
-            assert(value_ < std::numeric_limits<float>::max());
+            assert(best != 0);
+            V::operator=(*best);
         }
     }
 
-    virtual void print(std::ostream &os, bool indent = true) const {
+    void print(std::ostream &os, bool indent = true) const {
         if( indent ) os << std::setw(2 * depth_) << "";
         os << "[state=" << state_
            << ",depth=" << depth_
-           << ",#pa=" << parents_.size()
-           << ",#chld=" << children_.size()
-           << ",value=" << value_
-           << ",delta=" << delta_
+           << ",#pa=" << num_parents_
+           << ",#chld=" << num_children_;
+        V::print_value(os);
+        os << ",delta=" << delta_
            << "]";
     }
-    virtual void expand(const aot_t<T> *policy,
-                        std::vector<node_t<T>*> &nodes_to_propagate) {
-        policy->expand(this, nodes_to_propagate);
-    }
-    virtual void propagate(const aot_t<T> *policy) {
-        policy->propagate(this);
+};
+
+template<typename T, typename V> inline void node_t<T, V>::print(std::ostream &os, bool indent) const {
+    if( is_state_node() )
+        static_cast<const state_node_t<T, V>*>(this)->print(os, indent);
+    else
+        static_cast<const action_node_t<T, V>*>(this)->print(os, indent);
+}
+
+////////////////////////////////////////////////
+//
+// Node Arena
+//
+
+// Typed arena that hands out objects from chunks that are kept across
+// decisions. Objects are never destroyed: reset() is O(1) and the caller
+// re-initializes each object when it is handed out again. allocate(n)
+// returns n contiguous objects.
+template<typename N> class arena_t {
+  protected:
+    std::vector<std::pair<N*, unsigned> > chunks_;
+    unsigned chunk_size_;
+    unsigned current_chunk_;
+    unsigned used_;
+    size_t size_;
+
+  public:
+    arena_t(unsigned chunk_size = 4096)
+      : chunk_size_(chunk_size),
+        current_chunk_(0),
+        used_(0),
+        size_(0) {
+    }
+    arena_t(const arena_t &arena) = delete;
+    ~arena_t() {
+        for( unsigned i = 0; i < chunks_.size(); ++i )
+            delete[] chunks_[i].first;
+    }
+
+    size_t size() const { return size_; }
+    void swap(arena_t &arena) {
+        chunks_.swap(arena.chunks_);
+        std::swap(chunk_size_, arena.chunk_size_);
+        std::swap(current_chunk_, arena.current_chunk_);
+        std::swap(used_, arena.used_);
+        std::swap(size_, arena.size_);
+    }
+    void reset() {
+        current_chunk_ = 0;
+        used_ = 0;
+        size_ = 0;
+    }
+
+    N* allocate(unsigned n = 1) {
+        while( (current_chunk_ < chunks_.size()) && (used_ + n > chunks_[current_chunk_].second) ) {
+            ++current_chunk_;
+            used_ = 0;
+        }
+        if( current_chunk_ == chunks_.size() ) {
+            unsigned capacity = std::max(chunk_size_, n);
+            chunks_.push_back(std::make_pair(new N[capacity], capacity));
+            COUNT_ADD(AllocatedBytes, capacity * sizeof(N));
+        }
+        N *objects = &chunks_[current_chunk_].first[used_];
+        used_ += n;
+        size_ += n;
+        return objects;
     }
 };
 
@@ -196,32 +391,32 @@ template<typename T> struct map_functions_t {
         return (p1.second == p2.second) && (*p1.first == *p2.first);
     }
     size_t operator()(const std::pair<const T*, unsigned> &p) const {
-        return p.first->hash();
+        return Hash::combine(p.first->hash(), p.second);
     }
 };
 
-template<typename T> class hash_t :
+template<typename T, typename V> class hash_t :
 #if __clang_major__ >= 5
   public std::unordered_map<std::pair<const T*, unsigned>,
-                            state_node_t<T>*,
+                            state_node_t<T, V>*,
                             map_functions_t<T>,
                             map_functions_t<T> > {
 #else
   public std::tr1::unordered_map<std::pair<const T*, unsigned>,
-                                 state_node_t<T>*,
+                                 state_node_t<T, V>*,
                                  map_functions_t<T>,
                                  map_functions_t<T> > {
 #endif
   public:
 #if __clang_major__ >= 5
     typedef typename std::unordered_map<std::pair<const T*, unsigned>,
-                                        state_node_t<T>*,
+                                        state_node_t<T, V>*,
                                         map_functions_t<T>,
                                         map_functions_t<T> >
             base_type;
 #else
     typedef typename std::tr1::unordered_map<std::pair<const T*, unsigned>,
-                                             state_node_t<T>*,
+                                             state_node_t<T, V>*,
                                              map_functions_t<T>,
                                              map_functions_t<T> >
             base_type;
@@ -238,16 +433,6 @@ template<typename T> class hash_t :
             os << "(" << it->first.first << "," << it->first.second << ")" << std::endl;
         }
     }
-    void clear() {
-        for( const_iterator it = begin(); it != end(); ++it ) {
-            state_node_t<T> *s_node = it->second;
-            for( int i = 0, isz = s_node->children_.size(); i < isz; ++i ) {
-                delete s_node->children_[i];
-            }
-            delete it->second;
-        }
-        base_type::clear();
-    }
 };
 
 ////////////////////////////////////////////////
@@ -255,35 +440,65 @@ template<typename T> class hash_t :
 // Priority Queues
 //
 
-template<typename T> struct min_priority_t {
-    bool operator()(const node_t<T> *n1, const node_t<T> *n2) const {
+template<typename T, typename V> struct min_priority_t {
+    bool operator()(const node_t<T, V> *n1, const node_t<T, V> *n2) const {
         float v1 = fabs(n1->delta_), v2 = fabs(n2->delta_);
         return v1 > v2;
     }
 };
 
-template<typename T> struct max_priority_t {
-    bool operator()(const node_t<T> *n1, const node_t<T> *n2) const {
+template<typename T, typename V> struct max_priority_t {
+    bool operator()(const node_t<T, V> *n1, const node_t<T, V> *n2) const {
         float v1 = fabs(n1->delta_), v2 = fabs(n2->delta_);
         return v2 > v1;
     }
 };
 
-template<typename T> class priority_queue_t :
-  public std::priority_queue<node_t<T>*,
-                             std::vector<node_t<T>*>,
-                             min_priority_t<T> > {
+template<typename T, typename V> class priority_queue_t :
+  public std::priority_queue<node_t<T, V>*,
+                             std::vector<node_t<T, V>*>,
+                             min_priority_t<T, V> > {
+};
+
+template<typename T, typename V> class bdd_heap_queue_t :
+  public std::bdd_priority_queue<node_t<T, V>*,
+                                 min_priority_t<T, V>,
+                                 max_priority_t<T, V> > {
+  public:
+    bdd_heap_queue_t(unsigned capacity)
+      : std::bdd_priority_queue<node_t<T, V>*,
+                                min_priority_t<T, V>,
+                                max_priority_t<T, V> >(capacity) { }
+};
+
+template<typename T, typename V> class bdd_sorted_queue_t :
+  public std::bdd_sorted_queue<node_t<T, V>*,
+                               min_priority_t<T, V>,
+                               max_priority_t<T, V> > {
+  public:
+    bdd_sorted_queue_t(unsigned capacity)
+      : std::bdd_sorted_queue<node_t<T, V>*,
+                              min_priority_t<T, V>,
+                              max_priority_t<T, V> >(capacity) { }
+};
+
+// Bounded queue of tips for the queue strategy Q: the dual heap for
+// heap_queue_t (queue=heap) or the sorted array for sorted_queue_t
+// (queue=sorted). Both keep the capacity best tips, but may break ties
+// between tips with equal |delta| differently.
+template<typename T, typename V, typename Q> struct bdd_queue_type_t;
+template<typename T, typename V> struct bdd_queue_type_t<T, V, heap_queue_t> {
+    typedef bdd_heap_queue_t<T, V> type;
+};
+template<typename T, typename V> struct bdd_queue_type_t<T, V, sorted_queue_t> {
+    typedef bdd_sorted_queue_t<T, V> type;
 };
 
-template<typename T> class bdd_priority_queue_t :
-  public std::bdd_priority_queue<node_t<T>*,
-                                 min_priority_t<T>,
-                                 max_priority_t<T> > {
+template<typename T, typename V, typename Q> class bdd_priority_queue_t :
+  public bdd_queue_type_t<T, V, Q>::type {
   public:
     bdd_priority_queue_t(unsigned capacity)
-      : std::bdd_priority_queue<node_t<T>*,
-                                min_priority_t<T>,
-                                max_priority_t<T> >(capacity) { }
+      : bdd_queue_type_t<T, V, Q>::type(capacity) { }
 };
 
 ////////////////////////////////////////////////
@@ -291,7 +506,12 @@ template<typename T> class bdd_priority_queue_t :
 // Policy
 //
 
-template<typename T> class aot_t : public improvement_t<T> {
+template<typename T,
+         typename S = delta_selection_t,
+         typename V = plain_value_t,
+         typename E = node_expansion_t,
+         typename Q = heap_queue_t>
+class aot_t : public improvement_t<T> {
   using policy_t<T>::problem_;
   using improvement_t<T>::base_policy_;
   protected:
@@ -303,34 +523,71 @@ template<typename T> class aot_t : public improvement_t<T> {
     unsigned expansions_per_iteration_;
     unsigned leaf_nsamples_;
     unsigned delayed_evaluation_nsamples_;
-    int leaf_selection_strategy_;
+    float w_;
+    unsigned num_threads_;
+    bool reuse_tree_;
     mutable unsigned num_nodes_;
-    mutable hash_t<T> table_;
+    mutable hash_t<T, V> table_;
+    mutable Hash::bucket_stats_t table_stats_;
+
+    // storage for the tree, recycled at each decision
+    mutable arena_t<state_node_t<T, V> > state_nodes_;
+    mutable arena_t<action_node_t<T, V> > action_nodes_;
+    mutable arena_t<edge_t<T, V> > edges_;
+
+    // tree reuse: the root and action of the last decision, and the storage
+    // into which the subtree below the next root is copied
+    mutable state_node_t<T, V> *last_root_;
+    mutable Problem::action_t last_action_;
+    mutable hash_t<T, V> spare_table_;
+    mutable arena_t<state_node_t<T, V> > spare_state_nodes_;
+    mutable arena_t<action_node_t<T, V> > spare_action_nodes_;
+    mutable arena_t<edge_t<T, V> > spare_edges_;
+
+    // nodes pending propagation, bucketed by depth of the (parent) state node
+    mutable std::vector<std::vector<state_node_t<T, V>*> > state_buckets_;
+    mutable std::vector<std::vector<action_node_t<T, V>*> > action_buckets_;
+    mutable int dirty_depth_;
+
+    // evaluation of tips: a rollout for a new leaf, a re-sample of an
+    // existing leaf, a delayed evaluation of a new action node, or a
+    // re-sample of a sibling action node. With threads > 1, the rollouts
+    // requested while expanding a batch of tips are deferred and computed
+    // in parallel before the values are propagated.
+    struct evaluation_t {
+        enum kind_t { Leaf, Resample, Action, Sibling };
+        kind_t kind_;
+        node_t<T, V> *node_;
+        unsigned long long seed_;
+        float value_;
+        evaluation_t(kind_t kind, node_t<T, V> *node)
+          : kind_(kind), node_(node), seed_(0), value_(0) { }
+    };
+    mutable std::vector<evaluation_t> evaluations_;
+    mutable Parallel::thread_pool_t *pool_;
+    mutable std::vector<const policy_t<T>*> worker_policies_;
 
     // only used for aot/heuristic
     mutable const Heuristic::heuristic_t<T> *heuristic_;
 
+    // queues of tips, and the file where their operations are recorded
+    // (queue-trace) to be replayed by bench/queue_bench
+    mutable std::ofstream *queue_trace_;
 #ifdef USE_BDD_PQ
-    mutable bdd_priority_queue_t<T> inside_bdd_priority_queue_;
-    mutable bdd_priority_queue_t<T> outside_bdd_priority_queue_;
+    mutable bdd_priority_queue_t<T, V, Q> inside_bdd_priority_queue_;
+    mutable bdd_priority_queue_t<T, V, Q> outside_bdd_priority_queue_;
 #else
-    mutable priority_queue_t<T> inside_priority_queue_;
-    mutable priority_queue_t<T> outside_priority_queue_;
+    mutable priority_queue_t<T, V> inside_priority_queue_;
+    mutable priority_queue_t<T, V> outside_priority_queue_;
 #endif
     mutable float from_inside_;
     mutable float from_outside_;
 
-    mutable node_t<T> *random_leaf_; // only used for random leaf selection strategy
+    mutable node_t<T, V> *random_leaf_; // only used for random selection
 
     mutable unsigned total_number_expansions_;
     mutable unsigned total_evaluations_;
-
-    // abstraction of selection strategy
-    void (aot_t::*setup_expansion_loop_ptr_)(state_node_t<T>*) const;
-    void (aot_t::*prepare_next_expansion_iteration_ptr_)(state_node_t<T>*) const;
-    bool (aot_t::*exist_nodes_to_expand_ptr_)() const;
-    node_t<T>* (aot_t::*select_node_for_expansion_ptr_)(state_node_t<T>*) const;
-    void (aot_t::*clear_internal_state_ptr_)() const;
+    mutable unsigned total_reused_nodes_;
 
     aot_t(const Problem::problem_t<T> &problem,
           const policy_t<T> *base_policy,
@@ -342,7 +599,9 @@ template<typename T> class aot_t : public improvement_t<T> {
           unsigned expansions_per_iteration,
           unsigned leaf_nsamples,
           unsigned delayed_evaluation_nsamples,
-          int leaf_selection_strategy)
+          float w,
+          unsigned num_threads,
+          bool reuse_tree)
       : improvement_t<T>(problem, base_policy),
         width_(width),
         horizon_(horizon),
@@ -352,9 +611,16 @@ template<typename T> class aot_t : public improvement_t<T> {
         expansions_per_iteration_(std::max<unsigned>(1, expansions_per_iteration)),
         leaf_nsamples_(leaf_nsamples),
         delayed_evaluation_nsamples_(delayed_evaluation_nsamples),
-        leaf_selection_strategy_(leaf_selection_strategy),
+        w_(w),
+        num_threads_(num_threads),
+        reuse_tree_(reuse_tree),
         num_nodes_(0),
+        last_root_(0),
+        last_action_(Problem::noop),
+        dirty_depth_(-1),
+        pool_(0),
         heuristic_(0),
+        queue_trace_(0),
 #ifdef USE_BDD_PQ
         inside_bdd_priority_queue_(expansions_per_iteration_),
         outside_bdd_priority_queue_(expansions_per_iteration_),
@@ -363,9 +629,8 @@ template<typename T> class aot_t : public improvement_t<T> {
         from_outside_(0),
         random_leaf_(0),
         total_number_expansions_(0),
-        total_evaluations_(0) {
-        clear_leaf_selection_strategy();
-        set_leaf_selection_strategy(leaf_selection_strategy_);
+        total_evaluations_(0),
+        total_reused_nodes_(0) {
     }
 
   public:
@@ -379,9 +644,16 @@ template<typename T> class aot_t : public improvement_t<T> {
         expansions_per_iteration_(1),
         leaf_nsamples_(1),
         delayed_evaluation_nsamples_(0),
-        leaf_selection_strategy_(0),
+        w_(1),
+        num_threads_(1),
+        reuse_tree_(false),
         num_nodes_(0),
+        last_root_(0),
+        last_action_(Problem::noop),
+        dirty_depth_(-1),
+        pool_(0),
         heuristic_(0),
+        queue_trace_(0),
 #ifdef USE_BDD_PQ
         inside_bdd_priority_queue_(expansions_per_iteration_),
         outside_bdd_priority_queue_(expansions_per_iteration_),
@@ -390,26 +662,33 @@ template<typename T> class aot_t : public improvement_t<T> {
         from_outside_(0),
         random_leaf_(0),
         total_number_expansions_(0),
-        total_evaluations_(0) {
-        clear_leaf_selection_strategy();
-        set_leaf_selection_strategy(leaf_selection_strategy_);
+        total_evaluations_(0),
+        total_reused_nodes_(0) {
+    }
+    virtual ~aot_t() {
+        clear_workers();
+        delete queue_trace_;
     }
-    virtual ~aot_t() { }
     virtual policy_t<T>* clone() const {
-        return new aot_t(problem_,
-                         base_policy_,
-                         width_,
-                         horizon_,
-                         probability_,
-                         random_ties_,
-                         delayed_evaluation_,
-                         expansions_per_iteration_,
-                         leaf_nsamples_,
-                         delayed_evaluation_nsamples_,
-                         leaf_selection_strategy_);
+        aot_t *policy = new aot_t(problem_,
+                                  base_policy_,
+                                  width_,
+                                  horizon_,
+                                  probability_,
+                                  random_ties_,
+                                  delayed_evaluation_,
+                                  expansions_per_iteration_,
+                                  leaf_nsamples_,
+                                  delayed_evaluation_nsamples_,
+                                  w_,
+                                  num_threads_,
+                                  reuse_tree_);
+        policy->set_heuristic(heuristic_);
+        return policy;
     }
     virtual std::string name() const {
-        return std::string("aot(policy=") + (base_policy_ == 0 ? std::string("null") : base_policy_->name()) +
+        return std::string("aot") + (V::weighted ? "-gh" : "") + (E::path ? "-path" : "") +
+          std::string("(policy=") + (base_policy_ == 0 ? std::string("null") : base_policy_->name()) +
           std::string(",width=") + std::to_string(width_) +
           std::string(",horizon=") + std::to_string(horizon_) +
           std::string(",probability=") + std::to_string(probability_) +
@@ -418,7 +697,11 @@ template<typename T> class aot_t : public improvement_t<T> {
           std::string(",expansions-per-iter=") + std::to_string(expansions_per_iteration_) +
           std::string(",leaf-nsamples=") + std::to_string(leaf_nsamples_) +
           std::string(",delayed-eval-nsamples=") + std::to_string(delayed_evaluation_nsamples_) +
-          std::string(",leaf-selection=") + std::to_string(leaf_selection_strategy_) + ")";
+          (V::weighted ? std::string(",w=") + std::to_string(w_) : std::string("")) +
+          std::string(",leaf-selection=") + S::name() +
+          std::string(",threads=") + std::to_string(num_threads_) +
+          std::string(",reuse-tree=") + (reuse_tree_ ? "true" : "false") +
+          std::string(",queue=") + Q::name() + ")";
     }
 
     void set_heuristic(const Heuristic::heuristic_t<T> *heuristic) const {
@@ -430,46 +713,64 @@ template<typename T> class aot_t : public improvement_t<T> {
             std::cout << Utils::error() << "(base) policy or heuristic must be specified for aot() policy!" << std::endl;
             exit(1);
         }
+        if( E::path && ((base_policy_ == 0) || (heuristic_ == 0)) ) {
+            std::cout << Utils::error() << "both (base) policy and heuristic must be specified for aot-path() policy!" << std::endl;
+            exit(1);
+        }
 
-        // initialize tree and setup expansion loop for selection strategy
+        // initialize tree (or re-root the last one) and setup expansion
+        // loop for selection strategy
         ++policy_t<T>::decisions_;
-        clear();
-        state_node_t<T> *root = fetch_node(s, 0).first;
-        (this->*setup_expansion_loop_ptr_)(root);
+        state_node_t<T, V> *root = reuse_tree_ ? reroot(s) : 0;
+        if( root == 0 ) {
+            clear();
+            root = fetch_node(s, 0).first;
+        }
+        setup_expansion_loop(root, S());
 
         // expand leaves and propagate values
         unsigned expanded = 0;
-        std::vector<node_t<T>*> nodes_to_propagate;
-        for( unsigned i = 0; (i < width_) && (this->*exist_nodes_to_expand_ptr_)(); ) {
+        std::vector<node_t<T, V>*> nodes_to_propagate;
+        for( unsigned i = 0; (i < width_) && exist_nodes_to_expand(S()); ) {
+            Trace::scope_t scope("expansion-batch");
             unsigned expanded_in_iteration = 0;
             while( (i < width_) &&
                    (expanded_in_iteration < expansions_per_iteration_) &&
-                   (this->*exist_nodes_to_expand_ptr_)() ) {
+                   exist_nodes_to_expand(S()) ) {
                 select_and_expand(root, nodes_to_propagate);
-                for( int j = 0, jsz = nodes_to_propagate.size(); j < jsz; ++j )
-                    propagate(nodes_to_propagate[j]);
-                nodes_to_propagate.clear();
                 ++expanded_in_iteration;
                 ++i;
             }
+            if( !evaluations_.empty() ) {
+                evaluate_deferred();
+                for( int j = 0, jsz = nodes_to_propagate.size(); j < jsz; ++j ) {
+                    if( !nodes_to_propagate[j]->is_state_node() )
+                        static_cast<action_node_t<T, V>*>(nodes_to_propagate[j])->update_value(problem_.discount());
+                }
+            }
+            for( int j = 0, jsz = nodes_to_propagate.size(); j < jsz; ++j )
+                propagate(nodes_to_propagate[j]);
+            nodes_to_propagate.clear();
+            flush_propagation();
             expanded += expanded_in_iteration;
-            (this->*prepare_next_expansion_iteration_ptr_)(root);
+            prepare_next_expansion_iteration(root, S());
         }
-        (this->*clear_internal_state_ptr_)();
+        clear_internal_state(S());
 
 #if 0
-        std::cout << "[1] value at root = " << root->value_ << std::endl;
+        std::cout << "[1] value at root = " << root->value(w_) << std::endl;
         for( Problem::action_t a = 0; a < problem_.number_actions(root->state_); ++a ) {
             if( problem_.applicable(root->state_, a) ) {
                 double value = 0;
                 std::vector<std::pair<T, float> > outcomes;
+                COUNT(NextPolicy);
                 problem_.next(root->state_, a, outcomes, true);
                 for( int i = 0, isz = outcomes.size(); i < isz; ++i ) {
                     const T &state = outcomes[i].first;
                     float prob = outcomes[i].second;
-                    std::pair<state_node_t<T>*, bool> p = fetch_node(state, 1);
-                    value += prob * p.first->value_;
-                    std::cout << "    outcome " << i << ": prob = " << prob << ", value = " << p.first->value_ << std::endl;
+                    std::pair<state_node_t<T, V>*, bool> p = fetch_node(state, 1);
+                    value += prob * p.first->value(w_);
+                    std::cout << "    outcome " << i << ": prob = " << prob << ", value = " << p.first->value(w_) << std::endl;
                     p.first->print(std::cout); std::cout << std::endl;
                 }
                 value = problem_.cost(root->state_, a) + problem_.discount() * value;
@@ -483,12 +784,13 @@ template<typename T> class aot_t : public improvement_t<T> {
 
         // select best action
         if( width_ == 0 ) {
-            float start_time = Utils::read_time_in_seconds();
-            Problem::action_t action = (*base_policy_)(s);
-            policy_t<T>::base_policy_time_ += Utils::read_time_in_seconds() - start_time;
-            return action;
+            Utils::sampled_timer_t timer(policy_t<T>::base_policy_time_, policy_t<T>::base_policy_calls_++);
+            return (*base_policy_)(s);
         } else {
-            return root->best_action(random_ties_);
+            Problem::action_t action = root->best_action(random_ties_);
+            last_root_ = root;
+            last_action_ = action;
+            return action;
         }
     }
 
@@ -497,10 +799,23 @@ template<typename T> class aot_t : public improvement_t<T> {
         policy_t<T>::base_policy_time_ = 0;
         policy_t<T>::heuristic_time_ = 0;
         problem_.clear_expansions();
+        table_stats_.clear();
         if( base_policy_ != 0 ) base_policy_->reset_stats();
         if( heuristic_ != 0 ) heuristic_->reset_stats();
     }
 
+    virtual void add_stats(const policy_t<T> &policy) const {
+        improvement_t<T>::add_stats(policy);
+        const aot_t *clone = dynamic_cast<const aot_t*>(&policy);
+        if( clone != 0 ) {
+            from_inside_ += clone->from_inside_;
+            from_outside_ += clone->from_outside_;
+            total_number_expansions_ += clone->total_number_expansions_;
+            total_evaluations_ += clone->total_evaluations_;
+            total_reused_nodes_ += clone->total_reused_nodes_;
+        }
+    }
+
     virtual void print_other_stats(std::ostream &os, int indent) const {
         os << std::setw(indent) << ""
            << "other-stats: name=" << name()
@@ -509,9 +824,21 @@ template<typename T> class aot_t : public improvement_t<T> {
            << " %out=" << from_outside_ / (from_inside_ + from_outside_)
            << " #expansions=" << total_number_expansions_
            << " #evaluations=" << total_evaluations_
+           << " #reused-nodes=" << total_reused_nodes_
            << std::endl;
+        if( Hash::stats_enabled() ) table_stats_.with(table_).print(os, 2 + indent, "aot");
         if( base_policy_ != 0 ) base_policy_->print_other_stats(os, 2 + indent);
     }
+    virtual void record_other_stats(Stats::record_t &record, const std::string &prefix) const {
+        policy_t<T>::record_other_stats(record, prefix);
+        record.add(prefix + "%in", from_inside_ / (from_inside_ + from_outside_))
+              .add(prefix + "%out", from_outside_ / (from_inside_ + from_outside_))
+              .add(prefix + "#expansions", total_number_expansions_)
+              .add(prefix + "#evaluations", total_evaluations_)
+              .add(prefix + "#reused-nodes", total_reused_nodes_);
+        if( Hash::stats_enabled() ) table_stats_.with(table_).record(record, prefix + "hash.");
+        if( base_policy_ != 0 ) base_policy_->record_other_stats(record, prefix + "base.");
+    }
     virtual void set_parameters(const std::multimap<std::string, std::string> &parameters, Dispatcher::dispatcher_t<T> &dispatcher) {
         std::multimap<std::string, std::string>::const_iterator it = parameters.find("width");
         if( it != parameters.end() ) width_ = strtol(it->second.c_str(), 0, 0);
@@ -521,8 +848,25 @@ template<typename T> class aot_t : public improvement_t<T> {
         if( it != parameters.end() ) probability_ = strtod(it->second.c_str(), 0);
         it = parameters.find("expansions-per-iteration");
         if( it != parameters.end() ) expansions_per_iteration_ = strtol(it->second.c_str(), 0, 0);
+        it = parameters.find("w");
+        if( it != parameters.end() ) w_ = strtod(it->second.c_str(), 0);
         it = parameters.find("random-ties");
         if( it != parameters.end() ) random_ties_ = it->second == "true";
+        it = parameters.find("threads");
+        if( it != parameters.end() ) num_threads_ = strtol(it->second.c_str(), 0, 0);
+        if( (num_threads_ > 1) && !problem_.concurrent() ) {
+            std::cout << Utils::error() << "aot() policy with threads > 1 requires a problem that supports concurrent calls!" << std::endl;
+            exit(1);
+        }
+        it = parameters.find("reuse-tree");
+        if( it != parameters.end() ) reuse_tree_ = it->second == "true";
+        set_queue_capacity();
+        it = parameters.find("queue-trace");
+        if( it != parameters.end() ) {
+            delete queue_trace_;
+            queue_trace_ = new std::ofstream(it->second.c_str());
+            *queue_trace_ << std::setprecision(9) << "capacity " << inside_bdd_priority_queue_.capacity() << "\n";
+        }
         it = parameters.find("policy");
         if( it != parameters.end() ) {
             delete base_policy_;
@@ -535,6 +879,7 @@ template<typename T> class aot_t : public improvement_t<T> {
             dispatcher.create_request(problem_, it->first, it->second);
             heuristic_ = dispatcher.fetch_heuristic(it->second);
         }
+        clear_workers();
         policy_t<T>::setup_time_ = base_policy_ == 0 ? 0 : base_policy_->setup_time();
         policy_t<T>::setup_time_ += heuristic_ == 0 ? 0 : heuristic_->setup_time();
 
@@ -545,6 +890,10 @@ template<typename T> class aot_t : public improvement_t<T> {
                   << " probability=" << probability_
                   << " expansions-per-iteration=" << expansions_per_iteration_
                   << " random-ties=" << (random_ties_ ? "true" : "false")
+                  << " w=" << w_
+                  << " threads=" << num_threads_
+                  << " reuse-tree=" << (reuse_tree_ ? "true" : "false")
+                  << " queue=" << Q::name()
                   << " policy=" << (base_policy_ == 0 ? std::string("null") : base_policy_->name())
                   << " heuristic=" << (heuristic_ == 0 ? std::string("null") : heuristic_->name())
                   << std::endl;
@@ -561,34 +910,112 @@ template<typename T> class aot_t : public improvement_t<T> {
 
     // clear data structures
     void clear_table() const {
+        if( Hash::stats_enabled() ) table_stats_.add(table_);
         table_.clear();
     }
     void clear() const {
         clear_table();
+        state_nodes_.reset();
+        action_nodes_.reset();
+        edges_.reset();
+        num_nodes_ = 0;
+        last_root_ = 0;
+    }
+
+    // re-root the tree at the node for state s below the action taken in
+    // the last decision. The sub-DAG below the new root is copied into the
+    // spare storage with depths decreased by one, which is then swapped
+    // with the current storage. Returns null if there is no such node.
+    state_node_t<T, V>* reroot(const T &s) const {
+        if( last_root_ == 0 ) return 0;
+        state_node_t<T, V> *node = 0;
+        for( unsigned i = 0; (node == 0) && (i < last_root_->num_children_); ++i ) {
+            const action_node_t<T, V> *a_node = &last_root_->children_[i];
+            if( a_node->action_ != last_action_ ) continue;
+            for( unsigned j = 0; j < a_node->num_children_; ++j ) {
+                if( a_node->children_[j].child_->state_ == s ) {
+                    node = a_node->children_[j].child_;
+                    break;
+                }
+            }
+        }
+        last_root_ = 0;
+        if( (node == 0) || node->is_goal_ || node->is_dead_end_ ) return 0;
+
         num_nodes_ = 0;
+        state_node_t<T, V> *root = relocate(node);
+        total_reused_nodes_ += num_nodes_;
+
+        table_.swap(spare_table_);
+        state_nodes_.swap(spare_state_nodes_);
+        action_nodes_.swap(spare_action_nodes_);
+        edges_.swap(spare_edges_);
+        spare_table_.clear();
+        spare_state_nodes_.reset();
+        spare_action_nodes_.reset();
+        spare_edges_.reset();
+        return root;
+    }
+    state_node_t<T, V>* relocate(const state_node_t<T, V> *s_node) const {
+        unsigned depth = s_node->depth_ - 1;
+        typename hash_t<T, V>::iterator it = spare_table_.find(std::make_pair(&s_node->state_, depth));
+        if( it != spare_table_.end() ) return it->second;
+
+        ++num_nodes_;
+        state_node_t<T, V> *copy = spare_state_nodes_.allocate();
+        copy->initialize(s_node->state_, depth);
+        static_cast<V&>(*copy) = *s_node;
+        copy->nsamples_ = s_node->nsamples_;
+        copy->is_goal_ = s_node->is_goal_;
+        copy->is_dead_end_ = s_node->is_dead_end_;
+        spare_table_.insert(std::make_pair(std::make_pair(&copy->state_, depth), copy));
+
+        copy->children_ = spare_action_nodes_.allocate(s_node->num_children_);
+        for( unsigned i = 0; i < s_node->num_children_; ++i ) {
+            const action_node_t<T, V> *a_node = &s_node->children_[i];
+            ++num_nodes_;
+            action_node_t<T, V> *a_copy = &copy->children_[copy->num_children_++];
+            a_copy->initialize(a_node->action_);
+            a_copy->action_cost_ = a_node->action_cost_;
+            static_cast<V&>(*a_copy) = *a_node;
+            a_copy->nsamples_ = a_node->nsamples_;
+            a_copy->parent_ = copy;
+            if( !a_node->is_leaf() ) {
+                edge_t<T, V> *edges = spare_edges_.allocate(a_node->num_children_);
+                for( unsigned j = 0; j < a_node->num_children_; ++j ) {
+                    edges[j].probability_ = a_node->children_[j].probability_;
+                    edges[j].child_ = relocate(a_node->children_[j].child_);
+                    edges[j].parent_ = a_copy;
+                    edges[j].child_->add_parent(&edges[j]);
+                }
+                a_copy->children_ = edges;
+                a_copy->num_children_ = a_node->num_children_;
+            }
+        }
+        return copy;
     }
 
     // lookup a node in hash table; if not found, create a new entry.
-    std::pair<state_node_t<T>*, bool> fetch_node(const T &state, unsigned depth, bool debug = false) const {
-        typename hash_t<T>::iterator it = table_.find(std::make_pair(&state, depth));
+    std::pair<state_node_t<T, V>*, bool> fetch_node(const T &state, unsigned depth, bool debug = false) const {
+        typename hash_t<T, V>::iterator it = table_.find(std::make_pair(&state, depth));
         if( it == table_.end() ) {
             if( debug ) std::cout << "fetch_node: node was NOT-FOUND" << std::endl;
             ++num_nodes_;
-            state_node_t<T> *node = new state_node_t<T>(state, depth);
+            state_node_t<T, V> *node = state_nodes_.allocate();
+            node->initialize(state, depth);
             table_.insert(std::make_pair(std::make_pair(&node->state_, depth),
                                          node));
             if( problem_.terminal(state) ) {
                 if( debug ) std::cout << "fetch_node: node is TERMINAL" << std::endl;
-                node->value_ = 0;
+                node->set_value(0, 0);
                 node->is_goal_ = true;
             } else if( problem_.dead_end(state) ) {
                 if( debug ) std::cout << "fetch_node: node is DEAD-END" << std::endl;
-                node->value_ = problem_.dead_end_value();
+                node->set_value(problem_.dead_end_value(), 0);
                 node->is_dead_end_ = true;
             } else {
                 if( debug ) std::cout << "fetch_node: node is REGULAR" << std::endl;
-                node->value_ = evaluate(state, depth);
-                node->nsamples_ = leaf_nsamples_;
+                request_evaluation(evaluation_t::Leaf, node);
             }
             return std::make_pair(node, false);
         } else {
@@ -596,10 +1023,7 @@ template<typename T> class aot_t : public improvement_t<T> {
             bool re_evaluated = false;
             if( it->second->is_leaf() && !it->second->is_dead_end_ && !it->second->is_goal_ && (heuristic_ == 0) ) {
                 // resample: throw other rollouts to get better estimation. Only done when heuristic_ == 0
-                float old_val = it->second->value_;
-                float new_val = old_val * it->second->nsamples_ + evaluate(state, depth);
-                it->second->nsamples_ += leaf_nsamples_;
-                it->second->value_ = new_val / it->second->nsamples_;
+                request_evaluation(evaluation_t::Resample, it->second);
                 re_evaluated = true;
             }
             return std::make_pair(it->second, re_evaluated);
@@ -607,77 +1031,86 @@ template<typename T> class aot_t : public improvement_t<T> {
     }
 
     // expansion of state and action nodes. The binding of appropriate method
-    // is done at run-time with virtual methods
-    void select_and_expand(state_node_t<T> *root,
-                           std::vector<node_t<T>*> &nodes_to_propagate) const {
+    // is done with the kind tag of the node
+    void select_and_expand(state_node_t<T, V> *root,
+                           std::vector<node_t<T, V>*> &nodes_to_propagate) const {
         ++total_number_expansions_;
-        node_t<T> *node = (this->*select_node_for_expansion_ptr_)(root);
-        if( node != 0 ) node->expand(this, nodes_to_propagate);
-    }
-    void expand(action_node_t<T> *a_node,
-                std::vector<node_t<T>*> &nodes_to_propagate,
+        COUNT(Expansions);
+        node_t<T, V> *node = select_node_for_expansion(root, S());
+        if( node != 0 ) expand(node, nodes_to_propagate, E());
+    }
+    void expand(node_t<T, V> *node,
+                std::vector<node_t<T, V>*> &nodes_to_propagate,
+                node_expansion_t) const {
+        if( node->is_state_node() )
+            expand(static_cast<state_node_t<T, V>*>(node), nodes_to_propagate);
+        else
+            expand(static_cast<action_node_t<T, V>*>(node), nodes_to_propagate);
+    }
+    void expand(node_t<T, V> *node,
+                std::vector<node_t<T, V>*> &nodes_to_propagate,
+                path_expansion_t) const {
+        if( node->is_state_node() )
+            expand_path(static_cast<state_node_t<T, V>*>(node), nodes_to_propagate);
+        else
+            expand_path(static_cast<action_node_t<T, V>*>(node), nodes_to_propagate);
+    }
+    void expand(action_node_t<T, V> *a_node,
+                std::vector<node_t<T, V>*> &nodes_to_propagate,
                 bool picked_from_queue = true) const {
         assert(a_node->is_leaf());
         assert(!a_node->parent_->is_goal_);
         assert(!a_node->parent_->is_dead_end_);
-        a_node->value_ = 0;
+        a_node->clear_value();
         std::vector<std::pair<T, float> > outcomes;
+        COUNT(NextPolicy);
         problem_.next(a_node->parent_->state_, a_node->action_, outcomes);
-        a_node->children_.reserve(outcomes.size());
+        edge_t<T, V> *edges = edges_.allocate(outcomes.size());
         for( int i = 0, isz = outcomes.size(); i < isz; ++i ) {
             const T &state = outcomes[i].first;
             float prob = outcomes[i].second;
-            std::pair<state_node_t<T>*, bool> p = fetch_node(state, 1 + a_node->parent_->depth_);
+            std::pair<state_node_t<T, V>*, bool> p = fetch_node(state, 1 + a_node->parent_->depth_);
             if( p.second ) {
                 assert(p.first->is_leaf());
                 nodes_to_propagate.push_back(p.first);
             }
-            p.first->parents_.push_back(std::make_pair(i, a_node));
-            a_node->children_.push_back(std::make_pair(prob, p.first));
-            a_node->value_ += prob * p.first->value_;
+            edges[i].probability_ = prob;
+            edges[i].child_ = p.first;
+            edges[i].parent_ = a_node;
+            p.first->add_parent(&edges[i]);
+            a_node->add_value(prob, *p.first);
         }
-        a_node->value_ = a_node->action_cost_ + problem_.discount() * a_node->value_;
+        a_node->children_ = edges;
+        a_node->num_children_ = outcomes.size();
+        a_node->discount_value(a_node->action_cost_, problem_.discount());
         nodes_to_propagate.push_back(a_node);
 
         // re-sample sibling action nodes that are still leaves.
         if( picked_from_queue && (heuristic_ == 0)) {
-            state_node_t<T> *parent = a_node->parent_;
-            const T &state = parent->state_;
-            unsigned depth = 1 + parent->depth_;
-            for( int i = 0, isz = parent->children_.size(); i < isz; ++i ) {
-                action_node_t<T> *sibling = parent->children_[i];
+            state_node_t<T, V> *parent = a_node->parent_;
+            for( unsigned i = 0; i < parent->num_children_; ++i ) {
+                action_node_t<T, V> *sibling = &parent->children_[i];
                 if( sibling->is_leaf() ) {
-                    float old_val = (sibling->value_ - sibling->action_cost_) / problem_.discount();
-                    float eval = evaluate(state, sibling->action_, depth);
-                    float new_val = old_val * sibling->nsamples_ + eval;
-                    sibling->nsamples_ +=
-                      delayed_evaluation_nsamples_ * leaf_nsamples_;
-                    sibling->value_ = sibling->action_cost_ +
-                      problem_.discount() * new_val/sibling->nsamples_;
-
-#ifdef DEBUG
-                    std::cout << "sibling re-sampled: "
-                              << "num=" << sibling->nsamples_
-                              << std::endl;
-#endif
+                    request_evaluation(evaluation_t::Sibling, sibling);
                 }
             }
         }
     }
-    void expand(state_node_t<T> *s_node,
-                std::vector<node_t<T>*> &nodes_to_propagate) const {
+    void expand(state_node_t<T, V> *s_node,
+                std::vector<node_t<T, V>*> &nodes_to_propagate) const {
         assert(s_node->is_leaf());
         assert(!s_node->is_goal_);
         assert(!s_node->is_dead_end_);
-        s_node->children_.reserve(problem_.number_actions(s_node->state_));
-        for( Problem::action_t a = 0; a < problem_.number_actions(s_node->state_); ++a ) {
+        int num_actions = problem_.number_actions(s_node->state_);
+        s_node->children_ = action_nodes_.allocate(num_actions);
+        for( Problem::action_t a = 0; a < num_actions; ++a ) {
             if( problem_.applicable(s_node->state_, a) ) {
                 // create node for this action
                 ++num_nodes_;
-                action_node_t<T> *a_node = new action_node_t<T>(a);
+                action_node_t<T, V> *a_node = &s_node->children_[s_node->num_children_++];
+                a_node->initialize(a);
                 a_node->action_cost_ = problem_.cost(s_node->state_, a);
                 a_node->parent_ = s_node;
-                s_node->children_.push_back(a_node);
 
                 // expand node
                 if( !delayed_evaluation_ ) {
@@ -686,46 +1119,160 @@ template<typename T> class aot_t : public improvement_t<T> {
                     // instead of full-width expansion to calculate value,
                     // estimate by sampling states and applying rollouts
                     // of base policy
-                    float eval = evaluate(s_node->state_, a, 1+s_node->depth_);
-                    a_node->value_ = a_node->action_cost_ + problem_.discount() * eval;
-                    a_node->nsamples_ = delayed_evaluation_nsamples_ * leaf_nsamples_;
+                    request_evaluation(evaluation_t::Action, a_node);
                 }
             }
         }
         nodes_to_propagate.push_back(s_node);
     }
 
-    // propagate new values bottom-up using BFS and stopping when values changes no further
-    void propagate(node_t<T> *node) const {
-        node->propagate(this);
+    // path expansion (aot-path): a state node is expanded as usual, and the
+    // action chosen by the base policy is expanded further along an outcome
+    // sampled at random until reaching the horizon or a tip of the tree
+    void expand_path(action_node_t<T, V> *a_node,
+                     std::vector<node_t<T, V>*> &nodes_to_propagate) const {
+        assert(a_node->is_leaf());
+        assert(!a_node->parent_->is_goal_);
+        assert(!a_node->parent_->is_dead_end_);
+        assert(heuristic_ != 0); // no re-sampling because we use heuristic
+        a_node->clear_value();
+        std::vector<std::pair<T, float> > outcomes;
+        COUNT(NextPolicy);
+        problem_.next(a_node->parent_->state_, a_node->action_, outcomes);
+
+        int sampled_child = 0;
+        float r = Random::real();
+        for( int i = 0, isz = outcomes.size(); i < isz; ++i ) {
+            if( r < outcomes[i].second ) {
+                sampled_child = i;
+                break;
+            }
+            r -= outcomes[i].second;
+        }
+
+        edge_t<T, V> *edges = edges_.allocate(outcomes.size());
+        for( int i = 0, isz = outcomes.size(); i < isz; ++i ) {
+            const T &state = outcomes[i].first;
+            float prob = outcomes[i].second;
+            std::pair<state_node_t<T, V>*, bool> p = fetch_node(state, 1 + a_node->parent_->depth_);
+            assert(!p.second);
+            edges[i].probability_ = prob;
+            edges[i].child_ = p.first;
+            edges[i].parent_ = a_node;
+            p.first->add_parent(&edges[i]);
+        }
+        a_node->children_ = edges;
+        a_node->num_children_ = outcomes.size();
+
+        // if this is the sampled child, continue path until reaching horizon
+        // or a node that is already in the tree
+        for( int i = 0, isz = outcomes.size(); i < isz; ++i ) {
+            state_node_t<T, V> *s_node = edges[i].child_;
+            if( i == sampled_child ) {
+                if( (s_node->depth_ >= horizon_) || !s_node->is_leaf() || s_node->is_dead_end_ || s_node->is_goal_ )
+                    nodes_to_propagate.push_back(s_node);
+                else
+                    expand_path(s_node, nodes_to_propagate);
+            }
+            a_node->add_value(edges[i].probability_, *s_node);
+        }
+        a_node->discount_value(a_node->action_cost_, problem_.discount());
+        nodes_to_propagate.push_back(a_node);
+    }
+    void expand_path(state_node_t<T, V> *s_node,
+                     std::vector<node_t<T, V>*> &nodes_to_propagate) const {
+        assert(s_node->is_leaf());
+        assert(!s_node->is_goal_);
+        assert(!s_node->is_dead_end_);
+
+        // calculate selected action by base policy
+        Problem::action_t selected_action = Problem::noop;
+        {
+            Utils::sampled_timer_t timer(policy_t<T>::base_policy_time_, policy_t<T>::base_policy_calls_++);
+            selected_action = (*base_policy_)(s_node->state_);
+        }
+        assert(problem_.applicable(s_node->state_, selected_action));
+
+        // expand by generating all applicable actions
+        int num_actions = problem_.number_actions(s_node->state_);
+        s_node->children_ = action_nodes_.allocate(num_actions);
+        for( Problem::action_t a = 0; a < num_actions; ++a ) {
+            if( problem_.applicable(s_node->state_, a) ) {
+                // create node for this action
+                ++num_nodes_;
+                action_node_t<T, V> *a_node = &s_node->children_[s_node->num_children_++];
+                a_node->initialize(a);
+                a_node->action_cost_ = problem_.cost(s_node->state_, a);
+                a_node->parent_ = s_node;
+
+                // if this is selected action, generate path recursively
+                if( a == selected_action )
+                    expand_path(a_node, nodes_to_propagate);
+                else
+                    expand(a_node, nodes_to_propagate, false);
+            }
+        }
+    }
+
+    // propagate new values bottom-up. Nodes whose value may have changed
+    // are put in buckets indexed by depth that are processed deepest first
+    // by flush_propagation(), so each node is updated at most once per flush
+    // no matter how many expansions were made since the previous one
+    void propagate(node_t<T, V> *node) const {
+        if( node->is_state_node() )
+            propagate(static_cast<state_node_t<T, V>*>(node));
+        else
+            propagate(static_cast<action_node_t<T, V>*>(node));
     }
-    void propagate(action_node_t<T> *a_node) const {
+    void propagate(action_node_t<T, V> *a_node) const {
         assert(a_node->parent_ != 0);
         propagate(a_node->parent_);
     }
-    void propagate(state_node_t<T> *s_node) const {
-        std::deque<state_node_t<T>*> queue;
-        queue.push_back(s_node);
-        s_node->in_queue_ = true;
-        while( !queue.empty() ) {
-            state_node_t<T> *s_node = queue.front();
-            queue.pop_front();
-            s_node->in_queue_ = false;
-            float old_value = s_node->value_;
-            if( !s_node->is_leaf() ) s_node->update_value();
-            if( s_node->is_leaf() || (old_value != s_node->value_) ) {
-                for( int i = 0, isz = s_node->parents_.size(); i < isz; ++i ) {
-                    action_node_t<T> *a_node = s_node->parents_[i].second;
-                    float old_value = a_node->value_;
-                    a_node->update_value(problem_.discount());
-                    assert(a_node->parent_ != 0);
-                    if( !a_node->parent_->in_queue_ && (old_value != a_node->value_) ) {
-                        queue.push_back(a_node->parent_);
-                        a_node->parent_->in_queue_ = true;
-                    }
+    void propagate(state_node_t<T, V> *s_node) const {
+        if( !s_node->in_queue_ ) {
+            int depth = s_node->depth_;
+            if( depth >= int(state_buckets_.size()) ) {
+                state_buckets_.resize(1 + depth);
+                action_buckets_.resize(1 + depth);
+            }
+            state_buckets_[depth].push_back(s_node);
+            s_node->in_queue_ = true;
+            dirty_depth_ = Utils::max(dirty_depth_, depth);
+        }
+    }
+    void mark_for_update(action_node_t<T, V> *a_node) const {
+        if( !a_node->in_queue_ ) {
+            assert(a_node->parent_ != 0);
+            action_buckets_[a_node->parent_->depth_].push_back(a_node);
+            a_node->in_queue_ = true;
+        }
+    }
+    void flush_propagation() const {
+        for( int depth = dirty_depth_; depth >= 0; --depth ) {
+            std::vector<action_node_t<T, V>*> &a_bucket = action_buckets_[depth];
+            for( int i = 0, isz = a_bucket.size(); i < isz; ++i ) {
+                action_node_t<T, V> *a_node = a_bucket[i];
+                a_node->in_queue_ = false;
+                float old_value = a_node->value(w_);
+                a_node->update_value(problem_.discount());
+                if( old_value != a_node->value(w_) ) propagate(a_node->parent_);
+            }
+            a_bucket.clear();
+
+            std::vector<state_node_t<T, V>*> &s_bucket = state_buckets_[depth];
+            for( int i = 0, isz = s_bucket.size(); i < isz; ++i ) {
+                state_node_t<T, V> *s_node = s_bucket[i];
+                s_node->in_queue_ = false;
+                float old_value = s_node->value(w_);
+                if( !s_node->is_leaf() ) s_node->update_value(w_);
+                if( s_node->is_leaf() || (old_value != s_node->value(w_)) ) {
+                    for( edge_t<T, V> *edge = s_node->parents_; edge != 0; edge = edge->next_parent_ )
+                        mark_for_update(edge->parent_);
                 }
             }
+            s_bucket.clear();
         }
+        dirty_depth_ = -1;
     }
 
     // evaluate a state with base policy, and evaluate an action node by
@@ -733,16 +1280,17 @@ template<typename T> class aot_t : public improvement_t<T> {
     float evaluate(const T &s, unsigned depth) const {
         total_evaluations_ += leaf_nsamples_;
         if( (heuristic_ != 0) && (depth < horizon_) ) {
+            COUNT(HeuristicCalls);
             float value = heuristic_->value(s);
             policy_t<T>::heuristic_time_ = heuristic_->eval_time();
             return value;
         } else if( depth >= horizon_ ) {
             return 0;
         } else {
-            float start_time = Utils::read_time_in_seconds();
-            float value = Evaluation::evaluation(*base_policy_, s, leaf_nsamples_, horizon_ - depth);
-            policy_t<T>::base_policy_time_ += Utils::read_time_in_seconds() - start_time;
-            return value;
+            Utils::sampled_timer_t timer(policy_t<T>::base_policy_time_, policy_t<T>::base_policy_calls_++);
+            Trace::scope_t scope("rollout");
+            COUNT(Rollouts);
+            return Evaluation::evaluation(*base_policy_, s, leaf_nsamples_, horizon_ - depth);
         }
     }
     float evaluate(const T &state, Problem::action_t action, unsigned depth) const {
@@ -755,55 +1303,182 @@ template<typename T> class aot_t : public improvement_t<T> {
         return value / delayed_evaluation_nsamples_;
     }
 
-    // abstraction of selection strategy
-    void clear_leaf_selection_strategy() {
-        setup_expansion_loop_ptr_ = 0;
-        prepare_next_expansion_iteration_ptr_ = 0;
-        exist_nodes_to_expand_ptr_ = 0;
-        select_node_for_expansion_ptr_ = 0;
-        clear_internal_state_ptr_ = 0;
+    // evaluation of tips. Requests are served right away unless threads > 1
+    // and the request needs rollouts, in which case it is deferred until
+    // evaluate_deferred() is called. Each deferred request has its own seed
+    // so that results don't depend on the number of threads.
+    void request_evaluation(typename evaluation_t::kind_t kind, node_t<T, V> *node) const {
+        evaluation_t evaluation(kind, node);
+        unsigned depth = evaluation_depth(evaluation);
+        if( (num_threads_ <= 1) || (heuristic_ != 0) || (depth >= horizon_) ) {
+            if( node->is_state_node() ) {
+                const state_node_t<T, V> *s_node = static_cast<const state_node_t<T, V>*>(node);
+                evaluation.value_ = evaluate(s_node->state_, depth);
+            } else {
+                const action_node_t<T, V> *a_node = static_cast<const action_node_t<T, V>*>(node);
+                evaluation.value_ = evaluate(a_node->parent_->state_, a_node->action_, depth);
+            }
+            apply_evaluation(evaluation);
+        } else {
+            unsigned nsamples = node->is_state_node() ? 1 : delayed_evaluation_nsamples_;
+            total_evaluations_ += nsamples * leaf_nsamples_;
+            evaluation.seed_ = Random::seed48();
+            evaluations_.push_back(evaluation);
+        }
     }
-    void set_leaf_selection_strategy(int strategy) {
-        if( strategy == 1 ) {
-            random_setup_selection_strategy();
+    unsigned evaluation_depth(const evaluation_t &evaluation) const {
+        if( evaluation.node_->is_state_node() )
+            return static_cast<const state_node_t<T, V>*>(evaluation.node_)->depth_;
+        else
+            return 1 + static_cast<const action_node_t<T, V>*>(evaluation.node_)->parent_->depth_;
+    }
+    void apply_evaluation(const evaluation_t &evaluation) const {
+        if( evaluation.node_->is_state_node() ) {
+            state_node_t<T, V> *s_node = static_cast<state_node_t<T, V>*>(evaluation.node_);
+            if( evaluation.kind_ == evaluation_t::Leaf ) {
+                s_node->set_value(0, evaluation.value_);
+                s_node->nsamples_ = leaf_nsamples_;
+            } else if( s_node->is_leaf() ) {
+                unsigned nsamples = s_node->nsamples_;
+                s_node->nsamples_ += leaf_nsamples_;
+                s_node->add_estimate(evaluation.value_, nsamples, s_node->nsamples_);
+            }
         } else {
-            delta_setup_selection_strategy();
+            action_node_t<T, V> *a_node = static_cast<action_node_t<T, V>*>(evaluation.node_);
+            if( !a_node->is_leaf() ) return; // expanded after the request
+            if( evaluation.kind_ == evaluation_t::Action ) {
+                a_node->set_value(a_node->action_cost_, problem_.discount() * evaluation.value_);
+                a_node->nsamples_ = delayed_evaluation_nsamples_ * leaf_nsamples_;
+            } else {
+                unsigned nsamples = a_node->nsamples_;
+                a_node->nsamples_ += delayed_evaluation_nsamples_ * leaf_nsamples_;
+                a_node->add_estimate(a_node->action_cost_, problem_.discount(), evaluation.value_, nsamples, a_node->nsamples_);
+
+#ifdef DEBUG
+                std::cout << "sibling re-sampled: "
+                          << "num=" << a_node->nsamples_
+                          << std::endl;
+#endif
+            }
+        }
+    }
+
+    // rollouts for a deferred request with the given copy of base policy;
+    // the tree isn't modified while worker threads call this method
+    float evaluate(const policy_t<T> &policy, const evaluation_t &evaluation) const {
+        Trace::scope_t scope("rollout");
+        unsigned depth = evaluation_depth(evaluation);
+        if( evaluation.node_->is_state_node() ) {
+            const state_node_t<T, V> *s_node = static_cast<const state_node_t<T, V>*>(evaluation.node_);
+            COUNT(Rollouts);
+            return Evaluation::evaluation(policy, s_node->state_, leaf_nsamples_, horizon_ - depth);
+        } else {
+            const action_node_t<T, V> *a_node = static_cast<const action_node_t<T, V>*>(evaluation.node_);
+            float value = 0;
+            for( unsigned i = 0; i < delayed_evaluation_nsamples_; ++i ) {
+                std::pair<T, bool> sample = problem_.sample(a_node->parent_->state_, a_node->action_);
+                COUNT(Rollouts);
+                value += Evaluation::evaluation(policy, sample.first, leaf_nsamples_, horizon_ - depth);
+            }
+            return value / delayed_evaluation_nsamples_;
         }
     }
+    void evaluate_deferred() const {
+        assert(base_policy_ != 0);
+        setup_workers();
+        {
+            Utils::scoped_timer_t timer(policy_t<T>::base_policy_time_);
+            pool_->run(evaluations_.size(), [&](unsigned job, unsigned worker) {
+                evaluation_t &evaluation = evaluations_[job];
+                Random::scoped_stream_t stream(evaluation.seed_);
+                evaluation.value_ = evaluate(*worker_policies_[worker], evaluation);
+            });
+        }
+
+        // apply in request order, as a sequential expansion would do
+        for( int i = 0, isz = evaluations_.size(); i < isz; ++i )
+            apply_evaluation(evaluations_[i]);
+        evaluations_.clear();
+    }
+
+    // each worker thread evaluates tips with its own copy of base policy
+    void setup_workers() const {
+        if( pool_ == 0 ) {
+            pool_ = new Parallel::thread_pool_t(Utils::max(1u, num_threads_));
+            worker_policies_.push_back(base_policy_);
+            for( unsigned worker = 1; worker < pool_->num_threads(); ++worker )
+                worker_policies_.push_back(base_policy_->clone());
+        }
+    }
+    void clear_workers() const {
+        for( unsigned worker = 1; worker < worker_policies_.size(); ++worker )
+            delete worker_policies_[worker];
+        worker_policies_.clear();
+        delete pool_;
+        pool_ = 0;
+    }
+
+    // selection strategy, bound at compile time by the tag S
+    void setup_expansion_loop(state_node_t<T, V> *root, delta_selection_t) const {
+        delta_setup_expansion_loop(root);
+    }
+    void setup_expansion_loop(state_node_t<T, V> *root, random_selection_t) const {
+        random_setup_expansion_loop(root);
+    }
+    void prepare_next_expansion_iteration(state_node_t<T, V> *root, delta_selection_t) const {
+        delta_prepare_next_expansion_iteration(root);
+    }
+    void prepare_next_expansion_iteration(state_node_t<T, V> *root, random_selection_t) const {
+        random_prepare_next_expansion_iteration(root);
+    }
+    bool exist_nodes_to_expand(delta_selection_t) const {
+        return delta_exist_nodes_to_expand();
+    }
+    bool exist_nodes_to_expand(random_selection_t) const {
+        return random_exist_nodes_to_expand();
+    }
+    node_t<T, V>* select_node_for_expansion(state_node_t<T, V> *root, delta_selection_t) const {
+        return delta_select_node_for_expansion(root);
+    }
+    node_t<T, V>* select_node_for_expansion(state_node_t<T, V> *root, random_selection_t) const {
+        return random_select_node_for_expansion(root);
+    }
+    void clear_internal_state(delta_selection_t) const {
+        delta_clear_internal_state();
+    }
+    void clear_internal_state(random_selection_t) const {
+        random_clear_internal_state();
+    }
 
     // selection strategy based on delta values
-    void delta_setup_selection_strategy() {
-        setup_expansion_loop_ptr_ = &aot_t::delta_setup_expansion_loop;
-        prepare_next_expansion_iteration_ptr_ = &aot_t::delta_prepare_next_expansion_iteration;
-        exist_nodes_to_expand_ptr_ = &aot_t::delta_exist_nodes_to_expand;
-        select_node_for_expansion_ptr_ = &aot_t::delta_select_node_for_expansion;
-        clear_internal_state_ptr_ = &aot_t::delta_clear_internal_state;
-    }
-    void delta_setup_expansion_loop(state_node_t<T> *root) const {
+    void delta_setup_expansion_loop(state_node_t<T, V> *root) const {
         assert(empty_priority_queues());
-        insert_into_priority_queue(root);
+        if( root->is_leaf() )
+            insert_into_priority_queue(root);
+        else
+            recompute_delta(root);
     }
-    void delta_prepare_next_expansion_iteration(state_node_t<T> *root) const {
+    void delta_prepare_next_expansion_iteration(state_node_t<T, V> *root) const {
         clear_priority_queues();
         recompute_delta(root);
     }
     bool delta_exist_nodes_to_expand() const {
         return !empty_priority_queues();
     }
-    node_t<T> *delta_select_node_for_expansion(state_node_t<T>*) const {
+    node_t<T, V> *delta_select_node_for_expansion(state_node_t<T, V>*) const {
         return select_from_priority_queue();
     }
     void delta_clear_internal_state() const {
         clear_priority_queues();
     }
 
-    void recompute_delta(state_node_t<T> *root) const {
+    void recompute_delta(state_node_t<T, V> *root) const {
         assert(!root->is_goal_);
         assert(!root->is_dead_end_);
 
-        std::deque<state_node_t<T>*> s_queue;
+        std::deque<state_node_t<T, V>*> s_queue;
         bool expanding_from_s_queue = true;
-        std::deque<action_node_t<T>*> a_queue;
+        std::deque<action_node_t<T, V>*> a_queue;
         bool expanding_from_a_queue = false;
 
         root->delta_ = std::numeric_limits<float>::max();
@@ -814,7 +1489,7 @@ template<typename T> class aot_t : public improvement_t<T> {
             // expand from the state queue
             if( expanding_from_s_queue ) {
                 while( !s_queue.empty() ) {
-                    state_node_t<T> *s_node = s_queue.back();
+                    state_node_t<T, V> *s_node = s_queue.back();
                     s_queue.pop_back();
                     s_node->in_queue_ = false;
                     recompute_delta(s_node, a_queue);
@@ -826,7 +1501,7 @@ template<typename T> class aot_t : public improvement_t<T> {
             // expand from the action queue
             if( expanding_from_a_queue ) {
                 while( !a_queue.empty() ) {
-                    action_node_t<T> *a_node = a_queue.back();
+                    action_node_t<T, V> *a_node = a_queue.back();
                     a_queue.pop_back();
                     recompute_delta(a_node, s_queue);
                 }
@@ -835,8 +1510,8 @@ template<typename T> class aot_t : public improvement_t<T> {
             }
         }
     }
-    void recompute_delta(state_node_t<T> *s_node,
-                         std::deque<action_node_t<T>*> &a_queue) const {
+    void recompute_delta(state_node_t<T, V> *s_node,
+                         std::deque<action_node_t<T, V>*> &a_queue) const {
         assert(!s_node->is_goal_);
         assert(!s_node->is_dead_end_);
         if( s_node->is_leaf() ) {
@@ -845,30 +1520,30 @@ template<typename T> class aot_t : public improvement_t<T> {
                 insert_into_priority_queue(s_node);
             }
         } else {
-            assert(!s_node->children_.empty());
-            float best_value = s_node->value_;
+            assert(s_node->num_children_ > 0);
+            float best_value = s_node->value(w_);
             if( s_node->in_best_policy_ ) {
                 assert(s_node->delta_ >= 0);
 
                 // compute Delta
                 float Delta = std::numeric_limits<float>::max();
-                for( int i = 0, isz = s_node->children_.size(); i < isz; ++i ) {
-                    action_node_t<T> *a_node = s_node->children_[i];
-                    if( a_node->value_ != best_value ) {
-                        float d = a_node->value_ - best_value;
+                for( unsigned i = 0; i < s_node->num_children_; ++i ) {
+                    action_node_t<T, V> *a_node = &s_node->children_[i];
+                    if( a_node->value(w_) != best_value ) {
+                        float d = a_node->value(w_) - best_value;
                         Delta = Utils::min(Delta, d);
                     }
                 }
 
                 // compute delta
-                for( int i = 0, isz = s_node->children_.size(); i < isz; ++i ) {
-                    action_node_t<T> *a_node = s_node->children_[i];
-                    if( a_node->value_ == best_value ) {
+                for( unsigned i = 0; i < s_node->num_children_; ++i ) {
+                    action_node_t<T, V> *a_node = &s_node->children_[i];
+                    if( a_node->value(w_) == best_value ) {
                         a_node->delta_ = Utils::min(s_node->delta_, Delta);
                         a_node->in_best_policy_ = true;
                         assert(a_node->delta_ >= 0);
                     } else {
-                        a_node->delta_ = best_value - a_node->value_;
+                        a_node->delta_ = best_value - a_node->value(w_);
                         a_node->in_best_policy_ = false;
                         assert(a_node->delta_ <= 0);
                     }
@@ -876,9 +1551,9 @@ template<typename T> class aot_t : public improvement_t<T> {
                 }
             } else {
                 assert(s_node->delta_ <= 0);
-                for( int i = 0, isz = s_node->children_.size(); i < isz; ++i ) {
-                    action_node_t<T> *a_node = s_node->children_[i];
-                    a_node->delta_ = s_node->delta_ + best_value - a_node->value_;
+                for( unsigned i = 0; i < s_node->num_children_; ++i ) {
+                    action_node_t<T, V> *a_node = &s_node->children_[i];
+                    a_node->delta_ = s_node->delta_ + best_value - a_node->value(w_);
                     a_node->in_best_policy_ = false;
                     assert(a_node->delta_ <= 0);
                     a_queue.push_back(a_node);
@@ -886,25 +1561,23 @@ template<typename T> class aot_t : public improvement_t<T> {
             }
         }
     }
-    void recompute_delta(action_node_t<T> *a_node,
-                         std::deque<state_node_t<T>*> &s_queue) const {
+    void recompute_delta(action_node_t<T, V> *a_node,
+                         std::deque<state_node_t<T, V>*> &s_queue) const {
         if( a_node->is_leaf() ) {
             // insert tip node into priority queue
             if( a_node->parent_->depth_ < horizon_ ) {
                 insert_into_priority_queue(a_node);
             }
         } else {
-            for( int i = 0, isz = a_node->children_.size(); i < isz; ++i ) {
-                state_node_t<T> *s_node = a_node->children_[i].second;
+            for( unsigned i = 0; i < a_node->num_children_; ++i ) {
+                state_node_t<T, V> *s_node = a_node->children_[i].child_;
                 if( !s_node->in_queue_ && !s_node->is_goal_ && !s_node->is_dead_end_ ) {
                     float delta = std::numeric_limits<float>::max();
                     bool in_best_policy = false;
-                    for( int j = 0, jsz = s_node->parents_.size(); j < jsz; ++j ) {
-                        int child_index = s_node->parents_[j].first;
-                        action_node_t<T> *parent = s_node->parents_[j].second;
-                        assert(parent->children_[child_index].second == s_node);
-                        float d = parent->delta_ /
-                                  (problem_.discount() * parent->children_[child_index].first);
+                    for( const edge_t<T, V> *edge = s_node->parents_; edge != 0; edge = edge->next_parent_ ) {
+                        const action_node_t<T, V> *parent = edge->parent_;
+                        assert(edge->child_ == s_node);
+                        float d = parent->delta_ / (problem_.discount() * edge->probability_);
                         delta = Utils::min(delta, fabsf(d));
                         in_best_policy = in_best_policy || parent->in_best_policy_;
                     }
@@ -917,7 +1590,14 @@ template<typename T> class aot_t : public improvement_t<T> {
         }
     }
 
-    // implementation of priority queue for storing the deltas
+    // implementation of priority queue for storing the deltas. The queues
+    // hold at most expansions-per-iteration tips each
+    void set_queue_capacity() {
+#ifdef USE_BDD_PQ
+        inside_bdd_priority_queue_.set_capacity(expansions_per_iteration_);
+        outside_bdd_priority_queue_.set_capacity(expansions_per_iteration_);
+#endif
+    }
     unsigned size_priority_queues() const {
 #ifdef USE_BDD_PQ
         return inside_bdd_priority_queue_.size() + outside_bdd_priority_queue_.size();
@@ -942,23 +1622,24 @@ template<typename T> class aot_t : public improvement_t<T> {
     bool empty_priority_queues() const {
         return empty_inside_priority_queue() && empty_outside_priority_queue();
     }
-    void clear(priority_queue_t<T> &pq) const {
+    void clear(priority_queue_t<T, V> &pq) const {
         while( !pq.empty() ) {
-            node_t<T> *node = pq.top();
+            node_t<T, V> *node = pq.top();
             pq.pop();
             assert(node->in_pq_);
             node->in_pq_ = false;
         }
     }
-    void clear(bdd_priority_queue_t<T> &pq) const {
+    void clear(bdd_priority_queue_t<T, V, Q> &pq) const {
         while( !pq.empty() ) {
-            node_t<T> *node = pq.top();
+            node_t<T, V> *node = pq.top();
             pq.pop();
             assert(node->in_pq_);
             node->in_pq_ = false;
         }
     }
     void clear_priority_queues() const {
+        if( queue_trace_ != 0 ) *queue_trace_ << "clear\n";
 #ifdef USE_BDD_PQ
         clear(inside_bdd_priority_queue_);
         clear(outside_bdd_priority_queue_);
@@ -967,12 +1648,12 @@ template<typename T> class aot_t : public improvement_t<T> {
         clear(outside_priority_queue_);
 #endif
     }
-    void insert_into_inside_priority_queue(node_t<T> *node) const {
+    void insert_into_inside_priority_queue(node_t<T, V> *node) const {
 #ifdef USE_BDD_PQ
         std::pair<bool, bool> p = inside_bdd_priority_queue_.push(node);
         node->in_pq_ = p.first;
         if( p.second ) {
-            node_t<T> *removed = inside_bdd_priority_queue_.removed_element();
+            node_t<T, V> *removed = inside_bdd_priority_queue_.removed_element();
             assert(removed != 0);
             assert(removed->in_pq_);
             removed->in_pq_ = false;
@@ -982,12 +1663,12 @@ template<typename T> class aot_t : public improvement_t<T> {
         node->in_pq_ = true;
 #endif
     }
-    void insert_into_outside_priority_queue(node_t<T> *node) const {
+    void insert_into_outside_priority_queue(node_t<T, V> *node) const {
 #ifdef USE_BDD_PQ
         std::pair<bool, bool> p = outside_bdd_priority_queue_.push(node);
         node->in_pq_ = p.first;
         if( p.second ) {
-            node_t<T> *removed = outside_bdd_priority_queue_.removed_element();
+            node_t<T, V> *removed = outside_bdd_priority_queue_.removed_element();
             assert(removed != 0);
             assert(removed->in_pq_);
             removed->in_pq_ = false;
@@ -997,8 +1678,9 @@ template<typename T> class aot_t : public improvement_t<T> {
         node->in_pq_ = true;
 #endif
     }
-    void insert_into_priority_queue(node_t<T> *node) const {
+    void insert_into_priority_queue(node_t<T, V> *node) const {
         if( !node->in_pq_ ) {
+            if( queue_trace_ != 0 ) *queue_trace_ << "push " << node->delta_ << "\n";
             float sign = copysignf(1, node->delta_);
             if( sign == 1 ) {
 #ifdef DEBUG
@@ -1017,8 +1699,8 @@ template<typename T> class aot_t : public improvement_t<T> {
             }
         }
     }
-    node_t<T>* select_from_inside() const {
-        node_t<T> *node = 0;
+    node_t<T, V>* select_from_inside() const {
+        node_t<T, V> *node = 0;
 #ifdef USE_BDD_PQ
         node = inside_bdd_priority_queue_.top();
         inside_bdd_priority_queue_.pop();
@@ -1029,10 +1711,11 @@ template<typename T> class aot_t : public improvement_t<T> {
         assert(node->in_pq_);
         node->in_pq_ = false;
         ++from_inside_;
+        if( queue_trace_ != 0 ) *queue_trace_ << "pop in\n";
         return node;
     }
-    node_t<T>* select_from_outside() const {
-       node_t<T> *node = 0;
+    node_t<T, V>* select_from_outside() const {
+       node_t<T, V> *node = 0;
 #ifdef USE_BDD_PQ
         node = outside_bdd_priority_queue_.top();
         outside_bdd_priority_queue_.pop();
@@ -1043,10 +1726,11 @@ template<typename T> class aot_t : public improvement_t<T> {
         assert(node->in_pq_);
         node->in_pq_ = false;
         ++from_outside_;
+        if( queue_trace_ != 0 ) *queue_trace_ << "pop out\n";
         return node;
     }
-    node_t<T>* select_from_priority_queue() const {
-        node_t<T> *node = 0;
+    node_t<T, V>* select_from_priority_queue() const {
+        node_t<T, V> *node = 0;
         if( empty_inside_priority_queue() && empty_outside_priority_queue() ) {
             node = 0;
         } else if( empty_inside_priority_queue() ) {
@@ -1070,29 +1754,25 @@ template<typename T> class aot_t : public improvement_t<T> {
     }
 
     // selection strategy based on random selection
-    void random_setup_selection_strategy() {
-        setup_expansion_loop_ptr_ = &aot_t::random_setup_expansion_loop;
-        prepare_next_expansion_iteration_ptr_ = &aot_t::random_prepare_next_expansion_iteration;
-        exist_nodes_to_expand_ptr_ = &aot_t::random_exist_nodes_to_expand;
-        select_node_for_expansion_ptr_ = &aot_t::random_select_node_for_expansion;
-        clear_internal_state_ptr_ = &aot_t::random_clear_internal_state;
+    void random_setup_expansion_loop(state_node_t<T, V> *root) const {
+        if( root->is_leaf() )
+            random_leaf_ = root;
+        else
+            random_prepare_next_expansion_iteration(root);
     }
-    void random_setup_expansion_loop(state_node_t<T> *root) const {
-        random_leaf_ = root;
-    }
-    void random_prepare_next_expansion_iteration(state_node_t<T> *node) const {
+    void random_prepare_next_expansion_iteration(state_node_t<T, V> *node) const {
         if( node->is_leaf() ) {
             if( !node->is_goal_ && !node->is_dead_end_ && (node->depth_ < horizon_) ) {
                 if( (random_leaf_ == 0) || (Random::real() < 0.5) )
                     random_leaf_ = node;
             }
         } else {
-            assert(!node->children_.empty());
-            for( int i = 0, isz = node->children_.size(); i < isz; ++i ) {
-                action_node_t<T> *a_node = node->children_[i];
-                assert(!a_node->children_.empty());
-                for( int j = 0, jsz = a_node->children_.size(); j < jsz; ++j ) {
-                    state_node_t<T> *s_node = a_node->children_[j].second;
+            assert(node->num_children_ > 0);
+            for( unsigned i = 0; i < node->num_children_; ++i ) {
+                action_node_t<T, V> *a_node = &node->children_[i];
+                assert(a_node->num_children_ > 0);
+                for( unsigned j = 0; j < a_node->num_children_; ++j ) {
+                    state_node_t<T, V> *s_node = a_node->children_[j].child_;
                     random_prepare_next_expansion_iteration(s_node);
                 }
             }
@@ -1101,8 +1781,8 @@ template<typename T> class aot_t : public improvement_t<T> {
     bool random_exist_nodes_to_expand() const {
         return random_leaf_ != 0;
     }
-    node_t<T> *random_select_node_for_expansion(state_node_t<T> *node) const {
-        node_t<T> *leaf = random_leaf_;
+    node_t<T, V> *random_select_node_for_expansion(state_node_t<T, V> *node) const {
+        node_t<T, V> *leaf = random_leaf_;
         random_leaf_ = 0;
         return leaf;
     }
@@ -1111,6 +1791,47 @@ template<typename T> class aot_t : public improvement_t<T> {
     }
 };
 
+// Create the instance of aot_t for the strategies V and E and the
+// leaf-selection and queue parameters of the request.
+template<typename T, typename V, typename E>
+inline policy_t<T>* make_aot_instance(const Problem::problem_t<T> &problem, bool random, bool sorted) {
+    if( random )
+        return new aot_t<T, random_selection_t, V, E>(problem);
+    else if( sorted )
+        return new aot_t<T, delta_selection_t, V, E, sorted_queue_t>(problem);
+    else
+        return new aot_t<T, delta_selection_t, V, E>(problem);
+}
+
+// Create the instance of aot_t for a policy name (aot, aot-gh or aot-path),
+// the leaf-selection parameter of the request (delta or random), and the
+// queue parameter (heap or sorted), which only matters for delta.
+template<typename T>
+inline policy_t<T>* make_aot(const Problem::problem_t<T> &problem,
+                             const std::string &name,
+                             const std::multimap<std::string, std::string> &parameters) {
+    std::multimap<std::string, std::string>::const_iterator it = parameters.find("leaf-selection");
+    bool random = (it != parameters.end()) && (it->second == "random");
+    if( (it != parameters.end()) && !random && (it->second != "delta") ) {
+        std::cout << Utils::error() << "unknown leaf-selection '" << it->second << "' for " << name << "() policy!" << std::endl;
+        exit(1);
+    }
+    it = parameters.find("queue");
+    bool sorted = (it != parameters.end()) && (it->second == "sorted");
+    if( (it != parameters.end()) && !sorted && (it->second != "heap") ) {
+        std::cout << Utils::error() << "unknown queue '" << it->second << "' for " << name << "() policy!" << std::endl;
+        exit(1);
+    }
+
+    if( name == "aot" )
+        return make_aot_instance<T, plain_value_t, node_expansion_t>(problem, random, sorted);
+    else if( name == "aot-gh" )
+        return make_aot_instance<T, gh_value_t, node_expansion_t>(problem, random, sorted);
+    else if( name == "aot-path" )
+        return make_aot_instance<T, plain_value_t, path_expansion_t>(problem, random, sorted);
+    return 0;
+}
+
 }; // namespace AOT
 
 }; // namespace Policy
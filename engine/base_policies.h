@@ -20,6 +20,7 @@
 #define BASE_POLICIES_H
 
 #include "policy.h"
+#include "value_file.h"
 
 #include <cassert>
 #include <iostream>
@@ -74,6 +75,7 @@ template<typename T> class random_t : public policy_t<T> {
 
 // Hash-based based policy: select best action using best_q_value method of hash table
 template<typename T> class hash_policy_t : public policy_t<T> {
+  protected:
   using policy_t<T>::problem_;
   protected:
     Problem::hash_t<T> *hash_;
@@ -145,6 +147,8 @@ template<typename T> class optimal_policy_t : public hash_policy_t<T> {
             algorithm_ = dispatcher.fetch_algorithm(it->second);
         }
         solve_problem();
+        it = parameters.find("save");
+        if( (it != parameters.end()) && !ValueFile::save(*hash_, it->second) ) exit(1);
 #ifdef DEBUG
         std::cout << "debug: optimal(): params:"
                   << " algorithm=" << (algorithm_ == 0 ? std::string("null") : algorithm_->name())
@@ -163,12 +167,95 @@ template<typename T> class optimal_policy_t : public hash_policy_t<T> {
 #ifdef DEBUG
         std::cout << "debug: optimal(): solving problem with algorithm=" << algorithm_->name() << std::endl;
 #endif
+        Trace::scope_t scope("policy-setup");
         float start_time = Utils::read_time_in_seconds();
         algorithm_->solve(problem_.init(), *hash_);
         policy_t<T>::setup_time_ = Utils::read_time_in_seconds() - start_time;
     }
 };
 
+// Policy given by a value file (e.g. one written with save=<file> by
+// optimal()): select the stored action of the state, or the best action
+// wrt 1-step-lookahead of the stored values for states not in the file
+template<typename T> class file_policy_t : public policy_t<T> {
+  using policy_t<T>::problem_;
+  protected:
+    std::string path_;
+    ValueFile::table_t<T> table_;
+
+    void open() {
+        float start_time = Utils::read_time_in_seconds();
+        if( !table_.open(path_) ) exit(1);
+        policy_t<T>::setup_time_ = Utils::read_time_in_seconds() - start_time;
+    }
+
+  public:
+    file_policy_t(const Problem::problem_t<T> &problem, const std::string &path = "")
+      : policy_t<T>(problem), path_(path), table_(problem) {
+        if( !path_.empty() ) open();
+    }
+    virtual ~file_policy_t() { }
+    virtual policy_t<T>* clone() const { return new file_policy_t(problem_, path_); }
+    virtual std::string name() const { return std::string("file(path=") + path_ + ")"; }
+
+    virtual Problem::action_t operator()(const T &s) const {
+        ++policy_t<T>::decisions_;
+        if( problem_.dead_end(s) ) return Problem::noop;
+        const ValueFile::record_t *record = table_.find(s);
+        if( (record != 0) && (record->action_ != Problem::noop) && problem_.applicable(s, record->action_) )
+            return record->action_;
+
+        std::vector<std::pair<T, float> > outcomes;
+        Problem::action_t best_action = Problem::noop;
+        float best_value = std::numeric_limits<float>::max();
+        for( Problem::action_t a = 0; a < problem_.number_actions(s); ++a ) {
+            if( problem_.applicable(s, a) ) {
+                COUNT(NextPolicy);
+                problem_.next(s, a, outcomes);
+                float value = 0;
+                for( size_t i = 0, isz = outcomes.size(); i < isz; ++i ) {
+                    const ValueFile::record_t *next = table_.find(outcomes[i].first);
+                    value += outcomes[i].second * (next == 0 ? 0 : next->value_);
+                }
+                value = problem_.cost(s, a) + problem_.discount() * value;
+                if( value < best_value ) {
+                    best_value = value;
+                    best_action = a;
+                }
+            }
+        }
+        return best_action;
+    }
+    virtual void reset_stats() const {
+        policy_t<T>::setup_time_ = 0;
+        policy_t<T>::base_policy_time_ = 0;
+        policy_t<T>::heuristic_time_ = 0;
+        problem_.clear_expansions();
+    }
+    virtual void print_other_stats(std::ostream &os, int indent) const {
+        os << std::setw(indent) << ""
+           << "other-stats: name=" << name()
+           << " decisions=" << policy_t<T>::decisions_
+           << " states=" << table_.size()
+           << std::endl;
+    }
+    virtual void set_parameters(const std::multimap<std::string, std::string> &parameters, Dispatcher::dispatcher_t<T> &dispatcher) {
+        std::multimap<std::string, std::string>::const_iterator it = parameters.find("path");
+        if( it != parameters.end() ) path_ = it->second;
+#ifdef DEBUG
+        std::cout << "debug: file(): params: path=" << path_ << std::endl;
+#endif
+        if( path_.empty() ) {
+            std::cout << Utils::error() << "path must be specified for file() policy!" << std::endl;
+            exit(1);
+        }
+        open();
+    }
+    virtual typename policy_t<T>::usage_t uses_base_policy() const { return policy_t<T>::usage_t::No; }
+    virtual typename policy_t<T>::usage_t uses_heuristic() const { return policy_t<T>::usage_t::No; }
+    virtual typename policy_t<T>::usage_t uses_algorithm() const { return policy_t<T>::usage_t::No; }
+};
+
 // Base class for greedy policies wrt 1-step-lookahead of heuristic
 template<typename T> class base_greedy_t : public policy_t<T> {
   using policy_t<T>::problem_;
@@ -213,31 +300,32 @@ template<typename T> class base_greedy_t : public policy_t<T> {
         if( it == cache_.end() ) {
             ++policy_t<T>::decisions_;
             std::vector<std::pair<T, float> > outcomes;
-            std::vector<Problem::action_t> best_actions;
-            int nactions = problem_.number_actions(s);
+            std::vector<Problem::action_t> actions, best_actions;
             float best_value = std::numeric_limits<float>::max();
-            best_actions.reserve(random_ties_ ? nactions : 1);
-            for( Problem::action_t a = 0; a < nactions; ++a ) {
-                if( problem_.applicable(s, a) ) {
-                    float value = optimistic_ ? std::numeric_limits<float>::max() : 0;
-                    problem_.next(s, a, outcomes);
-                    for( size_t i = 0, isz = outcomes.size(); i < isz; ++i ) {
-                        float hval = heuristic_ == 0 ? 0 : heuristic_->value(outcomes[i].first);
-                        if( optimistic_ )
-                            value = hval < value ? hval : value;
-                        else
-                            value += outcomes[i].second * hval;
-                    }
-                    value += problem_.cost(s, a);
-
-                    if( value <= best_value ) {
-                        if( value < best_value ) {
-                            best_value = value;
-                            best_actions.clear();
-                        }
-                        if( random_ties_ || best_actions.empty() )
-                            best_actions.push_back(a);
+            problem_.applicable_actions(s, actions);
+            best_actions.reserve(random_ties_ ? actions.size() : 1);
+            for( size_t k = 0, ksz = actions.size(); k < ksz; ++k ) {
+                Problem::action_t a = actions[k];
+                float value = optimistic_ ? std::numeric_limits<float>::max() : 0;
+                COUNT(NextPolicy);
+                float cost = problem_.lookahead(s, a, outcomes);
+                COUNT_ADD(HeuristicCalls, heuristic_ == 0 ? 0 : outcomes.size());
+                for( size_t i = 0, isz = outcomes.size(); i < isz; ++i ) {
+                    float hval = heuristic_ == 0 ? 0 : heuristic_->value(outcomes[i].first);
+                    if( optimistic_ )
+                        value = hval < value ? hval : value;
+                    else
+                        value += outcomes[i].second * hval;
+                }
+                value += cost;
+
+                if( value <= best_value ) {
+                    if( value < best_value ) {
+                        best_value = value;
+                        best_actions.clear();
                     }
+                    if( random_ties_ || best_actions.empty() )
+                        best_actions.push_back(a);
                 }
             }
             policy_t<T>::heuristic_time_ = heuristic_ == 0 ? 0 : heuristic_->eval_time();
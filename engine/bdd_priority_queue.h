@@ -20,6 +20,7 @@
 #define BDD_PRIORITY_QUEUE_H
 
 #include <iostream>
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <vector>
@@ -42,7 +43,7 @@ template<typename T, typename MAX_CMP_FN, typename MIN_CMP_FN> class bdd_priorit
     };
     typedef bdd_priority_queue<T, MAX_CMP_FN, MIN_CMP_FN> base;
 
-    const unsigned capacity_;
+    unsigned capacity_;
     mutable container_t *pool_;
     mutable T removed_element_;
 
@@ -285,6 +286,12 @@ template<typename T, typename MAX_CMP_FN, typename MIN_CMP_FN> class bdd_priorit
     }
 
     unsigned capacity() const { return capacity_; }
+    void set_capacity(unsigned capacity) {
+        clear();
+        capacity_ = std::max<unsigned>(1, capacity);
+        max_array_ = std::vector<container_t*>(1+capacity_, 0);
+        min_array_ = std::vector<unsigned>(1+capacity_, 0);
+    }
     unsigned size() const { return max_size_; }
     bool empty() const { return max_size_ == 0; }
     T removed_element() const { return removed_element_; }
@@ -354,6 +361,87 @@ template<typename T, typename MAX_CMP_FN, typename MIN_CMP_FN> class bdd_priorit
     }
 };
 
+// Bounded queue with the same interface as bdd_priority_queue. Elements
+// are kept in a single heap with the lowest priority at the front, which
+// is the one removed when a better element is pushed into a full queue.
+// The elements are sorted on the first top() or pop() after a push, and
+// then popped from the back of the array. This suits a queue that is
+// filled and then drained, as the queues of tips in aot.
+template<typename T, typename MAX_CMP_FN, typename MIN_CMP_FN> class bdd_sorted_queue {
+  protected:
+    mutable MAX_CMP_FN max_cmpfn_;
+    mutable MIN_CMP_FN min_cmpfn_;
+
+    unsigned capacity_;
+    mutable std::vector<T> array_;
+    mutable bool sorted_;
+    T removed_element_;
+
+    void sort() const {
+        if( !sorted_ ) {
+            std::sort(array_.begin(), array_.end(), max_cmpfn_);
+            sorted_ = true;
+        }
+    }
+    void make_heap() {
+        if( sorted_ ) {
+            std::make_heap(array_.begin(), array_.end(), min_cmpfn_);
+            sorted_ = false;
+        }
+    }
+
+  public:
+    bdd_sorted_queue(unsigned capacity)
+      : capacity_(std::max<unsigned>(1, capacity)), sorted_(false) {
+        array_.reserve(capacity_);
+    }
+    ~bdd_sorted_queue() { }
+
+    unsigned capacity() const { return capacity_; }
+    void set_capacity(unsigned capacity) {
+        clear();
+        capacity_ = std::max<unsigned>(1, capacity);
+        array_.reserve(capacity_);
+    }
+    unsigned size() const { return array_.size(); }
+    bool empty() const { return array_.empty(); }
+    T removed_element() const { return removed_element_; }
+
+    void clear() {
+        array_.clear();
+        sorted_ = false;
+    }
+
+    const T top() const {
+        assert(!array_.empty());
+        sort();
+        return array_.back();
+    }
+
+    std::pair<bool, bool> push(T &element) {
+        make_heap();
+        if( array_.size() < capacity_ ) {
+            array_.push_back(element);
+            std::push_heap(array_.begin(), array_.end(), min_cmpfn_);
+            return std::make_pair(true, false);
+        } else if( max_cmpfn_(array_.front(), element) ) {
+            std::pop_heap(array_.begin(), array_.end(), min_cmpfn_);
+            removed_element_ = array_.back();
+            array_.back() = element;
+            std::push_heap(array_.begin(), array_.end(), min_cmpfn_);
+            return std::make_pair(true, true);
+        } else {
+            return std::make_pair(false, false);
+        }
+    }
+
+    void pop() {
+        assert(!array_.empty());
+        sort();
+        array_.pop_back();
+    }
+};
+
 }; // end of namespace
 
 #undef DEBUG
@@ -0,0 +1,296 @@
+/*
+ *  Copyright (c) 2011-2016 Universidad Simon Bolivar
+ *
+ *  Permission is hereby granted to distribute this software for
+ *  non-commercial research purposes, provided that this copyright
+ *  notice is included with any such distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ *  EITHER EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE.  THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE
+ *  SOFTWARE IS WITH YOU.  SHOULD THE PROGRAM PROVE DEFECTIVE, YOU
+ *  ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ *
+ *  Blai Bonet, bonet@ldc.usb.ve
+ *
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "problem.h"
+#include "random.h"
+#include "utils.h"
+
+#include <cassert>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+//#define DEBUG
+
+// Checkpoints of long offline solves. Algorithms that support them
+// (lrtdp, hdp and improved-lao) take a snapshot of their state between
+// trials or iterations once the period has elapsed: the hash table
+// (value, action and solved label of each state), the number of trials
+// and updates, and the state of the random generator. The snapshot is
+// serialized by the solving thread and written by a background thread
+// under a temporary name, then synced and renamed, so a preemption leaves
+// either the previous snapshot or the new one. A solve that finds a
+// snapshot of the same algorithm (same name and parameters, including
+// the seed) continues from it as if it had never stopped.
+//
+// Layout: header_t, the name of the algorithm, and num_records_ records
+// made of the state bytes, the value (float), the action (int32_t) and the
+// flags (uint32_t). Snapshots are written in the byte order of the host.
+
+namespace Checkpoint {
+
+const char magic[8] = { 'M', 'D', 'P', 'C', 'K', 'P', 'N', 'T' };
+const uint32_t version = 1;
+const uint32_t byte_order = 0x01020304;
+
+struct header_t {
+    enum { Solved = 1 };
+    char magic_[8];
+    uint32_t version_;
+    uint32_t byte_order_;
+    uint32_t state_size_;
+    uint32_t record_size_;
+    uint64_t num_records_;
+    uint64_t trials_;
+    uint64_t updates_;
+    uint16_t random_state_[3];
+    uint16_t reserved_;
+    uint32_t name_size_;
+    uint64_t checksum_;    // FNV-1a of the name and records
+};
+
+inline uint32_t record_size(size_t state_size) {
+    return state_size + sizeof(float) + sizeof(int32_t) + sizeof(uint32_t);
+}
+
+inline uint64_t checksum(const char *bytes, size_t size, uint64_t h = 14695981039346656037ULL) {
+    for( size_t i = 0; i < size; ++i ) {
+        h ^= (unsigned char)bytes[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+template<typename T> class checkpointer_t {
+  protected:
+    const Problem::problem_t<T> &problem_;
+    std::string filename_;
+    float period_;
+    double last_time_;
+    unsigned snapshots_;
+
+    // background writer
+    std::thread writer_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<char> pending_;
+    bool busy_;
+    bool done_;
+
+    void writer_loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while( true ) {
+            cv_.wait(lock, [this] { return busy_ || done_; });
+            if( !busy_ ) break;
+            std::vector<char> snapshot;
+            snapshot.swap(pending_);
+            lock.unlock();
+            bool ok = write(snapshot);
+            lock.lock();
+            if( ok ) ++snapshots_;
+            busy_ = false;
+            cv_.notify_all();
+        }
+    }
+
+    bool write(const std::vector<char> &snapshot) const {
+        std::string tmp_filename = filename_ + ".tmp";
+        int fd = ::open(tmp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool ok = fd != -1;
+        for( size_t offset = 0; ok && (offset < snapshot.size()); ) {
+            ssize_t n = ::write(fd, &snapshot[offset], snapshot.size() - offset);
+            ok = n > 0;
+            offset += ok ? n : 0;
+        }
+        ok = ok && (fsync(fd) == 0);
+        if( fd != -1 ) ::close(fd);
+        ok = ok && (rename(tmp_filename.c_str(), filename_.c_str()) == 0);
+        if( !ok ) {
+            std::cout << Utils::warning() << "checkpoint: cannot write '" << filename_ << "'" << std::endl;
+            unlink(tmp_filename.c_str());
+        }
+        return ok;
+    }
+
+  public:
+    checkpointer_t(const Problem::problem_t<T> &problem, const std::string &filename, float period)
+      : problem_(problem), filename_(filename), period_(period),
+        last_time_(Utils::read_monotonic_time()), snapshots_(0),
+        busy_(false), done_(false) {
+        writer_ = std::thread(&checkpointer_t<T>::writer_loop, this);
+    }
+    ~checkpointer_t() {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return !busy_; });
+            done_ = true;
+            cv_.notify_all();
+        }
+        writer_.join();
+    }
+
+    // wait until the snapshot being written, if any, is in the file
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !busy_; });
+    }
+
+    const std::string& filename() const { return filename_; }
+    unsigned snapshots() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return snapshots_;
+    }
+
+    // whether a snapshot should be taken now: the period has elapsed and
+    // the previous snapshot has been written
+    bool due() {
+        if( Utils::read_monotonic_time() - last_time_ < period_ ) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !busy_;
+    }
+
+    // serialize the state of the solve and hand it to the writer
+    void snapshot(const Problem::hash_t<T> &hash, const std::string &algorithm, size_t trials) {
+        size_t state_size = problem_.state_size();
+        if( state_size == 0 ) {
+            std::cout << Utils::warning() << "checkpoint: problem doesn't support serialization of states" << std::endl;
+            period_ = std::numeric_limits<float>::max();
+            return;
+        }
+
+        header_t header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic_, magic, sizeof(magic));
+        header.version_ = version;
+        header.byte_order_ = byte_order;
+        header.state_size_ = state_size;
+        header.record_size_ = record_size(state_size);
+        header.trials_ = trials;
+        header.updates_ = hash.updates();
+        memcpy(header.random_state_, Random::_state(), sizeof(header.random_state_));
+        header.name_size_ = algorithm.size();
+
+        // states spilled to the cold store are included
+        std::vector<char> bytes(sizeof(header_t) + algorithm.size());
+        bytes.reserve(bytes.size() + hash.size() * header.record_size_);
+        memcpy(&bytes[sizeof(header_t)], algorithm.data(), algorithm.size());
+        hash.for_each([&](const T &s, const Hash::data_t &data) {
+            float value = data.value();
+            int32_t action = data.action();
+            uint32_t flags = data.solved() ? header_t::Solved : 0;
+            size_t offset = bytes.size();
+            bytes.resize(offset + header.record_size_);
+            char *record = &bytes[offset];
+            problem_.serialize(s, record);
+            memcpy(record + state_size, &value, sizeof(float));
+            memcpy(record + state_size + sizeof(float), &action, sizeof(int32_t));
+            memcpy(record + state_size + sizeof(float) + sizeof(int32_t), &flags, sizeof(uint32_t));
+        });
+        header.num_records_ = (bytes.size() - sizeof(header_t) - algorithm.size()) / header.record_size_;
+        header.checksum_ = checksum(&bytes[sizeof(header_t)], bytes.size() - sizeof(header_t));
+        memcpy(&bytes[0], &header, sizeof(header));
+        last_time_ = Utils::read_monotonic_time();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.swap(bytes);
+        busy_ = true;
+        cv_.notify_all();
+    }
+
+    // load the snapshot in the file into the hash table if it belongs to
+    // the algorithm, and restore the random generator; returns the number
+    // of trials done, or 0 if there's no snapshot to resume from
+    size_t resume(Problem::hash_t<T> &hash, const std::string &algorithm) const {
+        std::ifstream is(filename_.c_str(), std::ios::binary);
+        if( !is ) return 0;
+        std::vector<char> bytes((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+
+        header_t header;
+        std::string reason;
+        if( bytes.size() < sizeof(header_t) ) {
+            reason = "is not a checkpoint";
+        } else {
+            memcpy(&header, &bytes[0], sizeof(header));
+            if( memcmp(header.magic_, magic, sizeof(magic)) != 0 )
+                reason = "is not a checkpoint";
+            else if( header.version_ != version )
+                reason = "has version " + std::to_string(header.version_) + " (expected " + std::to_string(version) + ")";
+            else if( header.byte_order_ != byte_order )
+                reason = "was written on a host with another byte order";
+            else if( (header.state_size_ != problem_.state_size()) || (header.record_size_ != record_size(header.state_size_)) )
+                reason = "has states of " + std::to_string(header.state_size_) + " bytes (expected " + std::to_string(problem_.state_size()) + ")";
+            else if( (sizeof(header_t) + header.name_size_ + header.num_records_ * header.record_size_ != bytes.size()) ||
+                     (checksum(&bytes[sizeof(header_t)], bytes.size() - sizeof(header_t)) != header.checksum_) )
+                reason = "is truncated or corrupt";
+            else if( std::string(&bytes[sizeof(header_t)], header.name_size_) != algorithm )
+                reason = "belongs to '" + std::string(&bytes[sizeof(header_t)], header.name_size_) + "'";
+        }
+        if( !reason.empty() ) {
+            std::cout << Utils::warning() << "checkpoint: '" << filename_ << "' " << reason << "; starting from scratch" << std::endl;
+            return 0;
+        }
+
+        T s;
+        const char *record = &bytes[sizeof(header_t) + header.name_size_];
+        for( size_t i = 0; i < header.num_records_; ++i, record += header.record_size_ ) {
+            float value;
+            int32_t action;
+            uint32_t flags;
+            if( !problem_.deserialize(record, s) ) {
+                std::cout << Utils::warning() << "checkpoint: problem doesn't support deserialization of states; starting from scratch" << std::endl;
+                hash.clear();
+                return 0;
+            }
+            memcpy(&value, record + header.state_size_, sizeof(float));
+            memcpy(&action, record + header.state_size_ + sizeof(float), sizeof(int32_t));
+            memcpy(&flags, record + header.state_size_ + sizeof(float) + sizeof(int32_t), sizeof(uint32_t));
+            hash.update(s, value);
+            Hash::data_t *dptr = hash.data_ptr(s);
+            dptr->set_action(action);
+            if( flags & header_t::Solved ) dptr->solve();
+        }
+        hash.set_updates(header.updates_);
+        memcpy(Random::_state(), header.random_state_, sizeof(header.random_state_));
+        std::cout << "checkpoint: resuming from '" << filename_ << "':"
+                  << " #states=" << header.num_records_
+                  << " #trials=" << header.trials_
+                  << " #updates=" << header.updates_
+                  << std::endl;
+        return header.trials_;
+    }
+};
+
+}; // namespace Checkpoint
+
+#undef DEBUG
+
+#endif
+
@@ -0,0 +1,157 @@
+/*
+ *  Copyright (c) 2011-2016 Universidad Simon Bolivar
+ *
+ *  Permission is hereby granted to distribute this software for
+ *  non-commercial research purposes, provided that this copyright
+ *  notice is included with any such distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ *  EITHER EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE.  THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE
+ *  SOFTWARE IS WITH YOU.  SHOULD THE PROGRAM PROVE DEFECTIVE, YOU
+ *  ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ *
+ *  Blai Bonet, bonet@ldc.usb.ve
+ *
+ */
+
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <cassert>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//#define DEBUG
+
+// Instrumentation counters for the hot paths of the engine. They are
+// compiled in only with -DUSE_COUNTERS; otherwise COUNT() expands to
+// nothing and enabled() is false. Each thread increments its own counters
+// without synchronization, and the registry adds them up when read.
+
+#ifdef USE_COUNTERS
+#define COUNT(counter) Counters::local().counts_[Counters::counter] += 1
+#define COUNT_ADD(counter, n) Counters::local().counts_[Counters::counter] += (n)
+#else
+#define COUNT(counter) ((void)0)
+#define COUNT_ADD(counter, n) ((void)0)
+#endif
+
+namespace Counters {
+
+enum counter_t {
+    HashProbes,           // lookups in hash tables
+    HashHits,             // lookups that found the state
+    HashInserts,          // states inserted in hash tables
+    Backups,              // updates of values in hash tables
+    NextSample,           // next() called to sample an outcome
+    NextBackup,           // next() called to compute a Q-value
+    NextAlgorithm,        // next() called by an offline algorithm
+    NextPolicy,           // next() called by an online policy
+    Trials,               // trials of lrtdp, uct and online rtdp
+    TrialSteps,           // total length of the trials
+    Iterations,           // iterations of vi, ilao, ldfs and hdp
+    CheckSolvedCalls,     // calls to check_solved (lrtdp and hdp)
+    CheckSolvedVisited,   // states visited by check_solved
+    HeuristicCalls,       // heuristic evaluations by algorithms and policies
+    Expansions,           // expansions of nodes by online policies
+    Rollouts,             // evaluations by base policies in uct and aot
+    AllocatedBytes,       // bytes allocated for hash entries and tree nodes
+    NumCounters
+};
+
+inline const char* name(counter_t counter) {
+    static const char *names[] = {
+        "hash.probes", "hash.hits", "hash.inserts", "backups",
+        "next.sample", "next.backup", "next.algorithm", "next.policy",
+        "trials", "trial-steps", "iterations",
+        "check-solved.calls", "check-solved.visited",
+        "heuristic.calls", "expansions", "rollouts", "allocated-bytes"
+    };
+    assert(counter < NumCounters);
+    return names[counter];
+}
+
+inline bool enabled() {
+#ifdef USE_COUNTERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+struct local_t;
+
+// Counters of the running threads, and the sum of those of finished threads
+struct registry_t {
+    std::mutex mutex_;
+    std::vector<local_t*> locals_;
+    unsigned long long finished_[NumCounters];
+    registry_t() {
+        for( int i = 0; i < NumCounters; ++i ) finished_[i] = 0;
+    }
+};
+
+inline registry_t& registry() {
+    static registry_t registry;
+    return registry;
+}
+
+struct local_t {
+    unsigned long long counts_[NumCounters];
+    local_t() {
+        for( int i = 0; i < NumCounters; ++i ) counts_[i] = 0;
+        std::lock_guard<std::mutex> lock(registry().mutex_);
+        registry().locals_.push_back(this);
+    }
+    ~local_t() {
+        registry_t &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex_);
+        for( int i = 0; i < NumCounters; ++i ) r.finished_[i] += counts_[i];
+        for( int i = 0, isz = r.locals_.size(); i < isz; ++i ) {
+            if( r.locals_[i] == this ) {
+                r.locals_[i] = r.locals_.back();
+                r.locals_.pop_back();
+                break;
+            }
+        }
+    }
+};
+
+inline local_t& local() {
+    static thread_local local_t counters;
+    return counters;
+}
+
+// Totals over all threads. Reads should happen while other threads are
+// idle (e.g. between batches of a thread pool) to get exact figures.
+inline std::vector<unsigned long long> totals() {
+    std::vector<unsigned long long> counts(NumCounters, 0);
+    registry_t &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex_);
+    for( int i = 0; i < NumCounters; ++i ) {
+        counts[i] = r.finished_[i];
+        for( int j = 0, jsz = r.locals_.size(); j < jsz; ++j )
+            counts[i] += r.locals_[j]->counts_[i];
+    }
+    return counts;
+}
+
+inline void reset() {
+    registry_t &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex_);
+    for( int i = 0; i < NumCounters; ++i ) {
+        r.finished_[i] = 0;
+        for( int j = 0, jsz = r.locals_.size(); j < jsz; ++j )
+            r.locals_[j]->counts_[i] = 0;
+    }
+}
+
+}; // namespace Counters
+
+#undef DEBUG
+
+#endif
+
@@ -19,7 +19,12 @@
 #ifndef DISPATCHER_H
 #define DISPATCHER_H
 
+#include "checkpoint.h"
+#include "counters.h"
+#include "perf.h"
 #include "problem.h"
+#include "stats.h"
+#include "trace.h"
 
 #include <iostream>
 #include <iomanip>
@@ -27,6 +32,7 @@
 #include <cassert>
 #include <map>
 #include <string>
+#include <vector>
 #include <strings.h>
 
 // forward references
@@ -43,6 +49,9 @@ namespace Online {
   namespace Policy {
     template<typename T> class policy_t;
   };
+  namespace Evaluation {
+    struct trials_t;
+  };
 };
 
 namespace Dispatcher {
@@ -51,8 +60,45 @@ template<typename T> class dispatcher_t {
     std::map<std::string, Algorithm::algorithm_t<T>*> algorithms_;
     std::map<std::string, Heuristic::heuristic_t<T>*> heuristics_;
     std::map<std::string, Online::Policy::policy_t<T>*> policies_;
+    Stats::sink_t *sink_;
+    std::string checkpoint_filename_;
+    float checkpoint_period_;
 
   public:
+    // hardware counters over a solve or evaluation, and over the named
+    // phases that ran in it (empty unless Perf::enable() succeeded)
+    struct perf_result_t {
+        bool valid_;
+        Perf::sample_t total_;
+        std::map<std::string, Perf::sample_t> phases_;
+        perf_result_t() : valid_(false) { }
+
+        void start() {
+            valid_ = Perf::enabled();
+            if( valid_ ) {
+                phases_ = Perf::phase_samples();
+                total_ = Perf::counters().read();
+            }
+        }
+        void stop() {
+            if( valid_ ) {
+                total_ = Perf::counters().read() - total_;
+                std::map<std::string, Perf::sample_t> before;
+                before.swap(phases_);
+                std::map<std::string, Perf::sample_t> after = Perf::phase_samples();
+                for( typename std::map<std::string, Perf::sample_t>::const_iterator it = after.begin(); it != after.end(); ++it ) {
+                    Perf::sample_t sample = it->second - before[it->first];
+                    for( int i = 0; i < Perf::NumEvents; ++i ) {
+                        if( sample.values_[i] != 0 ) {
+                            phases_.insert(std::make_pair(it->first, sample));
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    };
+
     struct solve_result_t {
         T state_;
         std::string name_;
@@ -62,6 +108,8 @@ template<typename T> class dispatcher_t {
         const Problem::hash_t<T> *hash_;
         const Heuristic::heuristic_t<T> *heuristic_;
         float time_raw_;
+        std::vector<unsigned long long> counters_;
+        perf_result_t perf_;
     };
 
     struct evaluate_result_t {
@@ -71,16 +119,31 @@ template<typename T> class dispatcher_t {
 
         unsigned problem_expansions_;
 
+        unsigned eval_trials_;
         float eval_value_;
         float eval_stdev_;
+        float eval_halfwidth_;
 
         float time_raw_;
         float time_policy_;
         float time_heuristic_;
         float time_algorithm_;
+
+        std::vector<unsigned long long> counters_;
+        perf_result_t perf_;
     };
 
-    dispatcher_t() { }
+    struct paired_result_t {
+        std::string first_;
+        std::string second_;
+        unsigned trials_;
+        float value_;
+        float stdev_;
+        float halfwidth_;
+        float unpaired_halfwidth_;
+    };
+
+    dispatcher_t() : sink_(0), checkpoint_period_(0) { }
     virtual ~dispatcher_t() {
         for( typename std::map<std::string, Algorithm::algorithm_t<T>*>::const_iterator it = algorithms_.begin(); it != algorithms_.end(); ++it )
             delete it->second;
@@ -90,6 +153,63 @@ template<typename T> class dispatcher_t {
             delete it->second;
     }
 
+    // print_stats() also writes each record to the sink, if any (not owned)
+    void set_stats_sink(Stats::sink_t *sink) { sink_ = sink; }
+
+    // solve() takes snapshots of algorithms that support checkpoints every
+    // period seconds, and resumes from the snapshot in the file if it
+    // belongs to the algorithm being solved
+    void set_checkpoint(const std::string &filename, float period) {
+        checkpoint_filename_ = filename;
+        checkpoint_period_ = period;
+    }
+
+    // instrumentation counters (empty unless compiled with -DUSE_COUNTERS)
+    static void print_counters(std::ostream &os, const std::vector<unsigned long long> &counters) {
+        for( int i = 0, isz = counters.size(); i < isz; ++i )
+            os << " counters." << Counters::name(Counters::counter_t(i)) << "=" << counters[i];
+    }
+    static void record_counters(Stats::record_t &record, const std::vector<unsigned long long> &counters) {
+        for( int i = 0, isz = counters.size(); i < isz; ++i )
+            record.add(std::string("counters.") + Counters::name(Counters::counter_t(i)), counters[i]);
+    }
+
+    // hardware counters (only the available events)
+    static void print_perf(std::ostream &os, const std::string &prefix, const Perf::sample_t &sample) {
+        for( int i = 0; i < Perf::NumEvents; ++i ) {
+            if( Perf::counters().available(Perf::event_t(i)) )
+                os << " " << prefix << Perf::name(Perf::event_t(i)) << "=" << (unsigned long long)sample.values_[i];
+        }
+        if( Perf::counters().available(Perf::Cycles) && Perf::counters().available(Perf::Instructions) && (sample.values_[Perf::Cycles] > 0) )
+            os << " " << prefix << "ipc=" << sample.values_[Perf::Instructions] / sample.values_[Perf::Cycles];
+    }
+    static void print_perf(std::ostream &os, const perf_result_t &perf) {
+        if( !perf.valid_ ) return;
+        print_perf(os, "perf.", perf.total_);
+        for( typename std::map<std::string, Perf::sample_t>::const_iterator it = perf.phases_.begin(); it != perf.phases_.end(); ++it )
+            print_perf(os, "perf." + it->first + ".", it->second);
+    }
+    static void record_perf(Stats::record_t &record, const std::string &prefix, const Perf::sample_t &sample) {
+        for( int i = 0; i < Perf::NumEvents; ++i ) {
+            if( Perf::counters().available(Perf::event_t(i)) )
+                record.add(prefix + Perf::name(Perf::event_t(i)), sample.values_[i]);
+        }
+    }
+    static void record_perf(Stats::record_t &record, const perf_result_t &perf) {
+        if( !perf.valid_ ) return;
+        record_perf(record, "perf.", perf.total_);
+        for( typename std::map<std::string, Perf::sample_t>::const_iterator it = perf.phases_.begin(); it != perf.phases_.end(); ++it )
+            record_perf(record, "perf." + it->first + ".", it->second);
+    }
+
+    // evaluations with threads call the problem from several threads
+    static void check_concurrency(const Problem::problem_t<T> &problem, unsigned num_threads) {
+        if( (num_threads > 0) && !problem.concurrent() ) {
+            std::cout << Utils::error() << "dispatcher: evaluation with threads requires a problem that supports concurrent calls" << std::endl;
+            exit(1);
+        }
+    }
+
     void insert_algorithm(const std::string &request, Algorithm::algorithm_t<T> *algorithm) {
         algorithms_.insert(std::make_pair(request, algorithm));
     }
@@ -118,8 +238,10 @@ template<typename T> class dispatcher_t {
     void create_request(const Problem::problem_t<T> &problem, const std::string &type, const std::string &request);
     void solve(const std::string &name, const Algorithm::algorithm_t<T> &algorithm, const T &s, solve_result_t &result) const;
     void print_stats(std::ostream &os, const solve_result_t &result) const;
-    void evaluate(const std::string &name, const Online::Policy::policy_t<T> &policy, const T &s, evaluate_result_t &result, unsigned num_trials, unsigned max_evaluation_depth, bool verbose) const;
+    void evaluate(const std::string &name, const Online::Policy::policy_t<T> &policy, const T &s, evaluate_result_t &result, const Online::Evaluation::trials_t &trials, unsigned max_evaluation_depth, bool verbose, unsigned num_threads = 0) const;
     void print_stats(std::ostream &os, const evaluate_result_t &result) const;
+    void evaluate_paired(const std::vector<std::pair<std::string, Online::Policy::policy_t<T>*> > &policies, const T &s, std::vector<evaluate_result_t> &results, std::vector<paired_result_t> &differences, const Online::Evaluation::trials_t &trials, unsigned max_evaluation_depth, bool verbose, unsigned num_threads = 0) const;
+    void print_stats(std::ostream &os, const paired_result_t &result) const;
 };
 
 }; // namespace Dispatcher
@@ -139,8 +261,6 @@ template<typename T> class dispatcher_t {
 #include "rollout.h"
 #include "uct.h"
 #include "aot.h"
-#include "aot_gh.h"
-#include "aot_path.h"
 #include "online_rtdp.h"
 
 //#define DEBUG
@@ -225,6 +345,8 @@ template<typename T> void dispatcher_t<T>::create_request(const Problem::problem
             heuristic = new Heuristic::optimal_heuristic_t<T>(problem);
         else if( name == "scaled" )
             heuristic = new Heuristic::scaled_heuristic_t<T>(problem);
+        else if( name == "file" )
+            heuristic = new Heuristic::file_heuristic_t<T>(problem);
 
         if( heuristic != 0 ) {
             heuristic->set_parameters(parameters, *this);
@@ -250,16 +372,14 @@ template<typename T> void dispatcher_t<T>::create_request(const Problem::problem
             policy = new Online::Policy::base_greedy_t<T>(problem);
         else if( name == "random" )
             policy = new Online::Policy::random_t<T>(problem);
+        else if( name == "file" )
+            policy = new Online::Policy::file_policy_t<T>(problem);
         else if( name == "rollout" )
             policy = new Online::Policy::Rollout::nested_rollout_t<T>(problem);
         else if( name == "uct" )
             policy = new Online::Policy::UCT::uct_t<T>(problem);
-        else if( name == "aot" )
-            policy = new Online::Policy::AOT::aot_t<T>(problem);
-        else if( name == "aot-gh" )
-            assert(0);
-        else if( name == "aot-path" )
-            assert(0);
+        else if( (name == "aot") || (name == "aot-gh") || (name == "aot-path") )
+            policy = Online::Policy::AOT::make_aot<T>(problem, name, parameters);
         else if( name == "finite-horizon-lrtdp" )
             policy = new Online::Policy::RTDP::finite_horizon_lrtdp_t<T>(problem);
 
@@ -276,6 +396,7 @@ template<typename T> void dispatcher_t<T>::create_request(const Problem::problem
 
 template<typename T> void dispatcher_t<T>::solve(const std::string &name, const Algorithm::algorithm_t<T> &algorithm, const T &s, solve_result_t &result) const {
     std::cout << "dispatcher: solve: " << name << std::endl;
+    Trace::scope_t scope("solve");
     const Problem::problem_t<T> &problem = algorithm.problem();
 
     result.name_ = name;
@@ -283,11 +404,30 @@ template<typename T> void dispatcher_t<T>::solve(const std::string &name, const
     result.state_ = s;
     result.seed_ = algorithm.seed();
     Random::set_seed(result.seed_);
+    Counters::reset();
 
-    float start_time = Utils::read_time_in_seconds();
+    double start_time = Utils::read_monotonic_time();
+    result.perf_.start();
     Problem::hash_t<T> *hash = new Problem::hash_t<T>(problem);
+    Checkpoint::checkpointer_t<T> *checkpointer = 0;
+    if( !checkpoint_filename_.empty() ) {
+        if( algorithm.supports_checkpoints() )
+            checkpointer = new Checkpoint::checkpointer_t<T>(problem, checkpoint_filename_, checkpoint_period_);
+        else
+            std::cout << Utils::warning() << "checkpoint: " << name << " doesn't support checkpoints" << std::endl;
+    }
+    algorithm.set_checkpointer(checkpointer);
     algorithm.solve(s, *hash);
-    float end_time = Utils::read_time_in_seconds();
+    algorithm.set_checkpointer(0);
+    result.perf_.stop();
+    double end_time = Utils::read_monotonic_time();
+    if( checkpointer != 0 ) {
+        checkpointer->wait();
+        unsigned snapshots = checkpointer->snapshots();
+        delete checkpointer;
+        std::cout << "checkpoint: " << snapshots << " snapshot(s) written to '" << checkpoint_filename_ << "'" << std::endl;
+    }
+    if( Counters::enabled() ) result.counters_ = Counters::totals();
 
     // expansions from problem
     result.problem_expansions_ = problem.expansions();
@@ -313,7 +453,12 @@ template<typename T> void dispatcher_t<T>::print_stats(std::ostream &os, const s
     // stats from hash
     const Problem::hash_t<T> &hash = *result.hash_;
     os << Utils::green() << " hash.value=" << hash.value(result.state_) << Utils::normal()
-       << " hash.updates=" << hash.updates();
+       << " hash.updates=" << hash.updates()
+       << " hash.size=" << hash.size();
+    if( hash.max_memory() > 0 )
+        os << " hash.memory=" << hash.memory() << " hash.evictions=" << hash.evictions();
+    if( hash.cold_store() != 0 )
+        os << " hash.spilled=" << hash.cold_store()->size() << " hash.faults=" << hash.faults();
     if( (result.name_.substr(0, 12) != "simple_astar") && (result.name_.substr(0, 9) != "simple_a*") )
         os << " hash.policy-size=" << problem.policy_size(hash, result.state_);
 
@@ -329,31 +474,76 @@ template<typename T> void dispatcher_t<T>::print_stats(std::ostream &os, const s
     float time_heuristic = heuristic == 0 ? 0 : heuristic->eval_time();
     os << " time.raw=" << result.time_raw_
        << " time.heuristic=" << (heuristic == 0 ? std::string("na") : std::to_string(time_heuristic))
-       << " time.algorithm=" << result.time_raw_ - time_heuristic
-       << std::endl;
+       << " time.algorithm=" << result.time_raw_ - time_heuristic;
+    print_counters(os, result.counters_);
+    print_perf(os, result.perf_);
+    os << std::endl;
+    Hash::bucket_stats_t hash_stats;
+    if( Hash::stats_enabled() ) {
+        hash_stats.add(hash);
+        hash_stats.print(os, 2, "solve");
+    }
+
+    if( sink_ != 0 ) {
+        Stats::record_t record("solve");
+        record.add("name", result.name_)
+              .add("seed", result.seed_)
+              .add("problem.expansions", result.problem_expansions_)
+              .add("hash.value", hash.value(result.state_))
+              .add("hash.updates", hash.updates())
+              .add("hash.size", (unsigned long)hash.size());
+        if( hash.max_memory() > 0 )
+            record.add("hash.memory", (unsigned long)hash.memory()).add("hash.evictions", (unsigned long)hash.evictions());
+        if( hash.cold_store() != 0 )
+            record.add("hash.spilled", (unsigned long)hash.cold_store()->size()).add("hash.faults", (unsigned long)hash.faults());
+        if( Hash::stats_enabled() ) hash_stats.record(record, "hash.buckets.");
+        if( (result.name_.substr(0, 12) != "simple_astar") && (result.name_.substr(0, 9) != "simple_a*") )
+            record.add("hash.policy-size", problem.policy_size(hash, result.state_));
+        if( heuristic != 0 ) {
+            record.add("heuristic.eval-time", heuristic->eval_time())
+                  .add("heuristic.setup-time", heuristic->setup_time())
+                  .add("heuristic.evaluations", heuristic->evaluations())
+                  .add("heuristic.size", heuristic->size())
+                  .add("time.heuristic", time_heuristic);
+        }
+        record.add("time.raw", result.time_raw_)
+              .add("time.algorithm", result.time_raw_ - time_heuristic);
+        record_counters(record, result.counters_);
+        record_perf(record, result.perf_);
+        sink_->write(record);
+    }
 }
 
-template<typename T> void dispatcher_t<T>::evaluate(const std::string &name, const Online::Policy::policy_t<T> &policy, const T &s, evaluate_result_t &result, unsigned num_trials, unsigned max_evaluation_depth, bool verbose) const {
+template<typename T> void dispatcher_t<T>::evaluate(const std::string &name, const Online::Policy::policy_t<T> &policy, const T &s, evaluate_result_t &result, const Online::Evaluation::trials_t &trials, unsigned max_evaluation_depth, bool verbose, unsigned num_threads) const {
     std::cout << "dispatcher: evaluate: " << name << std::endl;
+    Trace::scope_t scope("evaluate");
     const Problem::problem_t<T> &problem = policy.problem();
+    check_concurrency(problem, num_threads);
     policy.reset_stats();
 
     result.name_ = name;
     result.policy_ = &policy;
     result.seed_ = policy.seed();
     Random::set_seed(result.seed_);
-
-    float start_time = Utils::read_time_in_seconds();
-    std::pair<float, float> p = Online::Evaluation::evaluation_with_stdev(policy, problem.init(), num_trials, max_evaluation_depth, verbose);
-    result.eval_value_ = p.first;
-    result.eval_stdev_ = p.second;
-    float end_time = Utils::read_time_in_seconds();
+    Counters::reset();
+
+    Utils::mean_variance_t stats;
+    float time = 0;
+    result.perf_.start();
+    Online::Evaluation::evaluation(policy, problem.init(), trials, max_evaluation_depth, stats, time, verbose, num_threads);
+    result.perf_.stop();
+    if( Counters::enabled() ) result.counters_ = Counters::totals();
+    result.eval_trials_ = stats.n();
+    result.eval_value_ = stats.mean();
+    result.eval_stdev_ = stats.stdev();
+    result.eval_halfwidth_ = stats.n() < 2 ? 0 : Utils::confidence_halfwidth(stats, trials.confidence_);
 
     // expansions from problem
     result.problem_expansions_ = problem.expansions();
 
-    // time stats
-    result.time_raw_ = end_time - start_time;
+    // time stats: base policy and heuristic times are taken on the monotonic
+    // clock, so the raw time is too
+    result.time_raw_ = time;
 }
 
 template<typename T> void dispatcher_t<T>::print_stats(std::ostream &os, const evaluate_result_t &result) const {
@@ -368,7 +558,9 @@ template<typename T> void dispatcher_t<T>::print_stats(std::ostream &os, const e
 
     // stats from trials
     os << Utils::green() << " eval.value=" << result.eval_value_ << Utils::normal()
-       << " eval.stdev=" << result.eval_stdev_;
+       << " eval.trials=" << result.eval_trials_
+       << " eval.stdev=" << result.eval_stdev_
+       << " eval.halfwidth=" << result.eval_halfwidth_;
 
     // time stats
     os << " time.raw=" << result.time_raw_
@@ -377,9 +569,113 @@ template<typename T> void dispatcher_t<T>::print_stats(std::ostream &os, const e
          os << " time.base-policy=" << policy.base_policy_time();
     if( policy.uses_heuristic() != Online::Policy::policy_t<T>::usage_t::No )
          os << " time.heuristic=" << policy.heuristic_time();
-    os << " time.policy=" << result.time_raw_ - policy.base_policy_time() - policy.heuristic_time()
-       << std::endl;
+    os << " time.policy=" << result.time_raw_ - policy.base_policy_time() - policy.heuristic_time();
+    print_counters(os, result.counters_);
+    print_perf(os, result.perf_);
+    os << std::endl;
     policy.print_other_stats(os, 2);
+
+    if( sink_ != 0 ) {
+        Stats::record_t record("eval");
+        record.add("name", result.name_)
+              .add("seed", result.seed_)
+              .add("problem.expansions", result.problem_expansions_)
+              .add("eval.value", result.eval_value_)
+              .add("eval.trials", result.eval_trials_)
+              .add("eval.stdev", result.eval_stdev_)
+              .add("eval.halfwidth", result.eval_halfwidth_)
+              .add("time.raw", result.time_raw_)
+              .add("time.setup", policy.setup_time());
+        if( policy.uses_base_policy() != Online::Policy::policy_t<T>::usage_t::No )
+            record.add("time.base-policy", policy.base_policy_time());
+        if( policy.uses_heuristic() != Online::Policy::policy_t<T>::usage_t::No )
+            record.add("time.heuristic", policy.heuristic_time());
+        record.add("time.policy", result.time_raw_ - policy.base_policy_time() - policy.heuristic_time());
+        record_counters(record, result.counters_);
+        record_perf(record, result.perf_);
+        policy.record_other_stats(record, "other.");
+        sink_->write(record);
+    }
+}
+
+template<typename T> void dispatcher_t<T>::evaluate_paired(const std::vector<std::pair<std::string, Online::Policy::policy_t<T>*> > &policies, const T &s, std::vector<evaluate_result_t> &results, std::vector<paired_result_t> &differences, const Online::Evaluation::trials_t &trials, unsigned max_evaluation_depth, bool verbose, unsigned num_threads) const {
+    Trace::scope_t scope("evaluate-paired");
+    std::vector<const Online::Policy::policy_t<T>*> evaluated;
+    for( int i = 0; i < int(policies.size()); ++i ) {
+        std::cout << "dispatcher: evaluate-paired: " << policies[i].first << std::endl;
+        policies[i].second->reset_stats();
+        evaluated.push_back(policies[i].second);
+    }
+    if( evaluated.empty() ) return;
+    const Problem::problem_t<T> &problem = evaluated[0]->problem();
+    check_concurrency(problem, num_threads);
+
+    std::vector<Utils::mean_variance_t> values, paired_values;
+    std::vector<float> times;
+    Online::Evaluation::paired_evaluation(evaluated, s, Online::g_seed, trials, max_evaluation_depth, values, paired_values, times, verbose, num_threads);
+
+    // counters aren't reported since trials of all policies are interleaved
+    results.clear();
+    for( int i = 0; i < int(policies.size()); ++i ) {
+        evaluate_result_t result;
+        result.name_ = policies[i].first;
+        result.policy_ = policies[i].second;
+        result.seed_ = policies[i].second->seed();
+        result.problem_expansions_ = problem.expansions();
+        result.eval_trials_ = values[i].n();
+        result.eval_value_ = values[i].mean();
+        result.eval_stdev_ = values[i].stdev();
+        result.eval_halfwidth_ = values[i].n() < 2 ? 0 : Utils::confidence_halfwidth(values[i], trials.confidence_);
+        result.time_raw_ = times[i];
+        results.push_back(result);
+    }
+
+    differences.clear();
+    for( int i = 0, k = 0; i < int(policies.size()); ++i ) {
+        for( int j = i + 1; j < int(policies.size()); ++j, ++k ) {
+            const Utils::mean_variance_t &stats = paired_values[k];
+            paired_result_t result;
+            result.first_ = policies[i].first;
+            result.second_ = policies[j].first;
+            result.trials_ = stats.n();
+            result.value_ = stats.mean();
+            result.stdev_ = stats.stdev();
+            result.halfwidth_ = stats.n() < 2 ? 0 : Utils::confidence_halfwidth(stats, trials.confidence_);
+
+            // half-width had the policies been evaluated independently
+            result.unpaired_halfwidth_ = 0;
+            if( stats.n() > 1 ) {
+                float q = Utils::student_t_quantile((1 + trials.confidence_) / 2, stats.n() - 1);
+                result.unpaired_halfwidth_ = q * sqrt((values[i].variance() + values[j].variance()) / stats.n());
+            }
+            differences.push_back(result);
+        }
+    }
+}
+
+template<typename T> void dispatcher_t<T>::print_stats(std::ostream &os, const paired_result_t &result) const {
+    os << Utils::green() << "stats:" << Utils::normal()
+       << " type=paired"
+       << " first=" << result.first_
+       << " second=" << result.second_
+       << " eval.trials=" << result.trials_
+       << Utils::green() << " diff.value=" << result.value_ << Utils::normal()
+       << " diff.stdev=" << result.stdev_
+       << " diff.halfwidth=" << result.halfwidth_
+       << " diff.unpaired-halfwidth=" << result.unpaired_halfwidth_
+       << std::endl;
+
+    if( sink_ != 0 ) {
+        Stats::record_t record("paired");
+        record.add("first", result.first_)
+              .add("second", result.second_)
+              .add("eval.trials", result.trials_)
+              .add("diff.value", result.value_)
+              .add("diff.stdev", result.stdev_)
+              .add("diff.halfwidth", result.halfwidth_)
+              .add("diff.unpaired-halfwidth", result.unpaired_halfwidth_);
+        sink_->write(record);
+    }
 }
 
 }; // namespace Dispatcher
@@ -19,12 +19,19 @@
 #ifndef HASH_H
 #define HASH_H
 
+#include "counters.h"
+#include "stats.h"
 #include "utils.h"
 
 #include <iostream>
+#include <iomanip>
+#include <algorithm>
 #include <cassert>
+#include <functional>
 #include <limits>
 #include <limits.h>
+#include <stdint.h>
+#include <string>
 #include <vector>
 
 #if __clang_major__ >= 5
@@ -52,8 +59,10 @@ class data_t {
     float value_;
     bool solved_;
     bool marked_;
-    size_t count_;
+    unsigned count_;
     Problem::action_t action_;
+    unsigned stamp_; // epoch of last access (see hash_map_t::set_epoch)
+    unsigned id_;    // interned id (see hash_map_t::intern)
 
     union {
         struct {
@@ -68,9 +77,11 @@ class data_t {
     };
 
   public:
+    static const unsigned no_id = UINT_MAX;
+
     data_t(float value = 0, bool solved = false, bool marked = false, size_t count = 0)
       : value_(value), solved_(solved), marked_(marked),
-        count_(count), action_(Problem::noop) {
+        count_(count), action_(Problem::noop), stamp_(0), id_(no_id) {
         scc_.low_ = std::numeric_limits<unsigned>::max();
         scc_.idx_ = std::numeric_limits<unsigned>::max();
     }
@@ -98,6 +109,12 @@ class data_t {
     Problem::action_t action() const { return action_; }
     void set_action(Problem::action_t action) { action_ = action; }
 
+    unsigned stamp() const { return stamp_; }
+    void touch(unsigned stamp) { stamp_ = stamp; }
+
+    unsigned id() const { return id_; }
+    void set_id(unsigned id) { id_ = id; }
+
     size_t scc_low() const { return scc_.low_; }
     void set_scc_low(size_t low) { scc_.low_ = low; }
     size_t scc_idx() const { return scc_.idx_; }
@@ -131,11 +148,157 @@ inline std::ostream& operator<<(std::ostream &os, const Hash::data_t &data) {
 
 namespace Hash {
 
+// Domains hash states by packing or xoring their fields, which leaves the
+// low bits (that select the bucket) poorly distributed. Tables apply mix(),
+// the 64-bit finalizer of MurmurHash3, to those values: it's a bijection
+// in which every output bit depends on every input bit. combine() folds a
+// second value into a hash, e.g. the depth in the tables of online
+// algorithms or a field of a state.
+inline size_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+inline size_t combine(size_t h, size_t v) {
+    return mix(h ^ (uint64_t(v) * 0x9e3779b97f4a7c15ULL));
+}
+
 // Hash function for state
 template<typename T>
 class hash_function_t {
   public:
-    size_t operator()(const T &s) const { return s.hash(); }
+    size_t operator()(const T &s) const { return mix(s.hash()); }
+};
+
+// Diagnostics of hash tables (enabled with --hash-stats): the number of
+// buckets with chains of each length, the average number of entries that
+// a successful lookup compares, and the entries whose hash value equals
+// that of another entry, which no number of buckets can separate.
+inline bool& stats_enabled_flag() {
+    static bool enabled = false;
+    return enabled;
+}
+inline void enable_stats() { stats_enabled_flag() = true; }
+inline bool stats_enabled() { return stats_enabled_flag(); }
+
+struct bucket_stats_t {
+    enum { MaxChain = 8 }; // chains[MaxChain] counts longer chains
+    size_t tables_;
+    size_t entries_;
+    size_t buckets_;
+    size_t max_chain_;
+    size_t collisions_;
+    double probes_;
+    size_t chains_[1 + MaxChain];
+
+    bucket_stats_t() { clear(); }
+    void clear() {
+        tables_ = entries_ = buckets_ = max_chain_ = collisions_ = 0;
+        probes_ = 0;
+        for( size_t i = 0; i <= MaxChain; ++i ) chains_[i] = 0;
+    }
+
+    // add the buckets of the table, if it has entries
+    template<typename M> void add(const M &table) {
+        if( table.empty() ) return;
+        ++tables_;
+        entries_ += table.size();
+        buckets_ += table.bucket_count();
+        for( size_t i = 0; i < table.bucket_count(); ++i ) {
+            size_t n = table.bucket_size(i);
+            ++chains_[Utils::min(n, size_t(MaxChain))];
+            max_chain_ = Utils::max(max_chain_, n);
+            probes_ += n * (n + 1) / 2.0;
+        }
+        std::vector<size_t> hashes;
+        hashes.reserve(table.size());
+        for( typename M::const_iterator it = table.begin(); it != table.end(); ++it )
+            hashes.push_back(table.hash_function()(it->first));
+        std::sort(hashes.begin(), hashes.end());
+        for( size_t i = 1; i < hashes.size(); ++i )
+            collisions_ += hashes[i] == hashes[i - 1] ? 1 : 0;
+    }
+
+    template<typename M> bucket_stats_t with(const M &table) const {
+        bucket_stats_t stats(*this);
+        stats.add(table);
+        return stats;
+    }
+
+    void print(std::ostream &os, int indent, const std::string &name) const {
+        os << std::setw(indent) << ""
+           << "hash-stats: table=" << name
+           << " tables=" << tables_
+           << " entries=" << entries_
+           << " buckets=" << buckets_
+           << " load=" << (buckets_ == 0 ? 0 : double(entries_) / buckets_)
+           << " avg-probes=" << (entries_ == 0 ? 0 : probes_ / entries_)
+           << " max-chain=" << max_chain_
+           << " collisions=" << collisions_
+           << " chains=";
+        for( size_t i = 0; i <= MaxChain; ++i )
+            os << (i == 0 ? "" : ",") << chains_[i];
+        os << std::endl;
+    }
+    void record(Stats::record_t &record, const std::string &prefix) const {
+        record.add(prefix + "entries", (unsigned long)entries_)
+              .add(prefix + "buckets", (unsigned long)buckets_)
+              .add(prefix + "avg-probes", entries_ == 0 ? 0 : probes_ / entries_)
+              .add(prefix + "max-chain", (unsigned long)max_chain_)
+              .add(prefix + "collisions", (unsigned long)collisions_);
+    }
+};
+
+// Side array indexed by interned ids (see hash_map_t::intern) for the
+// values and flags that an algorithm keeps for states outside of their
+// entries. Slots that were never set read as the initial value.
+template<typename V> class id_array_t {
+    V init_;
+    std::vector<V> slots_;
+
+  public:
+    id_array_t(const V &init) : init_(init) { }
+    V operator[](unsigned id) const {
+        return id < slots_.size() ? slots_[id] : init_;
+    }
+    void set(unsigned id, const V &value) {
+        if( id >= slots_.size() ) slots_.resize(id + 1, init_);
+        slots_[id] = value;
+    }
+    void reset(unsigned id) {
+        if( id < slots_.size() ) slots_[id] = init_;
+    }
+    void clear() { slots_.clear(); }
+    size_t memory() const { return slots_.capacity() * sizeof(V); }
+};
+
+// State of Tarjan's algorithm over interned ids (hdp, ldfs): the index
+// and low link of each id, the mark of the states on the current path,
+// the stack of the components and the ids visited in the trial. reset()
+// clears the slots of the visited ids, so a trial costs its own size.
+struct scc_search_t {
+    static const unsigned no_index = std::numeric_limits<unsigned>::max();
+
+    size_t index_;
+    id_array_t<unsigned> idx_;
+    id_array_t<unsigned> low_;
+    id_array_t<bool> marked_;
+    std::vector<unsigned> stack_;
+    std::vector<unsigned> visited_;
+
+    scc_search_t() : index_(0), idx_(no_index), low_(no_index), marked_(false) { }
+    void reset() {
+        for( size_t i = 0, isz = visited_.size(); i < isz; ++i ) {
+            assert(idx_[visited_[i]] == no_index);
+            assert(low_[visited_[i]] == no_index);
+            marked_.reset(visited_[i]);
+        }
+        visited_.clear();
+        index_ = 0;
+    }
 };
 
 #if __clang_major__ >= 5
@@ -177,30 +340,183 @@ class hash_map_t : public generic_hash_map_t<T, Hash::data_t*, F> {
         float operator()(const T &s) const { return 0; }
     };
 
+  public: // direct indexing
+    // Perfect index of the states of enumerable problems into [0, n)
+    struct index_function_t {
+        virtual ~index_function_t() { }
+        virtual size_t operator()(const T &s) const = 0;
+    };
+
+  public: // cold storage
+    // Secondary storage for entries evicted from the table (see Spill).
+    // Lookups that miss in the table fault the state in from the store
+    // with its value, action and label. Appended records are visible to
+    // fetch() and scan() after flush().
+    struct cold_store_t {
+        typedef std::function<void(const T&, const Hash::data_t&)> callback_t;
+        virtual ~cold_store_t() { }
+        virtual void append(const T &s, const Hash::data_t &data) = 0;
+        virtual void flush() = 0;
+        virtual bool fetch(const T &s, Hash::data_t &data) const = 0;
+        virtual void scan(const callback_t &callback) const = 0; // latest record of each state
+        virtual size_t size() const = 0;                           // records appended
+    };
+
   protected:
     const eval_function_t *eval_function_;
-
+    unsigned epoch_;
+    cold_store_t *cold_store_;
+    size_t faults_;
+    std::vector<typename base_type::value_type*> interned_;
+    const index_function_t *index_function_;
+    std::vector<iterator> direct_;
+
+    iterator insert_entry(const T &s, Hash::data_t *d) {
+        COUNT(HashInserts);
+        COUNT_ADD(AllocatedBytes, sizeof(Hash::data_t));
+        d->touch(epoch_);
+        iterator di = base_type::insert(std::make_pair(s, d)).first;
+        if( index_function_ != 0 ) direct_[(*index_function_)(s)] = di;
+        return di;
+    }
     Hash::data_t* push(const T &s, Hash::data_t *d) {
-        base_type::insert(std::make_pair(s, d));
+        insert_entry(s, d);
         return d;
     }
 
-    iterator lookup(const T &s) { return base_type::find(s); }
-    const_iterator lookup(const T &s) const { return const_cast<hash_map_t<T>*>(this)->find(s); }
+    iterator lookup(const T &s) {
+        COUNT(HashProbes);
+        iterator di = index_function_ == 0 ? base_type::find(s) : direct_[(*index_function_)(s)];
+        if( di != end() ) {
+            COUNT(HashHits);
+            if( epoch_ != 0 ) (*di).second->touch(epoch_);
+        } else if( cold_store_ != 0 ) {
+            Hash::data_t data;
+            if( cold_store_->fetch(s, data) ) {
+                ++faults_;
+                di = insert_entry(s, new Hash::data_t(data));
+            }
+        }
+        return di;
+    }
+    const_iterator lookup(const T &s) const { return const_cast<hash_map_t<T>*>(this)->lookup(s); }
 
   public:
     hash_map_t(eval_function_t *eval_function = 0)
-      : eval_function_(eval_function) {
+      : eval_function_(eval_function), epoch_(0), cold_store_(0), faults_(0), index_function_(0) {
+    }
+    // copies don't share the cold store nor the direct index
+    hash_map_t(const hash_map_t &hash)
+      : base_type(hash), eval_function_(hash.eval_function_), epoch_(hash.epoch_), cold_store_(0), faults_(0), index_function_(0) {
     }
     virtual ~hash_map_t() {
         for( iterator hi = begin(); hi != end(); ++hi )
             delete (*hi).second;
+        delete cold_store_;
+    }
+
+    void clear() {
+        reset_interned();
+        for( iterator hi = begin(); hi != end(); ++hi )
+            delete (*hi).second;
+        base_type::clear();
+        direct_.assign(direct_.size(), end());
+    }
+    void erase(iterator di) {
+        if( index_function_ != 0 ) direct_[(*index_function_)((*di).first)] = end();
+        delete (*di).second;
+        base_type::erase(di);
+    }
+
+    // With an index function, lookups go through an array of iterators
+    // indexed by state instead of hashing. The buckets are reserved for
+    // all states up front so the table never rehashes and the iterators
+    // in the array stay valid (erase() clears the slot of the entry).
+    bool direct() const { return index_function_ != 0; }
+    void set_index_function(const index_function_t *index_function, size_t num_states) {
+        index_function_ = index_function;
+        direct_.clear();
+        if( index_function_ != 0 ) {
+            base_type::rehash(size_t(num_states / base_type::max_load_factor()) + 1);
+            direct_.assign(num_states, end());
+            for( iterator di = begin(); di != end(); ++di )
+                direct_[(*index_function_)((*di).first)] = di;
+        } else {
+            base_type::rehash(0);
+        }
+        direct_.shrink_to_fit();
+    }
+
+    // Dense ids for the states in the table, assigned on first use:
+    // intern() returns the id of the state, adding it with its default
+    // value if needed, and state() and data() map ids back to the state
+    // stored in the table and to its entry. Algorithms keep ids in their
+    // stacks and queues instead of copies of the states. Ids remain valid
+    // until entries are erased (eviction) or the table is cleared.
+    unsigned intern(const T &s) {
+        iterator di = lookup(s);
+        if( di == end() ) di = insert_entry(s, new Hash::data_t(default_value(s)));
+        Hash::data_t *dptr = (*di).second;
+        if( dptr->id() == Hash::data_t::no_id ) {
+            dptr->set_id(interned_.size());
+            interned_.push_back(&*di);
+        }
+        return dptr->id();
+    }
+    const T& state(unsigned id) const { return interned_[id]->first; }
+    Hash::data_t* data(unsigned id) const { return interned_[id]->second; }
+    size_t num_interned() const { return interned_.size(); }
+    void reset_interned() {
+        for( size_t i = 0, isz = interned_.size(); i < isz; ++i )
+            interned_[i]->second->set_id(Hash::data_t::no_id);
+        interned_.clear();
+        interned_.shrink_to_fit();
     }
 
     void set_eval_function(const eval_function_t *eval_function) {
         eval_function_ = eval_function;
     }
-    float default_value(const T &s) const { return eval_function_ == 0 ? 0 : (*eval_function_)(s); }
+
+    // When the epoch is not 0, lookups stamp entries with it so that the
+    // least recently used ones can be found (e.g. for eviction)
+    unsigned epoch() const { return epoch_; }
+    void set_epoch(unsigned epoch) { epoch_ = epoch; }
+
+    // the table owns the cold store
+    const cold_store_t* cold_store() const { return cold_store_; }
+    cold_store_t* cold_store() { return cold_store_; }
+    void set_cold_store(cold_store_t *cold_store) {
+        delete cold_store_;
+        cold_store_ = cold_store;
+    }
+    size_t faults() const { return faults_; }
+
+    // visit the entries in the table and then the states only in the
+    // cold store, without faulting them in
+    void for_each(const typename cold_store_t::callback_t &callback) const {
+        for( const_iterator hi = begin(); hi != end(); ++hi )
+            callback((*hi).first, *(*hi).second);
+        if( cold_store_ != 0 ) {
+            cold_store_->scan([&](const T &s, const Hash::data_t &data) {
+                if( base_type::find(s) == end() ) callback(s, data);
+            });
+        }
+    }
+
+    // estimated bytes used by the table: entries, nodes, buckets, the
+    // direct index and the interned ids
+    static size_t entry_bytes() {
+        return sizeof(Hash::data_t) + sizeof(typename base_type::value_type) + sizeof(void*) + sizeof(size_t);
+    }
+    size_t memory() const {
+        return base_type::size() * entry_bytes() + base_type::bucket_count() * sizeof(void*) +
+          direct_.size() * sizeof(iterator) + interned_.capacity() * sizeof(void*);
+    }
+    float default_value(const T &s) const {
+        if( eval_function_ == 0 ) return 0;
+        COUNT(HeuristicCalls);
+        return (*eval_function_)(s);
+    }
 
     Hash::data_t* data_ptr(const T &s) {
         iterator di = lookup(s);
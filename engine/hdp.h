@@ -22,7 +22,6 @@
 #include "algorithm.h"
 
 #include <cassert>
-#include <list>
 #include <string>
 #include <vector>
 
@@ -51,11 +50,15 @@ template<typename T> class hdp_t : public algorithm_t<T> {
     }
     virtual ~hdp_t() { }
     virtual algorithm_t<T>* clone() const {
-        return new hdp_t(problem_, epsilon_, heuristic_);
+        algorithm_t<T> *algorithm = new hdp_t(problem_, epsilon_, heuristic_);
+        algorithm->set_max_memory(algorithm_t<T>::max_memory_);
+        algorithm->set_spill(algorithm_t<T>::spill_);
+        return algorithm;
     }
     virtual std::string name() const {
         return std::string("hdp(heuristic=") + (heuristic_ == 0 ? std::string("null") : heuristic_->name()) +
           std::string(",epsilon=") + std::to_string(epsilon_) +
+          this->memory_name() +
           std::string(",seed=") + std::to_string(seed_) + ")";
     }
 
@@ -70,6 +73,7 @@ template<typename T> class hdp_t : public algorithm_t<T> {
         }
         it = parameters.find("seed");
         if( it != parameters.end() ) seed_ = strtol(it->second.c_str(), 0, 0);
+        algorithm_t<T>::set_memory_parameters(parameters);
 #ifdef DEBUG
         std::cout << "debug: hdp(): params:"
                   << " epsilon=" << epsilon_
@@ -79,25 +83,24 @@ template<typename T> class hdp_t : public algorithm_t<T> {
 #endif
     }
 
+    virtual bool supports_checkpoints() const { return true; }
+
     virtual void solve(const T &s, Problem::hash_t<T> &hash) const {
         reset_stats(hash);
         Heuristic::wrapper_t<T> eval_function(heuristic_);
+        size_t trials = this->resume(hash);
         hash.set_eval_function(&eval_function);
+        this->setup_memory(hash);
 
-        std::list<Hash::data_t*> stack, visited;
-        Hash::data_t *dptr = hash.data_ptr(s);
-        size_t trials = 0;
-        while( !dptr->solved() ) {
-            size_t index = 0;
-            hdp(s, hash, dptr, index, stack, visited);
-            assert(stack.empty());
-            while( !visited.empty() ) {
-                visited.front()->unmark();
-                assert(visited.front()->scc_low() == std::numeric_limits<unsigned>::max());
-                assert(visited.front()->scc_idx() == std::numeric_limits<unsigned>::max());
-                visited.pop_front();
-            }
+        Hash::scc_search_t search;
+        while( !hash.data_ptr(s)->solved() ) {
+            hdp(hash.intern(s), hash, search);
+            assert(search.stack_.empty());
+            search.reset();
             ++trials;
+            COUNT(Iterations);
+            hash.evict(s);
+            this->checkpoint(hash, trials);
         }
         hash.set_eval_function(0);
     }
@@ -108,19 +111,16 @@ template<typename T> class hdp_t : public algorithm_t<T> {
         hash.clear();
     }
 
-    bool hdp(const T &s,
-             Problem::hash_t<T> &hash,
-             Hash::data_t* dptr,
-             size_t &index,
-             std::list<Hash::data_t*> &stack,
-             std::list<Hash::data_t*> &visited) const {
+    bool hdp(unsigned id, Problem::hash_t<T> &hash, Hash::scc_search_t &search) const {
         std::vector<std::pair<T, float> > outcomes;
+        const T &s = hash.state(id);
+        Hash::data_t *dptr = hash.data(id);
 
         // base cases
         if( dptr->solved() || problem_.terminal(s) ) {
             dptr->solve();
             return true;
-        } else if( dptr->marked() ) {
+        } else if( search.marked_[id] ) {
             return false;
         }
 
@@ -133,26 +133,27 @@ template<typename T> class hdp_t : public algorithm_t<T> {
         }
 
         // Tarjan's
-        visited.push_front(dptr);
-        stack.push_front(dptr);
-        size_t idx = index++;
-        dptr->set_scc_low(idx);
-        dptr->set_scc_idx(idx);
-        dptr->mark();
+        search.visited_.push_back(id);
+        search.stack_.push_back(id);
+        unsigned idx = search.index_++;
+        search.low_.set(id, idx);
+        search.idx_.set(id, idx);
+        search.marked_.set(id, true);
 
         // expansion
+        COUNT(NextAlgorithm);
         problem_.next(s, p.first, outcomes);
         unsigned osize = outcomes.size();
 
         bool flag = true;
         for( unsigned i = 0; i < osize; ++i ) {
-            Hash::data_t *ptr = hash.data_ptr(outcomes[i].first);
-            if( ptr->scc_idx() == std::numeric_limits<unsigned>::max() ) {
-                bool rv = hdp(outcomes[i].first, hash, ptr, index, stack, visited);
+            unsigned oid = hash.intern(outcomes[i].first);
+            if( search.idx_[oid] == Hash::scc_search_t::no_index ) {
+                bool rv = hdp(oid, hash, search);
                 flag = flag && rv;
-                dptr->set_scc_low(Utils::min(dptr->scc_low(), hash.scc_low(outcomes[i].first)));
-            } else if( ptr->marked() ) {
-                dptr->set_scc_low(Utils::min(dptr->scc_low(), ptr->scc_idx()));
+                search.low_.set(id, Utils::min(search.low_[id], search.low_[oid]));
+            } else if( search.marked_[oid] ) {
+                search.low_.set(id, Utils::min(search.low_[id], search.idx_[oid]));
             }
         }
 
@@ -161,17 +162,17 @@ template<typename T> class hdp_t : public algorithm_t<T> {
             std::pair<Problem::action_t, float> p = hash.best_q_value(s);
             dptr->update(p.second);
             hash.inc_updates();
-            while( !stack.empty() && (stack.front()->scc_idx() >= idx) ) {
-                stack.front()->set_scc_low(std::numeric_limits<unsigned>::max());
-                stack.front()->set_scc_idx(std::numeric_limits<unsigned>::max());
-                stack.pop_front();
+            while( !search.stack_.empty() && (search.idx_[search.stack_.back()] >= idx) ) {
+                search.low_.reset(search.stack_.back());
+                search.idx_.reset(search.stack_.back());
+                search.stack_.pop_back();
             }
-        } else if( dptr->scc_low() == dptr->scc_idx() ) {
-            while( !stack.empty() && (stack.front()->scc_idx() >= idx) ) {
-                stack.front()->solve();
-                stack.front()->set_scc_low(std::numeric_limits<unsigned>::max());
-                stack.front()->set_scc_idx(std::numeric_limits<unsigned>::max());
-                stack.pop_front();
+        } else if( search.low_[id] == search.idx_[id] ) {
+            while( !search.stack_.empty() && (search.idx_[search.stack_.back()] >= idx) ) {
+                hash.data(search.stack_.back())->solve();
+                search.low_.reset(search.stack_.back());
+                search.idx_.reset(search.stack_.back());
+                search.stack_.pop_back();
             }
         }
         return flag;
@@ -21,8 +21,11 @@
 
 #include "hash.h"
 #include "problem.h"
+#include "trace.h"
 #include "utils.h"
+#include "value_file.h"
 
+#include <atomic>
 #include <cassert>
 #include <iostream>
 #include <limits>
@@ -37,9 +40,9 @@ namespace Heuristic {
 template<typename T> class heuristic_t {
   protected:
     const Problem::problem_t<T> &problem_;
-    mutable float eval_time_;
+    mutable std::atomic<float> eval_time_;  // heuristics are shared by threads
     mutable float setup_time_;
-    mutable unsigned evaluations_;
+    mutable std::atomic<unsigned> evaluations_;
 
   public:
     heuristic_t(const Problem::problem_t<T> &problem)
@@ -116,11 +119,8 @@ template<typename T> class min_min_heuristic_t : public heuristic_t<T> {
         return std::string("min-min(algorithm=") + (algorithm_ == 0 ? std::string("null") : algorithm_->name()) + ")";
     }
     virtual float value(const T &s) const {
-        float start_time = Utils::read_time_in_seconds();
-        ++evaluations_;
-        float hvalue = hash_ == 0 ? 0 : hash_->value(s);
-        eval_time_ += Utils::read_time_in_seconds() - start_time;
-        return hvalue;
+        Utils::sampled_timer_t timer(eval_time_, evaluations_++);
+        return hash_ == 0 ? 0 : hash_->value(s);
     }
     virtual size_t size() const { return hash_->size(); }
     virtual void dump(std::ostream &os) const { hash_->dump(os); }
@@ -137,6 +137,8 @@ template<typename T> class min_min_heuristic_t : public heuristic_t<T> {
                   << std::endl;
 #endif
         solve_problem();
+        it = parameters.find("save");
+        if( (it != parameters.end()) && !ValueFile::save(*hash_, it->second) ) exit(1);
     }
 
     void solve_problem() {
@@ -147,6 +149,7 @@ template<typename T> class min_min_heuristic_t : public heuristic_t<T> {
 #ifdef DEBUG
         std::cout << "debug: min-min(): solving problem with algorithm=" << algorithm_->name() << std::endl;
 #endif
+        Trace::scope_t scope("heuristic-setup");
         float start_time = Utils::read_time_in_seconds();
         algorithm_->solve(problem_.init(), *hash_);
         setup_time_ = Utils::read_time_in_seconds() - start_time;
@@ -154,6 +157,7 @@ template<typename T> class min_min_heuristic_t : public heuristic_t<T> {
 };
 
 template<typename T> class hash_heuristic_t : public heuristic_t<T> {
+  protected:
   using heuristic_t<T>::problem_;
   using heuristic_t<T>::eval_time_;
   using heuristic_t<T>::evaluations_;
@@ -174,11 +178,8 @@ template<typename T> class hash_heuristic_t : public heuristic_t<T> {
         return std::string("hash(hash-ptr=") + std::to_string(size_t(hash_)) + ")";
     }
     virtual float value(const T &s) const {
-        float start_time = Utils::read_time_in_seconds();
-        ++evaluations_;
-        float hvalue = hash_ == 0 ? 0 : hash_->value(s);
-        eval_time_ += Utils::read_time_in_seconds() - start_time;
-        return hvalue;
+        Utils::sampled_timer_t timer(eval_time_, evaluations_++);
+        return hash_ == 0 ? 0 : hash_->value(s);
     }
     virtual size_t size() const { return hash_->size(); }
     virtual void dump(std::ostream &os) const { hash_->dump(os); }
@@ -224,6 +225,8 @@ template<typename T> class optimal_heuristic_t : public hash_heuristic_t<T> {
                   << std::endl;
 #endif
         solve_problem();
+        it = parameters.find("save");
+        if( (it != parameters.end()) && !ValueFile::save(*hash_, it->second) ) exit(1);
     }
 
     void solve_problem() {
@@ -234,6 +237,7 @@ template<typename T> class optimal_heuristic_t : public hash_heuristic_t<T> {
 #ifdef DEBUG
         std::cout << "debug: optimal(): solving problem with algorithm=" << algorithm_->name() << std::endl;
 #endif
+        Trace::scope_t scope("heuristic-setup");
         float start_time = Utils::read_time_in_seconds();
         assert(algorithm_ != 0);
         algorithm_->solve(problem_.init(), *hash_);
@@ -241,6 +245,54 @@ template<typename T> class optimal_heuristic_t : public hash_heuristic_t<T> {
     }
 };
 
+// Heuristic given by the values in a value file (e.g. one written with
+// save=<file> by optimal() or min-min()); states not in the file get value 0
+template<typename T> class file_heuristic_t : public heuristic_t<T> {
+  using heuristic_t<T>::problem_;
+  using heuristic_t<T>::eval_time_;
+  using heuristic_t<T>::setup_time_;
+  using heuristic_t<T>::evaluations_;
+  protected:
+    std::string path_;
+    ValueFile::table_t<T> table_;
+
+    void open() {
+        float start_time = Utils::read_time_in_seconds();
+        if( !table_.open(path_) ) exit(1);
+        setup_time_ = Utils::read_time_in_seconds() - start_time;
+    }
+
+  public:
+    file_heuristic_t(const Problem::problem_t<T> &problem, const std::string &path = "")
+      : heuristic_t<T>(problem), path_(path), table_(problem) {
+        if( !path_.empty() ) open();
+    }
+    virtual ~file_heuristic_t() { }
+    virtual heuristic_t<T>* clone() const { return new file_heuristic_t<T>(problem_, path_); }
+    virtual std::string name() const {
+        return std::string("file(path=") + path_ + ")";
+    }
+    virtual float value(const T &s) const {
+        Utils::sampled_timer_t timer(eval_time_, evaluations_++);
+        const ValueFile::record_t *record = table_.find(s);
+        return record == 0 ? 0 : record->value_;
+    }
+    virtual size_t size() const { return table_.size(); }
+    virtual void dump(std::ostream &os) const { table_.dump(os); }
+    virtual void set_parameters(const std::multimap<std::string, std::string> &parameters, Dispatcher::dispatcher_t<T> &dispatcher) {
+        std::multimap<std::string, std::string>::const_iterator it = parameters.find("path");
+        if( it != parameters.end() ) path_ = it->second;
+#ifdef DEBUG
+        std::cout << "debug: file(): params: path=" << path_ << std::endl;
+#endif
+        if( path_.empty() ) {
+            std::cout << Utils::error() << "path must be specified for file() heuristic!" << std::endl;
+            exit(1);
+        }
+        open();
+    }
+};
+
 template<typename T> class scaled_heuristic_t : public heuristic_t<T> {
   using heuristic_t<T>::problem_;
   using heuristic_t<T>::eval_time_;
@@ -21,8 +21,8 @@
 
 #include "algorithm.h"
 
+#include <algorithm>
 #include <cassert>
-#include <list>
 #include <string>
 #include <vector>
 
@@ -37,18 +37,18 @@ template<typename T> class improved_lao_t : public algorithm_t<T> {
   protected:
     float epsilon_;
 
+    // The nodes and tips of the graph are interned ids, which are valid
+    // until the table evicts entries; the graph is recomputed after that.
     class policy_graph_t {
       protected:
-        typedef typename std::list<std::pair<T, Hash::data_t*> > pair_list;
         typedef typename std::vector<T>::iterator vector_iterator;
-        typedef typename pair_list::iterator list_iterator;
 
         const Problem::problem_t<T> &problem_;
         Problem::hash_t<T> &hash_;
         size_t size_;
         std::vector<T> roots_;
-        pair_list tips_;
-        pair_list nodes_;
+        std::vector<unsigned> tips_;
+        std::vector<unsigned> nodes_; // in reverse order of discovery
 
       public:
         policy_graph_t(const Problem::problem_t<T> &problem, Problem::hash_t<T> &hash)
@@ -57,8 +57,8 @@ template<typename T> class improved_lao_t : public algorithm_t<T> {
 
         size_t size() const { return size_; }
         void add_root(const T &s) { roots_.push_back(s); }
-        const pair_list& tips() const { return tips_; }
-        const pair_list& nodes() const { return nodes_; }
+        const std::vector<unsigned>& tips() const { return tips_; }
+        const std::vector<unsigned>& nodes() const { return nodes_; }
 
         void recompute() {
             std::vector<std::pair<T, float> > outcomes;
@@ -66,29 +66,32 @@ template<typename T> class improved_lao_t : public algorithm_t<T> {
             tips_.clear();
             nodes_.clear();
 
-            pair_list open;
+            std::vector<unsigned> open;
+            Hash::id_array_t<bool> marked(false);
             for( vector_iterator si = roots_.begin(); si != roots_.end(); ++si ) {
-                Hash::data_t *dptr = hash_.data_ptr(*si);
-                open.push_back(std::make_pair(*si, dptr));
-                dptr->solve();
-                dptr->mark();
+                unsigned id = hash_.intern(*si);
+                open.push_back(id);
+                hash_.data(id)->solve();
+                marked.set(id, true);
             }
 
-            while( !open.empty() ) {
-                std::pair<T, Hash::data_t*> n = open.front();
-                open.pop_front();
+            for( size_t head = 0; head < open.size(); ++head ) {
+                unsigned id = open[head];
+                const T &s = hash_.state(id);
+                Hash::data_t *dptr = hash_.data(id);
 
-                if( problem_.terminal( n.first ) ) {
-                    n.second->set_action(Problem::noop);
-                    nodes_.push_front(n);
+                if( problem_.terminal(s) ) {
+                    dptr->set_action(Problem::noop);
+                    nodes_.push_back(id);
                     ++size_;
                 } else {
                     bool unsolved = false;
-                    std::pair<Problem::action_t, float> p = hash_.best_q_value(n.first);
+                    std::pair<Problem::action_t, float> p = hash_.best_q_value(s);
                     assert(p.first != Problem::noop);
-                    n.second->set_action(p.first);
+                    dptr->set_action(p.first);
 
-                    problem_.next(n.first, p.first, outcomes);
+                    COUNT(NextAlgorithm);
+                    problem_.next(s, p.first, outcomes);
                     unsigned osize = outcomes.size();
 
                     for( unsigned i = 0; i < osize; ++i ) {
@@ -101,70 +104,68 @@ template<typename T> class improved_lao_t : public algorithm_t<T> {
                     ++size_;
                     if( !unsolved ) {
                         for( unsigned i = 0; i < osize; ++i ) {
-                            Hash::data_t *dptr = hash_.data_ptr(outcomes[i].first);
-                            if( !dptr->marked() ) {
-                                open.push_back(std::make_pair(outcomes[i].first, dptr));
-                                dptr->solve();
-                                dptr->mark();
+                            unsigned oid = hash_.intern(outcomes[i].first);
+                            if( !marked[oid] ) {
+                                open.push_back(oid);
+                                hash_.data(oid)->solve();
+                                marked.set(oid, true);
                             }
                         }
-                        nodes_.push_front(n);
+                        nodes_.push_back(id);
                     } else {
-                        tips_.push_back(n);
-                        n.second->set_action(Problem::noop);
+                        tips_.push_back(id);
+                        dptr->set_action(Problem::noop);
                     }
                 }
             }
-
-            // unmark nodes
-            for( list_iterator si = nodes_.begin(); si != nodes_.end(); ++si )
-                si->second->unmark();
-            for( list_iterator si = tips_.begin(); si != tips_.end(); ++si )
-                si->second->unmark();
+            std::reverse(nodes_.begin(), nodes_.end());
         }
 
-        void postorder_dfs(const T &s, pair_list &visited) {
-            pair_list open;
+        // visited gets the ids in reverse order of the traversal
+        void postorder_dfs(const T &s, std::vector<unsigned> &visited) {
+            std::vector<unsigned> open;
+            Hash::id_array_t<bool> marked(false);
 
             std::vector<std::pair<T, float> > outcomes;
-            Hash::data_t *dptr = hash_.data_ptr(s);
-            open.push_back(std::make_pair(s, dptr ));
-            dptr->mark();
+            unsigned id = hash_.intern(s);
+            open.push_back(id);
+            marked.set(id, true);
 
             while( !open.empty() ) {
-                std::pair<T, Hash::data_t*> n = open.back();
-                visited.push_front(n);
+                id = open.back();
+                visited.push_back(id);
                 open.pop_back();
-                assert(n.second->solved());
+                const T &t = hash_.state(id);
+                Hash::data_t *dptr = hash_.data(id);
+                assert(dptr->solved());
 
-                if( n.second->action() != Problem::noop ) {
-                    problem_.next(n.first, n.second->action(), outcomes);
+                if( dptr->action() != Problem::noop ) {
+                    COUNT(NextAlgorithm);
+                    problem_.next(t, dptr->action(), outcomes);
                     unsigned osize = outcomes.size();
                     for( unsigned i = 0; i < osize; ++i ) {
-                        Hash::data_t *dptr = hash_.data_ptr(outcomes[i].first);
-                        if( !dptr->marked() ) {
-                            open.push_back(std::make_pair(outcomes[i].first, dptr));
-                            dptr->mark();
+                        unsigned oid = hash_.intern(outcomes[i].first);
+                        if( !marked[oid] ) {
+                            open.push_back(oid);
+                            marked.set(oid, true);
                         }
                     }
                 } else {
-                    std::pair<Problem::action_t, float> p = hash_.best_q_value(n.first);
-                    problem_.next(n.first, p.first, outcomes);
+                    std::pair<Problem::action_t, float> p = hash_.best_q_value(t);
+                    COUNT(NextAlgorithm);
+                    problem_.next(t, p.first, outcomes);
                     unsigned osize = outcomes.size();
                     for( unsigned i = 0; i < osize; ++i )
                         hash_.solve(outcomes[i].first);
                 }
             }
-
-            // unmark nodes
-            for( list_iterator si = visited.begin(); si != visited.end(); ++si )
-                si->second->unmark();
+            std::reverse(visited.begin(), visited.end());
         }
 
-        void update(pair_list &visited) {
-            for( list_iterator si = visited.begin(); si != visited.end(); ++si ) {
-                std::pair<Problem::action_t, float> p = hash_.best_q_value(si->first);
-                si->second->update(p.second);
+        void update(const std::vector<unsigned> &visited) {
+            for( size_t i = 0, isz = visited.size(); i < isz; ++i ) {
+                std::pair<Problem::action_t, float> p = hash_.best_q_value(hash_.state(visited[i]));
+                hash_.data(visited[i])->update(p.second);
                 hash_.inc_updates();
             }
         }
@@ -182,11 +183,15 @@ template<typename T> class improved_lao_t : public algorithm_t<T> {
     improved_lao_t(const Problem::problem_t<T> &problem) : algorithm_t<T>(problem) { }
     virtual ~improved_lao_t() { }
     virtual algorithm_t<T>* clone() const {
-        return new improved_lao_t(problem_, epsilon_, heuristic_);
+        algorithm_t<T> *algorithm = new improved_lao_t(problem_, epsilon_, heuristic_);
+        algorithm->set_max_memory(algorithm_t<T>::max_memory_);
+        algorithm->set_spill(algorithm_t<T>::spill_);
+        return algorithm;
     }
     virtual std::string name() const {
         return std::string("improved-lao(heuristic=") + (heuristic_ == 0 ? std::string("null") : heuristic_->name()) +
           std::string(",epsilon=") + std::to_string(epsilon_) +
+          this->memory_name() +
           std::string(",seed=") + std::to_string(seed_) + ")";
     }
 
@@ -201,6 +206,7 @@ template<typename T> class improved_lao_t : public algorithm_t<T> {
         }
         it = parameters.find("seed");
         if( it != parameters.end() ) seed_ = strtol(it->second.c_str(), 0, 0);
+        algorithm_t<T>::set_memory_parameters(parameters);
 #ifdef DEBUG
         std::cout << "debug: improved-lao(): params:"
                   << " epsilon=" << epsilon_
@@ -210,39 +216,43 @@ template<typename T> class improved_lao_t : public algorithm_t<T> {
 #endif
     }
 
+    virtual bool supports_checkpoints() const { return true; }
+
     virtual void solve(const T &s, Problem::hash_t<T> &hash) const {
         reset_stats(hash);
         Heuristic::wrapper_t<T> eval_function(heuristic_);
+        size_t iterations = this->resume(hash);
         hash.set_eval_function(&eval_function);
+        this->setup_memory(hash);
 
-        typedef typename std::list<std::pair<T, Hash::data_t*> > pair_list;
-        typedef typename pair_list::const_iterator const_list_iterator;
-        pair_list visited;
+        std::vector<unsigned> visited;
 
         policy_graph_t graph(problem_, hash);
         graph.add_root(s);
         graph.recompute();
 
-        size_t iterations = 0;
-
       loop:
         ++iterations;
+        COUNT(Iterations);
         while( !graph.tips().empty() ) {
             visited.clear();
             graph.postorder_dfs(s, visited);
             graph.update(visited);
+            hash.evict(s);
             graph.recompute();
+            this->checkpoint(hash, iterations);
         }
 
         // convergence test
         float residual = 1.0 + epsilon_;
         while( residual > epsilon_ ) {
             residual = 0.0;
-            for( const_list_iterator si = graph.nodes().begin(); si != graph.nodes().end(); ++si ) {
-                float hv = si->second->value();
-                std::pair<Problem::action_t, float> p = hash.best_q_value(si->first);
+            for( size_t i = 0, isz = graph.nodes().size(); i < isz; ++i ) {
+                Hash::data_t *dptr = hash.data(graph.nodes()[i]);
+                float hv = dptr->value();
+                std::pair<Problem::action_t, float> p = hash.best_q_value(hash.state(graph.nodes()[i]));
                 residual = Utils::max(residual, (float)fabs(p.second - hv));
-                si->second->update(p.second);
+                dptr->update(p.second);
                 hash.inc_updates();
             }
             graph.recompute();
@@ -22,7 +22,6 @@
 #include "algorithm.h"
 
 #include <cassert>
-#include <list>
 #include <string>
 #include <vector>
 
@@ -31,6 +30,7 @@
 namespace Algorithm {
 
 template<typename T> class ldfs_base_t : public algorithm_t<T> {
+  protected:
   using algorithm_t<T>::problem_;
   using algorithm_t<T>::heuristic_;
   using algorithm_t<T>::seed_;
@@ -81,29 +81,25 @@ template<typename T> class ldfs_base_t : public algorithm_t<T> {
 #endif
     }
 
-    bool ldfs(const T &s,
-              Problem::hash_t<T> &hash,
-              Hash::data_t *dptr,
-              size_t &index,
-              std::list<Hash::data_t*> &stack,
-              std::list<Hash::data_t*> &visited) const {
+    bool ldfs(unsigned id, Problem::hash_t<T> &hash, Hash::scc_search_t &search) const {
         std::vector<std::pair<T, float> > outcomes;
+        const T &s = hash.state(id);
+        Hash::data_t *dptr = hash.data(id);
 
         // base cases
         if( dptr->solved() || problem_.terminal(s) ) {
             dptr->solve();
             return true;
-        } else if( dptr->marked() ) {
+        } else if( search.marked_[id] ) {
             return false;
         }
 
         // Tarjan's
-        visited.push_front(dptr);
-        stack.push_front(dptr);
-        size_t idx = index++;
-        dptr->set_scc_low(idx);
-        dptr->set_scc_idx(idx);
-        //dptr->mark();
+        search.visited_.push_back(id);
+        search.stack_.push_back(id);
+        unsigned idx = search.index_++;
+        search.low_.set(id, idx);
+        search.idx_.set(id, idx);
 
         if( type_ == 1 ) {
             std::pair<Problem::action_t, float> p = hash.best_q_value(s);
@@ -116,6 +112,7 @@ template<typename T> class ldfs_base_t : public algorithm_t<T> {
         float bqv = std::numeric_limits<float>::max();
         for( Problem::action_t a = 0; a < problem_.number_actions(s); ++a ) {
             if( problem_.applicable(s, a) ) {
+                COUNT(NextAlgorithm);
                 problem_.next(s, a, outcomes);
                 unsigned osize = outcomes.size();
 
@@ -125,46 +122,46 @@ template<typename T> class ldfs_base_t : public algorithm_t<T> {
                 qv = problem_.cost(s, a) + problem_.discount() * qv;
                 bqv = Utils::min(bqv, qv);
                 if( fabs(qv - dptr->value()) > epsilon_ ) continue;
-                dptr->mark();
+                search.marked_.set(id, true);
                 flag = true;
                 for( unsigned i = 0; i < osize; ++i ) {
-                    Hash::data_t *ptr = hash.data_ptr(outcomes[i].first);
-                    if( ptr->scc_idx() == std::numeric_limits<unsigned>::max() ) {
-                        bool rv = ldfs(outcomes[i].first, hash, ptr, index, stack, visited);
+                    unsigned oid = hash.intern(outcomes[i].first);
+                    if( search.idx_[oid] == Hash::scc_search_t::no_index ) {
+                        bool rv = ldfs(oid, hash, search);
                         flag = flag && rv;
-                        dptr->set_scc_low(Utils::min(dptr->scc_low(), ptr->scc_low()));
-                    } else if( ptr->marked() ) {
-                        dptr->set_scc_low(Utils::min(dptr->scc_low(), ptr->scc_idx()));
+                        search.low_.set(id, Utils::min(search.low_[id], search.low_[oid]));
+                    } else if( search.marked_[oid] ) {
+                        search.low_.set(id, Utils::min(search.low_[id], search.idx_[oid]));
                     }
                 }
                 if( (type_ == 1) && flag && (hash.q_value(s, a) - dptr->value() > epsilon_) ) flag = false;
                 if( flag ) break;
-                while( stack.front()->scc_idx() > idx ) {
-                    stack.front()->set_scc_low(std::numeric_limits<unsigned>::max());
-                    stack.front()->set_scc_idx(std::numeric_limits<unsigned>::max());
-                    stack.pop_front();
+                while( search.idx_[search.stack_.back()] > idx ) {
+                    search.low_.reset(search.stack_.back());
+                    search.idx_.reset(search.stack_.back());
+                    search.stack_.pop_back();
                 }
             }
         }
 
         // update
         if( !flag ) {
-            if( !dptr->marked() ) {
+            if( !search.marked_[id] ) {
                 dptr->update(bqv);
             } else {
                 std::pair<Problem::action_t, float> p = hash.best_q_value(s);
                 dptr->update(p.second);
             }
             hash.inc_updates();
-            dptr->set_scc_low(std::numeric_limits<unsigned>::max());
-            dptr->set_scc_idx(std::numeric_limits<unsigned>::max());
-            stack.pop_front();
-        } else if( dptr->scc_low() == dptr->scc_idx() ) {
-            while( !stack.empty() && (stack.front()->scc_idx() >= idx) ) {
-                stack.front()->solve();
-                stack.front()->set_scc_low(std::numeric_limits<unsigned>::max());
-                stack.front()->set_scc_idx(std::numeric_limits<unsigned>::max());
-                stack.pop_front();
+            search.low_.reset(id);
+            search.idx_.reset(id);
+            search.stack_.pop_back();
+        } else if( search.low_[id] == search.idx_[id] ) {
+            while( !search.stack_.empty() && (search.idx_[search.stack_.back()] >= idx) ) {
+                hash.data(search.stack_.back())->solve();
+                search.low_.reset(search.stack_.back());
+                search.idx_.reset(search.stack_.back());
+                search.stack_.pop_back();
             }
         }
         return flag;
@@ -198,18 +195,15 @@ template<typename T> class ldfs_t : public ldfs_base_t<T> {
         Heuristic::wrapper_t<T> eval_function(heuristic_);
         hash.set_eval_function(&eval_function);
 
-        std::list<Hash::data_t*> stack, visited;
+        Hash::scc_search_t search;
         size_t trials = 0;
         Hash::data_t *dptr = hash.data_ptr(s);
         while( !dptr->solved() ) {
-            size_t index = 0;
-            ldfs_base_t<T>::ldfs(s, hash, dptr, index, stack, visited);
-            assert(stack.empty());
-            while( !visited.empty() ) {
-                visited.front()->unmark();
-                visited.pop_front();
-            }
+            ldfs_base_t<T>::ldfs(hash.intern(s), hash, search);
+            assert(search.stack_.empty());
+            search.reset();
             ++trials;
+            COUNT(Iterations);
         }
         hash.set_eval_function(0);
     }
@@ -248,18 +242,15 @@ template<typename T> class ldfs_plus_t : public ldfs_base_t<T> {
         Heuristic::wrapper_t<T> eval_function(heuristic_);
         hash.set_eval_function(&eval_function);
 
-        std::list<Hash::data_t*> stack, visited;
+        Hash::scc_search_t search;
         size_t trials = 0;
         Hash::data_t *dptr = hash.data_ptr(s);
         while( !dptr->solved() ) {
-            size_t index = 0;
-            ldfs_base_t<T>::ldfs(s, hash, dptr, index, stack, visited);
-            assert(stack.empty());
-            while( !visited.empty() ) {
-                visited.front()->unmark();
-                visited.pop_front();
-            }
+            ldfs_base_t<T>::ldfs(hash.intern(s), hash, search);
+            assert(search.stack_.empty());
+            search.reset();
             ++trials;
+            COUNT(Iterations);
         }
         hash.set_eval_function(0);
     }
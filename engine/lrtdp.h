@@ -22,8 +22,8 @@
 #include "algorithm.h"
 #include "plain_check.h"
 
-#include <list>
 #include <string>
+#include <vector>
 
 //#define DEBUG
 
@@ -68,9 +68,12 @@ template<typename T> class lrtdp_base_t : public algorithm_t<T> {
           std::string(",type=") + (type_ == 0 ? "standard" : (type_ == 1 ? "uniform" : "bounded")) +
           std::string(",bound=") + std::to_string(bound_) +
           std::string(",epsilon-greedy=") + std::to_string(epsilon_greedy_) +
+          this->memory_name() +
           std::string(",seed=") + std::to_string(seed_) + ")";
     }
 
+    virtual bool supports_checkpoints() const { return true; }
+
     virtual void set_parameters(const std::multimap<std::string, std::string> &parameters, Dispatcher::dispatcher_t<T> &dispatcher) {
         std::multimap<std::string, std::string>::const_iterator it = parameters.find("epsilon");
         if( it != parameters.end() ) epsilon_ = strtof(it->second.c_str(), 0);
@@ -86,6 +89,7 @@ template<typename T> class lrtdp_base_t : public algorithm_t<T> {
         }
         it = parameters.find("seed");
         if( it != parameters.end() ) seed_ = strtol(it->second.c_str(), 0, 0);
+        algorithm_t<T>::set_memory_parameters(parameters);
 #ifdef DEBUG
         std::cout << "debug: lrtdp-base(): params:"
                   << " epsilon=" << epsilon_
@@ -98,45 +102,49 @@ template<typename T> class lrtdp_base_t : public algorithm_t<T> {
     }
 
     size_t lrtdp_trial(const T &s, Problem::hash_t<T> &hash) const {
-        std::list<T> states;
+        Perf::phase_t phase("trial");
+        Trace::scope_t scope("trial");
+        std::vector<unsigned> states;
         std::pair<T, bool> n;
 
-        Hash::data_t *dptr = hash.data_ptr(s);
-        states.push_back(s);
+        unsigned id = hash.intern(s);
+        Hash::data_t *dptr = hash.data(id);
+        states.push_back(id);
         dptr->inc_count();
-        T t = s;
+        const T *t = &hash.state(id);
 
 #ifdef DEBUG
         std::cout << "debug: lrtdp-base(): trial: begin" << std::endl;
 #endif
 
         size_t steps = 1;
-        while( !problem_.terminal(t) && !dptr->solved() && (dptr->count() <= bound_) ) {
+        while( !problem_.terminal(*t) && !dptr->solved() && (dptr->count() <= bound_) ) {
 
 #ifdef DEBUG
-            std::cout << "debug: lrtdp-base():   " << t << " = " << dptr->value() << std::endl;
+            std::cout << "debug: lrtdp-base():   " << *t << " = " << dptr->value() << std::endl;
 #endif
 
-            std::pair<Problem::action_t, float> p = hash.best_q_value(t);
+            std::pair<Problem::action_t, float> p = hash.best_q_value(*t);
             dptr->update(p.second);
             hash.inc_updates();
 
             if( Random::real() < epsilon_greedy_ ) {
-                n = problem_.usample(t, p.first);
+                n = problem_.usample(*t, p.first);
             } else {
                 if( type_ == 0 ) {
-                    n = problem_.sample(t, p.first);
+                    n = problem_.sample(*t, p.first);
                 } else if( type_ == 1 ) {
-                    n = problem_.usample(t, p.first);
+                    n = problem_.usample(*t, p.first);
                 } else if( type_ == 2 ) {
-                    n = problem_.nsample(t, p.first, hash);
+                    n = problem_.nsample(*t, p.first, hash);
                 }
             }
             if( !n.second ) break;
 
-            t = n.first;
-            dptr = hash.data_ptr(t);
-            states.push_back(t);
+            id = hash.intern(n.first);
+            t = &hash.state(id);
+            dptr = hash.data(id);
+            states.push_back(id);
             dptr->inc_count();
             ++steps;
         }
@@ -144,16 +152,18 @@ template<typename T> class lrtdp_base_t : public algorithm_t<T> {
 #ifdef DEBUG
         std::cout << "debug: lrtdp-base(): trial: end" << std::endl;
 #endif
+        COUNT(Trials);
+        COUNT_ADD(TrialSteps, steps);
 
         while( !states.empty() ) {
-            hash.clear_count(states.back());
-            bool solved = check_solved(problem_, states.back(), hash, epsilon_);
+            hash.data(states.back())->clear_count();
+            bool solved = check_solved(problem_, hash.state(states.back()), hash, epsilon_);
             states.pop_back();
             if( !solved ) break;
         }
 
         while( !states.empty() ) {
-            hash.clear_count(states.back());
+            hash.data(states.back())->clear_count();
             states.pop_back();
         }
         return steps;
@@ -161,13 +171,16 @@ template<typename T> class lrtdp_base_t : public algorithm_t<T> {
 
     size_t lrtdp(const T &s, Problem::hash_t<T> &hash) const {
         Heuristic::wrapper_t<T> eval_function(heuristic_);
+        size_t trials = this->resume(hash), max_steps = 0;
         hash.set_eval_function(&eval_function);
+        this->setup_memory(hash);
 
-        size_t trials = 0, max_steps = 0;
         while( !hash.solved(s) ) {
             size_t steps = lrtdp_trial(s, hash);
             max_steps = Utils::max(max_steps, steps);
             ++trials;
+            hash.evict(s);
+            this->checkpoint(hash, trials);
         }
 
         hash.set_eval_function(0);
@@ -192,7 +205,10 @@ template<typename T> class standard_lrtdp_t : public lrtdp_base_t<T> {
     standard_lrtdp_t(const Problem::problem_t<T> &problem) : lrtdp_base_t<T>(problem, 0) { }
     virtual ~standard_lrtdp_t() { }
     virtual algorithm_t<T>* clone() const {
-        return new standard_lrtdp_t(algorithm_t<T>::problem_, lrtdp_base_t<T>::epsilon_, lrtdp_base_t<T>::bound_, lrtdp_base_t<T>::epsilon_greedy_, algorithm_t<T>::heuristic_);
+        algorithm_t<T> *algorithm = new standard_lrtdp_t(algorithm_t<T>::problem_, lrtdp_base_t<T>::epsilon_, lrtdp_base_t<T>::bound_, lrtdp_base_t<T>::epsilon_greedy_, algorithm_t<T>::heuristic_);
+        algorithm->set_max_memory(algorithm_t<T>::max_memory_);
+        algorithm->set_spill(algorithm_t<T>::spill_);
+        return algorithm;
     }
 
     virtual void set_parameters(const std::multimap<std::string, std::string> &parameters, Dispatcher::dispatcher_t<T> &dispatcher) {
@@ -228,7 +244,10 @@ template<typename T> class uniform_lrtdp_t : public lrtdp_base_t<T> {
     uniform_lrtdp_t(const Problem::problem_t<T> &problem) : lrtdp_base_t<T>(problem, 1) { }
     virtual ~uniform_lrtdp_t() { }
     virtual algorithm_t<T>* clone() const {
-        return new uniform_lrtdp_t(algorithm_t<T>::problem_, lrtdp_base_t<T>::epsilon_, lrtdp_base_t<T>::bound_, lrtdp_base_t<T>::epsilon_greedy_, algorithm_t<T>::heuristic_);
+        algorithm_t<T> *algorithm = new uniform_lrtdp_t(algorithm_t<T>::problem_, lrtdp_base_t<T>::epsilon_, lrtdp_base_t<T>::bound_, lrtdp_base_t<T>::epsilon_greedy_, algorithm_t<T>::heuristic_);
+        algorithm->set_max_memory(algorithm_t<T>::max_memory_);
+        algorithm->set_spill(algorithm_t<T>::spill_);
+        return algorithm;
     }
 
     virtual void set_parameters(const std::multimap<std::string, std::string> &parameters, Dispatcher::dispatcher_t<T> &dispatcher) {
@@ -264,7 +283,10 @@ template<typename T> class bounded_lrtdp_t : public lrtdp_base_t<T> {
     bounded_lrtdp_t(const Problem::problem_t<T> &problem) : lrtdp_base_t<T>(problem, 2) { }
     virtual ~bounded_lrtdp_t() { }
     virtual algorithm_t<T>* clone() const {
-        return new bounded_lrtdp_t(algorithm_t<T>::problem_, lrtdp_base_t<T>::epsilon_, lrtdp_base_t<T>::bound_, lrtdp_base_t<T>::epsilon_greedy_, algorithm_t<T>::heuristic_);
+        algorithm_t<T> *algorithm = new bounded_lrtdp_t(algorithm_t<T>::problem_, lrtdp_base_t<T>::epsilon_, lrtdp_base_t<T>::bound_, lrtdp_base_t<T>::epsilon_greedy_, algorithm_t<T>::heuristic_);
+        algorithm->set_max_memory(algorithm_t<T>::max_memory_);
+        algorithm->set_spill(algorithm_t<T>::spill_);
+        return algorithm;
     }
 
     virtual void set_parameters(const std::multimap<std::string, std::string> &parameters, Dispatcher::dispatcher_t<T> &dispatcher) {
@@ -51,7 +51,7 @@ template<typename T> struct node_t : public std::pair<T, unsigned> {
 
 template<typename T> struct map_functions_t {
     size_t operator()(const node_t<T> &node) const {
-        return node.state().hash();
+        return Hash::combine(node.state().hash(), node.depth());
     }
 };
 
@@ -120,6 +120,7 @@ template<typename T> class finite_horizon_lrtdp_t : public policy_t<T> {
     bool labeling_;
     bool random_ties_;
     mutable hash_table_t<T> table_;
+    mutable Hash::bucket_stats_t table_stats_;
     mutable unsigned total_number_expansions_;
 
     finite_horizon_lrtdp_t(const Problem::problem_t<T> &problem,
@@ -179,6 +180,7 @@ template<typename T> class finite_horizon_lrtdp_t : public policy_t<T> {
         policy_t<T>::base_policy_time_ = 0;
         policy_t<T>::heuristic_time_ = 0;
         problem_.clear_expansions();
+        table_stats_.clear();
         if( heuristic_ != 0 ) heuristic_->reset_stats();
     }
 
@@ -188,6 +190,12 @@ template<typename T> class finite_horizon_lrtdp_t : public policy_t<T> {
            << " decisions=" << policy_t<T>::decisions_
            << " #expansions=" << total_number_expansions_
            << std::endl;
+        if( Hash::stats_enabled() ) table_stats_.with(table_).print(os, 2 + indent, "finite-horizon-lrtdp");
+    }
+    virtual void record_other_stats(Stats::record_t &record, const std::string &prefix) const {
+        policy_t<T>::record_other_stats(record, prefix);
+        record.add(prefix + "#expansions", total_number_expansions_);
+        if( Hash::stats_enabled() ) table_stats_.with(table_).record(record, prefix + "hash.");
     }
     virtual void set_parameters(const std::multimap<std::string, std::string> &parameters, Dispatcher::dispatcher_t<T> &dispatcher) {
         std::multimap<std::string, std::string>::const_iterator it = parameters.find("horizon");
@@ -220,6 +228,7 @@ template<typename T> class finite_horizon_lrtdp_t : public policy_t<T> {
     virtual typename policy_t<T>::usage_t uses_algorithm() const { return policy_t<T>::usage_t::No; }
 
     void clear_table() const {
+        if( Hash::stats_enabled() ) table_stats_.add(table_);
         for( typename hash_table_t<T>::const_iterator it = table_.begin(); it != table_.end(); ++it ) {
             delete it->second;
         }
@@ -254,6 +263,7 @@ template<typename T> class finite_horizon_lrtdp_t : public policy_t<T> {
         float qvalue = 0;
         bool all_children_labeled = true;
         std::vector<std::pair<T, float> > outcomes;
+        COUNT(NextPolicy);
         problem_.next(node.state(), a, outcomes);
         for( int i = 0, isz = outcomes.size(); i < isz; ++i ) {
             const T &state = outcomes[i].first;
@@ -355,6 +365,7 @@ template<typename T> class finite_horizon_lrtdp_t : public policy_t<T> {
     }
 
     void lrtdp_trial(const node_t<T> &root, data_t *root_dptr) const {
+        Trace::scope_t scope("trial");
         // set up queue of visited nodes (for labeling)
         std::vector<std::pair<T, data_t*> > visited;
         if( labeling_ ) {
@@ -384,7 +395,9 @@ template<typename T> class finite_horizon_lrtdp_t : public policy_t<T> {
             node_is_dead_end = dead_end(node);
             dptr = table_.get_data_ptr(node);
             if( labeling_ ) visited.push_back(std::make_pair(node.state(), dptr));
+            COUNT(TrialSteps);
         }
+        COUNT(Trials);
 
 #ifdef DEBUG
         std::cout << "lrtdp_trial: end state=" << node.state()
@@ -0,0 +1,129 @@
+/*
+ *  Copyright (c) 2011-2016 Universidad Simon Bolivar
+ *
+ *  Permission is hereby granted to distribute this software for
+ *  non-commercial research purposes, provided that this copyright
+ *  notice is included with any such distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ *  EITHER EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE.  THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE
+ *  SOFTWARE IS WITH YOU.  SHOULD THE PROGRAM PROVE DEFECTIVE, YOU
+ *  ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ *
+ *  Blai Bonet, bonet@ldc.usb.ve
+ *
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//#define DEBUG
+
+namespace Parallel {
+
+// Fixed-size pool of worker threads that executes batches of independent
+// jobs. The calling thread takes part in each batch as worker 0, so a
+// pool with one thread runs the jobs sequentially without synchronization.
+// Jobs that draw random numbers should set their own stream with
+// Random::scoped_stream_t to get results that don't depend on the number
+// of threads.
+class thread_pool_t {
+  public:
+    typedef std::function<void(unsigned job, unsigned worker)> task_t;
+
+  protected:
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+
+    const task_t *task_;
+    unsigned num_jobs_;
+    std::atomic<unsigned> next_job_;
+    unsigned active_workers_;
+    unsigned generation_;
+    bool stop_;
+
+    void work(unsigned worker) {
+        for( unsigned job = next_job_++; job < num_jobs_; job = next_job_++ )
+            (*task_)(job, worker);
+    }
+
+    void loop(unsigned worker) {
+        unsigned generation = 0;
+        for( ;; ) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_cv_.wait(lock, [&] { return stop_ || (generation != generation_); });
+                if( stop_ ) return;
+                generation = generation_;
+            }
+            work(worker);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if( --active_workers_ == 0 ) done_cv_.notify_one();
+            }
+        }
+    }
+
+  public:
+    thread_pool_t(unsigned num_threads)
+      : task_(0), num_jobs_(0), next_job_(0),
+        active_workers_(0), generation_(0), stop_(false) {
+        for( unsigned worker = 1; worker < num_threads; ++worker )
+            workers_.push_back(std::thread(&thread_pool_t::loop, this, worker));
+    }
+    ~thread_pool_t() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        work_cv_.notify_all();
+        for( unsigned i = 0; i < workers_.size(); ++i )
+            workers_[i].join();
+    }
+
+    unsigned num_threads() const { return 1 + workers_.size(); }
+
+    // run task(job, worker) for every job in [0, num_jobs) and return
+    // when all of them have finished
+    void run(unsigned num_jobs, const task_t &task) {
+        if( workers_.empty() ) {
+            for( unsigned job = 0; job < num_jobs; ++job )
+                task(job, 0);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = &task;
+            num_jobs_ = num_jobs;
+            next_job_ = 0;
+            active_workers_ = workers_.size();
+            ++generation_;
+        }
+        work_cv_.notify_all();
+        work(0);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [&] { return active_workers_ == 0; });
+        task_ = 0;
+    }
+};
+
+}; // namespace Parallel
+
+#undef DEBUG
+
+#endif
+
@@ -0,0 +1,237 @@
+/*
+ *  Copyright (c) 2011-2016 Universidad Simon Bolivar
+ *
+ *  Permission is hereby granted to distribute this software for
+ *  non-commercial research purposes, provided that this copyright
+ *  notice is included with any such distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ *  EITHER EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE.  THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE
+ *  SOFTWARE IS WITH YOU.  SHOULD THE PROGRAM PROVE DEFECTIVE, YOU
+ *  ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ *
+ *  Blai Bonet, bonet@ldc.usb.ve
+ *
+ */
+
+#ifndef PERF_H
+#define PERF_H
+
+#include "utils.h"
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//#define DEBUG
+
+// Hardware performance counters read with perf_event_open(2). They are off
+// until enable() is called, and each event that can't be opened (e.g. in
+// containers, or with a restrictive perf_event_paranoid) is reported once
+// and left out of the stats. Counters are opened for the calling thread
+// and inherited by the threads it creates afterwards; counts of those
+// threads are added when they exit.
+
+namespace Perf {
+
+enum event_t {
+    Cycles,
+    Instructions,
+    CacheMisses,
+    BranchMisses,
+    TLBMisses,
+    NumEvents
+};
+
+inline const char* name(event_t event) {
+    static const char *names[] = {
+        "cycles", "instructions", "cache-misses", "branch-misses", "dtlb-misses"
+    };
+    assert(event < NumEvents);
+    return names[event];
+}
+
+// values of the events; values_[e] is meaningless if the event isn't available
+struct sample_t {
+    double values_[NumEvents];
+    sample_t() {
+        for( int i = 0; i < NumEvents; ++i ) values_[i] = 0;
+    }
+    sample_t& operator+=(const sample_t &sample) {
+        for( int i = 0; i < NumEvents; ++i ) values_[i] += sample.values_[i];
+        return *this;
+    }
+    sample_t operator-(const sample_t &sample) const {
+        sample_t result;
+        for( int i = 0; i < NumEvents; ++i ) result.values_[i] = values_[i] - sample.values_[i];
+        return result;
+    }
+};
+
+class counters_t {
+  protected:
+    int fds_[NumEvents];
+    bool enabled_;
+    std::thread::id owner_;
+
+#ifdef __linux__
+    static int open_event(unsigned type, unsigned long long config) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+
+  public:
+    counters_t() : enabled_(false) {
+        for( int i = 0; i < NumEvents; ++i ) fds_[i] = -1;
+    }
+    ~counters_t() {
+#ifdef __linux__
+        for( int i = 0; i < NumEvents; ++i ) {
+            if( fds_[i] != -1 ) close(fds_[i]);
+        }
+#endif
+    }
+
+    bool enabled() const { return enabled_; }
+    bool available(event_t event) const { return fds_[event] != -1; }
+
+    // counts are only meaningful for the thread that opened the counters
+    bool owner() const { return enabled_ && (std::this_thread::get_id() == owner_); }
+
+    // open the counters; returns whether some event is available
+    bool open() {
+        if( enabled_ ) return true;
+#ifdef __linux__
+        const unsigned long long tlb_misses = PERF_COUNT_HW_CACHE_DTLB |
+          (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        const unsigned types[] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE };
+        const unsigned long long configs[] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES, tlb_misses };
+        for( int i = 0; i < NumEvents; ++i ) {
+            fds_[i] = open_event(types[i], configs[i]);
+            if( fds_[i] == -1 ) {
+                std::cout << Utils::warning() << "perf: " << name(event_t(i)) << " unavailable: " << strerror(errno);
+                if( (errno == EACCES) || (errno == EPERM) ) std::cout << " (see /proc/sys/kernel/perf_event_paranoid)";
+                std::cout << std::endl;
+            } else {
+                enabled_ = true;
+            }
+        }
+#else
+        std::cout << Utils::warning() << "perf: hardware counters are only supported on linux" << std::endl;
+#endif
+        owner_ = std::this_thread::get_id();
+        return enabled_;
+    }
+
+    // current values of the events, scaled up when the kernel multiplexes them
+    sample_t read() const {
+        sample_t sample;
+#ifdef __linux__
+        for( int i = 0; i < NumEvents; ++i ) {
+            unsigned long long data[3];
+            if( (fds_[i] != -1) && (::read(fds_[i], data, sizeof(data)) == sizeof(data)) && (data[2] > 0) )
+                sample.values_[i] = double(data[0]) * double(data[1]) / double(data[2]);
+        }
+#endif
+        return sample;
+    }
+};
+
+inline counters_t& counters() {
+    static counters_t counters;
+    return counters;
+}
+
+inline bool enable() {
+    return counters().open();
+}
+
+inline bool enabled() {
+    return counters().enabled();
+}
+
+// Accumulated samples of named phases
+struct phases_t {
+    std::mutex mutex_;
+    std::map<std::string, sample_t> samples_;
+};
+
+inline phases_t& phases() {
+    static phases_t phases;
+    return phases;
+}
+
+inline std::map<std::string, sample_t> phase_samples() {
+    std::lock_guard<std::mutex> lock(phases().mutex_);
+    return phases().samples_;
+}
+
+// Adds the counts between construction and destruction to the named
+// phase. Each phase reads all the counters twice with system calls, so
+// phases should wrap coarse units of work (trials, decisions) rather than
+// single backups. Phases in threads other than the one that enabled the
+// counters are ignored, and so are phases nested in one with the same
+// name (e.g. decisions of base policies in rollouts made by a decision),
+// which would otherwise be counted twice.
+class phase_t {
+  protected:
+    const char *name_;
+    bool active_;
+    sample_t start_;
+
+    static std::vector<const char*>& open_phases() {
+        static std::vector<const char*> open_phases;
+        return open_phases;
+    }
+
+  public:
+    phase_t(const char *name) : name_(name), active_(counters().owner()) {
+        if( active_ ) {
+            std::vector<const char*> &open = open_phases();
+            for( int i = 0, isz = open.size(); active_ && (i < isz); ++i )
+                active_ = strcmp(open[i], name_) != 0;
+        }
+        if( active_ ) {
+            open_phases().push_back(name_);
+            start_ = counters().read();
+        }
+    }
+    ~phase_t() {
+        if( active_ ) {
+            sample_t sample = counters().read() - start_;
+            open_phases().pop_back();
+            std::lock_guard<std::mutex> lock(phases().mutex_);
+            phases().samples_[name_] += sample;
+        }
+    }
+};
+
+}; // namespace Perf
+
+#undef DEBUG
+
+#endif
+
@@ -21,7 +21,6 @@
 
 #include "algorithm.h"
 
-#include <list>
 #include <string>
 #include <vector>
 
@@ -34,35 +33,43 @@ bool check_solved(const Problem::problem_t<T> &problem,
                   const T &s,
                   Problem::hash_t<T> &hash,
                   float epsilon) {
-    std::list<std::pair<T, Hash::data_t*> > open, closed;
+    std::vector<unsigned> open, closed; // interned ids
+    Perf::phase_t phase("check-solved");
+    Trace::scope_t scope("check-solved");
+    COUNT(CheckSolvedCalls);
 
     std::vector<std::pair<T, float> > outcomes;
-    Hash::data_t *dptr = hash.data_ptr(s);
+    unsigned id = hash.intern(s);
+    Hash::data_t *dptr = hash.data(id);
     if( !dptr->solved() ) {
-        open.push_back(std::make_pair(s, dptr));
+        open.push_back(id);
         dptr->mark();
     }
 
     bool rv = true;
     while( !open.empty() ) {
-        std::pair<T, Hash::data_t*> n = open.back();
-        closed.push_back(n);
+        id = open.back();
+        closed.push_back(id);
         open.pop_back();
-        if( problem.terminal(n.first) ) continue;
+        COUNT(CheckSolvedVisited);
+        const T &t = hash.state(id);
+        if( problem.terminal(t) ) continue;
 
-        std::pair<Problem::action_t, float> p = hash.best_q_value(n.first);
-        if( fabs(p.second - n.second->value()) > epsilon ) {
+        std::pair<Problem::action_t, float> p = hash.best_q_value(t);
+        if( fabs(p.second - hash.data(id)->value()) > epsilon ) {
             rv = false;
             continue;
         }
 
-        problem.next(n.first, p.first, outcomes);
+        COUNT(NextAlgorithm);
+        problem.next(t, p.first, outcomes);
         unsigned osize = outcomes.size();
 
         for( unsigned i = 0; i < osize; ++ i ) {
-            Hash::data_t *dptr = hash.data_ptr(outcomes[i].first);
+            unsigned oid = hash.intern(outcomes[i].first);
+            Hash::data_t *dptr = hash.data(oid);
             if( !dptr->solved() && !dptr->marked() ) {
-                open.push_back(std::make_pair(outcomes[i].first, dptr));
+                open.push_back(oid);
                 dptr->mark();
             }
         }
@@ -70,14 +77,14 @@ bool check_solved(const Problem::problem_t<T> &problem,
 
     if( rv ) {
         while( !closed.empty() ) {
-            closed.back().second->solve();
+            hash.data(closed.back())->solve();
             closed.pop_back();
         }
     } else {
         while( !closed.empty() ) {
-            std::pair<Problem::action_t, float> p = hash.best_q_value(closed.back().first);
-            closed.back().second->update(p.second);
-            closed.back().second->unmark();
+            std::pair<Problem::action_t, float> p = hash.best_q_value(hash.state(closed.back()));
+            hash.data(closed.back())->update(p.second);
+            hash.data(closed.back())->unmark();
             hash.inc_updates();
             closed.pop_back();
         }
@@ -20,11 +20,18 @@
 #define POLICY_H
 
 #include "problem.h"
+#include "parallel.h"
+#include "perf.h"
+#include "random.h"
+#include "stats.h"
+#include "trace.h"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <sstream>
 #include <cassert>
 #include <limits>
+#include <mutex>
 #include <vector>
 #include <math.h>
 
@@ -46,6 +53,7 @@ template<typename T> class policy_t {
     mutable float base_policy_time_;
     mutable float heuristic_time_;
     mutable unsigned decisions_;
+    mutable unsigned base_policy_calls_; // for sampled timing of base policies
 
   public:
     policy_t(const Problem::problem_t<T> &problem)
@@ -54,7 +62,8 @@ template<typename T> class policy_t {
         setup_time_(0),
         base_policy_time_(0),
         heuristic_time_(0),
-        decisions_(0) {
+        decisions_(0),
+        base_policy_calls_(0) {
     }
     virtual ~policy_t() { }
     virtual policy_t<T>* clone() const = 0;
@@ -62,6 +71,13 @@ template<typename T> class policy_t {
     virtual Problem::action_t operator()(const T &s) const = 0;
     virtual void reset_stats() const = 0;
     virtual void print_other_stats(std::ostream &os, int indent) const = 0;
+
+    // fields of print_other_stats() for the stats sink, with keys prefixed
+    // by prefix (base policies add theirs with prefix + "base.")
+    virtual void record_other_stats(Stats::record_t &record, const std::string &prefix) const {
+        record.add(prefix + "name", name());
+        record.add(prefix + "decisions", decisions_);
+    }
     virtual void set_parameters(const std::multimap<std::string, std::string> &parameters, Dispatcher::dispatcher_t<T> &dispatcher) = 0;
 
     typedef enum { No, Yes, Optional } usage_t;
@@ -75,22 +91,43 @@ template<typename T> class policy_t {
     float heuristic_time() const { return heuristic_time_; }
     unsigned decisions() const { return decisions_; }
     const Problem::problem_t<T>& problem() const { return problem_; }
+
+    // accumulate stats of a clone of this policy
+    virtual void add_stats(const policy_t<T> &policy) const {
+        base_policy_time_ += policy.base_policy_time_;
+        // heuristic times are read from the heuristics, which clones share
+        heuristic_time_ = std::max(heuristic_time_, policy.heuristic_time_);
+        decisions_ += policy.decisions_;
+    }
 };
 
-// Abstract class for improvement of a base policy
+// Abstract class for improvement of a base policy. Clones own a clone of
+// the base policy so that they can be used concurrently.
 template<typename T> class improvement_t : public policy_t<T> {
   protected:
     const policy_t<T> *base_policy_;
+    bool owns_base_policy_;
 
     improvement_t(const Problem::problem_t<T> &problem, const policy_t<T> *base_policy)
-      : policy_t<T>(problem), base_policy_(base_policy) {
+      : policy_t<T>(problem),
+        base_policy_(base_policy == 0 ? 0 : base_policy->clone()),
+        owns_base_policy_(base_policy != 0) {
     }
 
   public:
     improvement_t(const Problem::problem_t<T> &problem)
-      : policy_t<T>(problem), base_policy_(0) {
+      : policy_t<T>(problem), base_policy_(0), owns_base_policy_(false) {
+    }
+    virtual ~improvement_t() {
+        if( owns_base_policy_ ) delete base_policy_;
+    }
+
+    virtual void add_stats(const policy_t<T> &policy) const {
+        policy_t<T>::add_stats(policy);
+        const improvement_t<T> *clone = dynamic_cast<const improvement_t<T>*>(&policy);
+        if( (base_policy_ != 0) && (clone != 0) && (clone->base_policy_ != 0) && (clone->base_policy_ != base_policy_) )
+            base_policy_->add_stats(*clone->base_policy_);
     }
-    virtual ~improvement_t() { }
 };
 
 }; // namespace Policy
@@ -99,8 +136,14 @@ template<typename T> class improvement_t : public policy_t<T> {
 // Online evaluation
 namespace Evaluation {
 
+// Outcomes of actions are drawn from the scenario if given, from the
+// environment stream if given, or from the stream of the calling thread
 template<typename T>
-inline float evaluation_trial(const Policy::policy_t<T> &policy, const T &s, unsigned max_depth) {
+inline float evaluation_trial(const Policy::policy_t<T> &policy,
+                              const T &s,
+                              unsigned max_depth,
+                              const Problem::scenario_t<T> *scenario,
+                              Random::stream_t *environment) {
     T state = s;
     size_t steps = 0;
     float cost = 0;
@@ -108,14 +151,27 @@ inline float evaluation_trial(const Policy::policy_t<T> &policy, const T &s, uns
     if( policy.problem().dead_end(state) ) return policy.problem().dead_end_value();
     while( (steps < max_depth) && !policy.problem().terminal(state) ) {
         //std::cout << "evaluation_trial: " << state << std::flush;
-        Problem::action_t action = policy(state);
+        Problem::action_t action;
+        {
+            Perf::phase_t phase("decision");
+            Trace::scope_t scope("decision");
+            action = policy(state);
+        }
         //std::cout << ", a=" << action << std::endl;
         if( action == Problem::noop ) {
             //std::cout << "no applicable action" << std::endl;
             return cost + policy.problem().dead_end_value();
         }
         assert(policy.problem().applicable(state, action));
-        std::pair<T, bool> p = policy.problem().sample(state, action);
+        std::pair<T, bool> p;
+        if( scenario != 0 ) {
+            p = scenario->sample(state, action);
+        } else if( environment != 0 ) {
+            Random::scoped_stream_t stream(*environment);
+            p = policy.problem().sample(state, action);
+        } else {
+            p = policy.problem().sample(state, action);
+        }
         cost += discount * policy.problem().cost(state, action);
         discount *= policy.problem().discount();
         state = p.first;
@@ -127,6 +183,26 @@ inline float evaluation_trial(const Policy::policy_t<T> &policy, const T &s, uns
     return cost;
 }
 
+template<typename T>
+inline float evaluation_trial(const Policy::policy_t<T> &policy, const T &s, unsigned max_depth) {
+    return evaluation_trial<T>(policy, s, max_depth, 0, 0);
+}
+
+// Trial whose outcomes are given by the environment stream: by the
+// scenario drawn from it if the problem has scenarios, or else by the
+// numbers drawn from it step by step
+template<typename T>
+inline float evaluation_trial(const Policy::policy_t<T> &policy, const T &s, unsigned max_depth, Random::stream_t &environment) {
+    Problem::scenario_t<T> *scenario = 0;
+    {
+        Random::scoped_stream_t stream(environment);
+        scenario = policy.problem().sample_scenario();
+    }
+    float value = evaluation_trial<T>(policy, s, max_depth, scenario, &environment);
+    delete scenario;
+    return value;
+}
+
 template<typename T>
 inline float evaluation(const Policy::policy_t<T> &policy, const T &s, unsigned number_trials, unsigned max_depth, bool verbose = false) {
     float value = 0;
@@ -139,42 +215,231 @@ inline float evaluation(const Policy::policy_t<T> &policy, const T &s, unsigned
     return value / number_trials;
 }
 
+// Number of evaluation trials. Either a fixed number of trials, or
+// automatic: trials are run until the half-width of the confidence
+// interval for the mean value falls below halfwidth_ (after at least
+// min_trials_ trials), or max_trials_ trials have been run.
+struct trials_t {
+    unsigned number_;
+    bool automatic_;
+    float confidence_;
+    float halfwidth_;
+    unsigned min_trials_;
+    unsigned max_trials_;
+
+    trials_t(unsigned number = 1)
+      : number_(number),
+        automatic_(false),
+        confidence_(0.95),
+        halfwidth_(0),
+        min_trials_(10),
+        max_trials_(1000) {
+    }
+
+    unsigned limit() const {
+        return automatic_ ? max_trials_ : number_;
+    }
+    bool done(const Utils::mean_variance_t &stats) const {
+        if( stats.n() >= limit() ) return true;
+        if( !automatic_ || (stats.n() < min_trials_) ) return false;
+        return Utils::confidence_halfwidth(stats, confidence_) <= halfwidth_;
+    }
+};
+
+// Trials [first_trial, first_trial + number_trials) run in parallel on
+// the threads of the pool. Each trial is run by its own clone of the
+// policy, with the random stream given by the seed of the policy and the
+// index of the trial, so the value of each trial doesn't depend on the
+// number of threads. Clones have their own base policies but share the
+// heuristics of the policy (whose stats are atomic) and the problem, which
+// must support concurrent calls (see problem_t::concurrent()). The time of
+// the trials is added to time.
 template<typename T>
-inline std::pair<float, float>
-  evaluation_with_stdev(const Policy::policy_t<T> &policy,
-                        const T &s,
-                        unsigned number_trials,
-                        unsigned max_depth,
-                        bool verbose = false) {
-    float sum = 0;
-    std::vector<float> values;
-    values.reserve(number_trials);
-    if( verbose ) std::cout << "#trials=" << number_trials << ":";
-    for( unsigned trial = 0; trial < number_trials; ++trial ) {
-        if( verbose ) std::cout << " " << trial << std::flush;
-        values.push_back(evaluation_trial(policy, s, max_depth));
-        sum += values.back();
-        if( verbose ) {
-            std::cout << "(" << std::setprecision(1) << sum/(1+trial) << ")"
-                      << std::flush;
+inline void parallel_evaluation(const Policy::policy_t<T> &policy,
+                                const T &s,
+                                Parallel::thread_pool_t &pool,
+                                unsigned first_trial,
+                                unsigned number_trials,
+                                unsigned max_depth,
+                                std::vector<float> &values,
+                                float &time) {
+    values = std::vector<float>(number_trials, 0);
+    std::mutex mutex;
+    pool.run(number_trials, [&](unsigned job, unsigned worker) {
+        Random::scoped_stream_t stream(Random::seed48(policy.seed(), first_trial + job));
+        Policy::policy_t<T> *clone = policy.clone();
+        double start_time = Utils::read_monotonic_time();
+        values[job] = evaluation_trial(*clone, s, max_depth);
+        float elapsed_time = Utils::read_monotonic_time() - start_time;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            time += elapsed_time;
+            policy.add_stats(*clone);
+        }
+        delete clone;
+    });
+}
+
+// Runs trials until trials.done(stats). With num_threads = 0, the trials
+// are run by the policy in sequence using the random stream of the calling
+// thread. Otherwise, trials run in batches on a pool of num_threads threads
+// (a single batch for a fixed number of trials) and their values are added
+// to stats in order of the trials, so the stopping point doesn't depend on
+// the number of threads either. time is the monotonic time of the trials,
+// summed over threads like the times that policies accumulate.
+template<typename T>
+inline void evaluation(const Policy::policy_t<T> &policy,
+                       const T &s,
+                       const trials_t &trials,
+                       unsigned max_depth,
+                       Utils::mean_variance_t &stats,
+                       float &time,
+                       bool verbose = false,
+                       unsigned num_threads = 0) {
+    stats.clear();
+    time = 0;
+    if( verbose ) {
+        if( trials.automatic_ )
+            std::cout << "#trials=auto(ci=" << trials.confidence_ << ",halfwidth=" << trials.halfwidth_ << ",max=" << trials.max_trials_ << ")";
+        else
+            std::cout << "#trials=" << trials.number_;
+        if( num_threads > 0 ) std::cout << ",#threads=" << num_threads;
+        std::cout << ":";
+    }
+
+    if( num_threads > 0 ) {
+        Parallel::thread_pool_t pool(num_threads);
+        std::vector<float> values;
+        while( !trials.done(stats) ) {
+            unsigned first_trial = stats.n();
+            unsigned batch = trials.automatic_ ? std::max(num_threads, trials.min_trials_ - std::min(trials.min_trials_, first_trial)) : trials.number_;
+            batch = std::min(batch, trials.limit() - first_trial);
+            parallel_evaluation(policy, s, pool, first_trial, batch, max_depth, values, time);
+            for( unsigned i = 0; (i < batch) && !trials.done(stats); ++i ) {
+                stats.add(values[i]);
+                if( verbose ) std::cout << " " << first_trial + i << "(" << std::setprecision(1) << stats.mean() << ")" << std::flush;
+            }
+        }
+    } else {
+        while( !trials.done(stats) ) {
+            if( verbose ) std::cout << " " << stats.n() << std::flush;
+            double start_time = Utils::read_monotonic_time();
+            stats.add(evaluation_trial(policy, s, max_depth));
+            time += Utils::read_monotonic_time() - start_time;
+            if( verbose ) std::cout << "(" << std::setprecision(1) << stats.mean() << ")" << std::flush;
         }
     }
     if( verbose ) std::cout << std::endl;
+}
 
-    // compute average
-    float avg = 0;
-    for( unsigned i = 0; i < number_trials; ++i ) {
-        avg += values[i];
+// Paired evaluation of policies with common random numbers: in each
+// trial, all policies face the same outcomes, given by an environment
+// stream that depends only on the seed and the index of the trial, while
+// each policy draws its own numbers from the stream of its seed and the
+// trial. Values of the policies, and their differences for each pair
+// (i,j) with i < j in lexicographic order, are added to the stats in order
+// of the trials. Trials run as in evaluation(); automatic trials stop when
+// all the differences (or the value, for a single policy) are done.
+template<typename T>
+inline void paired_evaluation(const std::vector<const Policy::policy_t<T>*> &policies,
+                              const T &s,
+                              unsigned seed,
+                              const trials_t &trials,
+                              unsigned max_depth,
+                              std::vector<Utils::mean_variance_t> &values,
+                              std::vector<Utils::mean_variance_t> &differences,
+                              std::vector<float> &times,
+                              bool verbose = false,
+                              unsigned num_threads = 0) {
+    unsigned num_policies = policies.size();
+    values = std::vector<Utils::mean_variance_t>(num_policies);
+    differences = std::vector<Utils::mean_variance_t>(num_policies * (num_policies - 1) / 2);
+    times = std::vector<float>(num_policies, 0);
+    const std::vector<Utils::mean_variance_t> &targets = differences.empty() ? values : differences;
+    if( verbose ) {
+        std::cout << "#policies=" << num_policies << ",";
+        if( trials.automatic_ )
+            std::cout << "#trials=auto(ci=" << trials.confidence_ << ",halfwidth=" << trials.halfwidth_ << ",max=" << trials.max_trials_ << ")";
+        else
+            std::cout << "#trials=" << trials.number_;
+        if( num_threads > 0 ) std::cout << ",#threads=" << num_threads;
+        std::cout << ":";
     }
-    avg /= number_trials;
 
-    // compute stdev
-    float stdev = 0;
-    for( unsigned i = 0; i < number_trials; ++i ) {
-        stdev += (avg - values[i]) * (avg - values[i]);
+    // environment streams take the indices above those of the policy streams
+    const unsigned environment_index = 1U << 31;
+
+    Parallel::thread_pool_t pool(num_threads == 0 ? 1 : num_threads);
+    std::vector<float> trial_values;
+    std::mutex mutex;
+    unsigned n = 0;
+    for( ;; ) {
+        bool done = num_policies == 0;
+        for( unsigned k = 0; !done && (k < targets.size()); ++k )
+            done = trials.done(targets[k]);
+        if( done ) break;
+
+        unsigned batch = trials.automatic_ ? std::max(pool.num_threads(), trials.min_trials_ - std::min(trials.min_trials_, n)) : trials.number_;
+        batch = std::min(batch, trials.limit() - n);
+        trial_values = std::vector<float>(batch * num_policies, 0);
+        pool.run(batch, [&](unsigned job, unsigned worker) {
+            unsigned trial = n + job;
+            for( unsigned i = 0; i < num_policies; ++i ) {
+                const Policy::policy_t<T> &policy = *policies[i];
+                Random::stream_t environment(Random::seed48(seed, environment_index + trial));
+                Random::scoped_stream_t stream(Random::seed48(policy.seed(), trial));
+                Policy::policy_t<T> *clone = num_threads == 0 ? 0 : policy.clone();
+                double start_time = Utils::read_monotonic_time();
+                trial_values[job * num_policies + i] = evaluation_trial(clone == 0 ? policy : *clone, s, max_depth, environment);
+                float elapsed_time = Utils::read_monotonic_time() - start_time;
+
+                std::lock_guard<std::mutex> lock(mutex);
+                times[i] += elapsed_time;
+                if( clone != 0 ) {
+                    policy.add_stats(*clone);
+                    delete clone;
+                }
+            }
+        });
+
+        for( unsigned job = 0; job < batch; ++job, ++n ) {
+            const float *v = &trial_values[job * num_policies];
+            for( unsigned i = 0, k = 0; i < num_policies; ++i ) {
+                values[i].add(v[i]);
+                for( unsigned j = i + 1; j < num_policies; ++j, ++k )
+                    differences[k].add(v[i] - v[j]);
+            }
+            if( verbose ) {
+                std::cout << " " << n << "(" << std::setprecision(1);
+                for( unsigned i = 0; i < num_policies; ++i )
+                    std::cout << (i > 0 ? "," : "") << values[i].mean();
+                std::cout << ")" << std::flush;
+            }
+
+            // stop at the first trial that satisfies the stopping rule
+            bool done = true;
+            for( unsigned k = 0; done && (k < targets.size()); ++k )
+                done = trials.done(targets[k]);
+            if( done ) {
+                ++n;
+                break;
+            }
+        }
     }
-    stdev = sqrt(stdev) / (number_trials - 1);
-    return std::make_pair(avg, stdev);
+    if( verbose ) std::cout << std::endl;
+}
+
+template<typename T>
+inline std::pair<float, float>
+  evaluation_with_stdev(const Policy::policy_t<T> &policy,
+                        const T &s,
+                        unsigned number_trials,
+                        unsigned max_depth,
+                        bool verbose = false,
+                        unsigned num_threads = 0) {
+    Utils::mean_variance_t stats;
+    evaluation(policy, s, trials_t(number_trials), max_depth, stats, verbose, num_threads);
+    return std::make_pair(stats.mean(), stats.stdev());
 }
 
 }; // namespace Evaluation
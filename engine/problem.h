@@ -19,10 +19,13 @@
 #ifndef PROBLEM_H
 #define PROBLEM_H
 
+#include "counters.h"
 #include "hash.h"
 #include "random.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <cassert>
 #include <limits>
@@ -41,6 +44,7 @@ namespace Problem {
 #endif
 
 template<typename T> class problem_t;
+template<typename T, typename P> struct kernel_t;
 
 // The hash class implements a hash table that stores information related
 // to the states of the problem which is used by different algorithms.
@@ -50,39 +54,67 @@ template<typename T> class hash_t : public Hash::hash_map_t<T> {
   public:
     typedef Hash::hash_map_t<T> base_type;
 
+    // largest number of states of a problem indexed directly
+    static const size_t max_direct_states = size_t(1) << 22;
+
   protected:
+    struct index_function_t : public base_type::index_function_t {
+        const problem_t<T> &problem_;
+        index_function_t(const problem_t<T> &problem) : problem_(problem) { }
+        virtual size_t operator()(const T &s) const { return problem_.state_index(s); }
+    };
+
     const problem_t<T> &problem_;
+    bool min_;                           // backups take the min over outcomes
     unsigned updates_;
+    size_t max_memory_;
+    size_t evictions_;
+    bool warned_;
+    bool thrashing_warned_;
+    index_function_t index_function_;
 
   public:
     hash_t(const problem_t<T> &problem, typename base_type::eval_function_t *heuristic = 0)
       : Hash::hash_map_t<T>(heuristic),
-        problem_(problem), updates_(0) {
+        problem_(problem), min_(false), updates_(0), max_memory_(0), evictions_(0), warned_(false), thrashing_warned_(false),
+        index_function_(problem) {
+        size_t num_states = problem_.num_states();
+        if( (num_states > 0) && (num_states <= max_direct_states) )
+            this->set_index_function(&index_function_, num_states);
     }
     virtual ~hash_t() { }
 
+    // Memory budget of the table in bytes (0 for none), enforced by evict().
+    // The direct index is dropped under a budget as it's sized for all states.
+    size_t max_memory() const { return max_memory_; }
+    void set_max_memory(size_t max_memory) {
+        max_memory_ = max_memory;
+        this->set_epoch(max_memory_ == 0 ? 0 : 1);
+        if( (max_memory_ != 0) && this->direct() ) this->set_index_function(0, 0);
+    }
+    size_t evictions() const { return evictions_; }
+    void evict(const T &root);
+
     const problem_t<T>& problem() const { return problem_; }
     unsigned updates() const { return updates_; }
-    void inc_updates() { ++updates_; }
+    void set_updates(unsigned updates) { updates_ = updates; }
+    void inc_updates() {
+        COUNT(Backups);
+        ++updates_;
+    }
     void update(const T &s, float value) {
+        COUNT(Backups);
         ++updates_;
         Hash::hash_map_t<T>::update(s, value);
     }
 
-    virtual float q_value(const T &s, action_t a) const;
+    // backups are done by the problem so that statically dispatched
+    // problems run them without virtual calls (see static_problem_t)
+    virtual float q_value(const T &s, action_t a) const {
+        return problem_.q_value(*this, s, a, min_);
+    }
     std::pair<action_t, float> best_q_value(const T &s) const {
-        action_t best_action = noop;
-        float best_value = std::numeric_limits<float>::max();
-        for( action_t a = 0; a < problem_.number_actions(s); ++a ) {
-            if( problem_.applicable(s, a) ) {
-                float value = q_value(s, a);
-                if( value < best_value ) {
-                    best_value = value;
-                    best_action = a;
-                }
-            }
-        }
-        return std::make_pair(best_action, best_value);
+        return problem_.best_q_value(*this, s, min_);
     }
 };
 
@@ -93,9 +125,21 @@ template<typename T> class min_hash_t : public hash_t<T> {
     min_hash_t(const problem_t<T> &problem,
                typename hash_base_type::eval_function_t *heuristic = 0)
       : hash_t<T>(problem, heuristic) {
+        hash_t<T>::min_ = true;
     }
     virtual ~min_hash_t() { }
-    virtual float q_value(const T &s, action_t a) const;
+};
+
+
+// A scenario is a realization of the randomness of a problem for a whole
+// trial (e.g. the weather in CTP) that fixes the outcome of each action.
+// Policies evaluated on the same scenario face identical outcomes (common
+// random numbers).
+template<typename T> class scenario_t {
+  public:
+    scenario_t() { }
+    virtual ~scenario_t() { }
+    virtual std::pair<T, bool> sample(const T &s, action_t a) const = 0;
 };
 
 
@@ -107,7 +151,7 @@ template<typename T> class problem_t {
   protected:
     float discount_;
     float dead_end_value_;
-    mutable size_t expansions_;
+    mutable std::atomic<size_t> expansions_; // next() may be called from worker threads
 
   public:
     problem_t(float discount = 1.0, float dead_end_value = 1e3)
@@ -136,6 +180,48 @@ template<typename T> class problem_t {
     virtual int max_state_branching() const = 0;
     virtual void next(const T &s, action_t a, std::vector<std::pair<T, float> > &outcomes) const = 0;
 
+    // scenario drawn from the current random stream, or 0 if outcomes
+    // are to be sampled step by step from a stream common to the trial.
+    // Deleted by the caller.
+    virtual scenario_t<T>* sample_scenario() const { return 0; }
+
+    // whether next() (and thus sample()) may be called by several threads
+    // at once, as required by policies and evaluations with threads
+    virtual bool concurrent() const { return true; }
+
+    // serialization of states for value files: a serialized state has
+    // state_size() bytes (0 if the problem doesn't support serialization),
+    // and equal states must serialize to the same bytes
+    virtual size_t state_size() const { return 0; }
+    virtual void serialize(const T &s, char *bytes) const { }
+    virtual bool deserialize(const char *bytes, T &s) const { return false; }
+
+    // enumerable problems map their states one-to-one into [0,num_states())
+    // with state_index(), and the hash table then indexes an array with it
+    // instead of hashing; num_states() is 0 for problems that don't
+    virtual size_t num_states() const { return 0; }
+    virtual size_t state_index(const T &s) const { return 0; }
+
+    // Inner loops of the algorithms, written once in kernel_t against the
+    // type of the problem. Here they go through the virtual methods above;
+    // static_problem_t instantiates them with the final type of the domain.
+    // q_value() is the expected value of the action over the values in the
+    // hash (the min over outcomes if min is true) and best_q_value() the
+    // best action and its q-value; lookahead() fills the outcomes of the
+    // action and returns its cost.
+    virtual float q_value(const hash_t<T> &hash, const T &s, action_t a, bool min) const {
+        return kernel_t<T, problem_t<T> >::q_value(*this, hash, s, a, min);
+    }
+    virtual std::pair<action_t, float> best_q_value(const hash_t<T> &hash, const T &s, bool min) const {
+        return kernel_t<T, problem_t<T> >::best_q_value(*this, hash, s, min);
+    }
+    virtual void applicable_actions(const T &s, std::vector<action_t> &actions) const {
+        kernel_t<T, problem_t<T> >::applicable_actions(*this, s, actions);
+    }
+    virtual float lookahead(const T &s, action_t a, std::vector<std::pair<T, float> > &outcomes) const {
+        return kernel_t<T, problem_t<T> >::lookahead(*this, s, a, outcomes);
+    }
+
     int max_combined_branching() const {
         return max_action_branching() * max_state_branching();
     }
@@ -143,6 +229,7 @@ template<typename T> class problem_t {
     // sample next state given action using problem's dynamics
     std::pair<T, bool> sample(const T &s, action_t a) const {
         std::vector<std::pair<T, float> > outcomes;
+        COUNT(NextSample);
         next(s, a, outcomes);
         unsigned osize = outcomes.size();
         assert(osize > 0);
@@ -160,6 +247,7 @@ template<typename T> class problem_t {
     // sample next state given action uniformly among all possible next states
     std::pair<T, bool> usample(const T &s, action_t a) const {
         std::vector<std::pair<T, float> > outcomes;
+        COUNT(NextSample);
         next(s, a, outcomes);
         unsigned osize = outcomes.size();
         return std::make_pair(outcomes[Random::random(osize)].first, true);
@@ -168,6 +256,7 @@ template<typename T> class problem_t {
     // sample next (unlabeled) state given action; probabilities are re-weighted
     std::pair<T, bool> nsample(const T &s, action_t a, const hash_t<T> &hash) const {
         std::vector<std::pair<T, float> > outcomes;
+        COUNT(NextSample);
         next(s, a, outcomes);
         unsigned osize = outcomes.size();
         std::vector<bool> label(osize, false);
@@ -227,34 +316,219 @@ template<typename T> class problem_t {
     virtual void print(std::ostream &os) const = 0;
 };
 
-template<typename T>
-inline float hash_t<T>::q_value(const T &s, action_t a) const {
-    if( problem_.terminal(s) ) return 0;
+template<typename T, typename P> struct kernel_t {
+    static float q_value(const P &problem, const hash_t<T> &hash, const T &s, action_t a, bool min) {
+        if( problem.terminal(s) ) return 0;
 
-    std::vector<std::pair<T, float> > outcomes;
-    problem_.next(s, a, outcomes);
-    unsigned osize = outcomes.size();
+        std::vector<std::pair<T, float> > outcomes;
+        COUNT(NextBackup);
+        problem.next(s, a, outcomes);
+        unsigned osize = outcomes.size();
 
-    float qv = 0.0;
-    for( unsigned i = 0; i < osize; ++i ) {
-        qv += outcomes[i].second * this->value(outcomes[i].first);
+        if( min ) {
+            float qv = std::numeric_limits<float>::max();
+            for( unsigned i = 0; i < osize; ++i ) {
+                qv = Utils::min(qv, hash.value(outcomes[i].first));
+            }
+            return qv == std::numeric_limits<float>::max() ? std::numeric_limits<float>::max() : problem.cost(s, a) + problem.discount() * qv;
+        }
+
+        float qv = 0.0;
+        for( unsigned i = 0; i < osize; ++i ) {
+            qv += outcomes[i].second * hash.value(outcomes[i].first);
+        }
+        return problem.cost(s, a) + problem.discount() * qv;
     }
-    return problem_.cost(s, a) + problem_.discount() * qv;
-}
 
+    static std::pair<action_t, float> best_q_value(const P &problem, const hash_t<T> &hash, const T &s, bool min) {
+        action_t best_action = noop;
+        float best_value = std::numeric_limits<float>::max();
+        for( action_t a = 0, nactions = problem.number_actions(s); a < nactions; ++a ) {
+            if( problem.applicable(s, a) ) {
+                float value = q_value(problem, hash, s, a, min);
+                if( value < best_value ) {
+                    best_value = value;
+                    best_action = a;
+                }
+            }
+        }
+        return std::make_pair(best_action, best_value);
+    }
+
+    static void applicable_actions(const P &problem, const T &s, std::vector<action_t> &actions) {
+        actions.clear();
+        for( action_t a = 0, nactions = problem.number_actions(s); a < nactions; ++a ) {
+            if( problem.applicable(s, a) ) actions.push_back(a);
+        }
+    }
+
+    static float lookahead(const P &problem, const T &s, action_t a, std::vector<std::pair<T, float> > &outcomes) {
+        problem.next(s, a, outcomes);
+        return problem.cost(s, a);
+    }
+};
+
+// Base class for domains known at compile time (CRTP): P is the class of
+// the domain, which must be declared final so that the compiler binds the
+// calls in the kernels to its methods directly (and inlines them). Domains
+// that are further derived must stay with problem_t.
+template<typename T, typename P> class static_problem_t : public problem_t<T> {
+    const P& self() const { return static_cast<const P&>(*this); }
+
+  public:
+    static_problem_t(float discount = 1.0, float dead_end_value = 1e3)
+      : problem_t<T>(discount, dead_end_value) { }
+    virtual ~static_problem_t() { }
+
+    virtual float q_value(const hash_t<T> &hash, const T &s, action_t a, bool min) const {
+        return kernel_t<T, P>::q_value(self(), hash, s, a, min);
+    }
+    virtual std::pair<action_t, float> best_q_value(const hash_t<T> &hash, const T &s, bool min) const {
+        return kernel_t<T, P>::best_q_value(self(), hash, s, min);
+    }
+    virtual void applicable_actions(const T &s, std::vector<action_t> &actions) const {
+        kernel_t<T, P>::applicable_actions(self(), s, actions);
+    }
+    virtual float lookahead(const T &s, action_t a, std::vector<std::pair<T, float> > &outcomes) const {
+        return kernel_t<T, P>::lookahead(self(), s, a, outcomes);
+    }
+};
+
+// Evicts entries when the table is over budget, down to 3/4 of it so
+// that the cost of an eviction (a walk of the best partial graph) is
+// amortized over the insertions that fill the table again. Must be called
+// when the algorithm holds no pointers to entries (e.g. between trials);
+// under a budget, each call also starts a new epoch for the stamps of the
+// entries. Without one, the epoch stays at 0 so lookups don't write to
+// the entries.
+//
+// The best partial graph of the root is kept, so the solution found so
+// far (values, best actions and labels in the graph) is unaffected. Other
+// states are evicted solved ones first, then the least recently used,
+// and the successors of the graph under other actions (the fringe) last.
+// An evicted state gets its heuristic value again when it's accessed, so
+// values stay admissible and algorithms that only rely on that (lrtdp,
+// hdp and improved-lao) remain correct and just redo some work. Kept
+// states outside the graph lose their solved labels, as their descendants
+// may have been evicted, and so do states in the graph that lose a state
+// of the fringe. With a cold store, evicted entries are written to it in
+// one batch instead and nothing is lost: labels are kept and evicted
+// states come back with their values when accessed.
+//
+// If the graph alone doesn't fit in the budget, the solve is aborted.
 template<typename T>
-inline float min_hash_t<T>::q_value(const T &s, action_t a) const {
-    if( hash_t<T>::problem_.terminal(s) ) return 0;
+inline void hash_t<T>::evict(const T &root) {
+    typedef typename base_type::iterator iterator;
+    if( max_memory_ == 0 ) return;
+    if( this->memory() <= max_memory_ ) {
+        this->set_epoch(1 + this->epoch());
+        return;
+    }
 
+    // collect the best partial graph of the root (states get count 1) and
+    // its fringe (states get marked), with the parent of each fringe state
     std::vector<std::pair<T, float> > outcomes;
-    hash_t<T>::problem_.next(s, a, outcomes);
-    unsigned osize = outcomes.size();
+    std::vector<std::pair<T, Hash::data_t*> > open;
+    std::vector<Hash::data_t*> graph;
+    std::vector<std::pair<Hash::data_t*, Hash::data_t*> > fringe;
+    iterator di = base_type::find(root);
+    if( di != this->end() ) {
+        (*di).second->inc_count();
+        graph.push_back((*di).second);
+        open.push_back(std::make_pair(root, (*di).second));
+    }
+    while( !open.empty() ) {
+        T t = open.back().first;
+        Hash::data_t *parent = open.back().second;
+        open.pop_back();
+        if( problem_.terminal(t) ) continue;
+        action_t best_action = best_q_value(t).first;
+        for( action_t a = 0; a < problem_.number_actions(t); ++a ) {
+            if( !problem_.applicable(t, a) ) continue;
+            COUNT(NextAlgorithm);
+            problem_.next(t, a, outcomes);
+            for( size_t i = 0, isz = outcomes.size(); i < isz; ++i ) {
+                di = base_type::find(outcomes[i].first);
+                if( (di == this->end()) || ((*di).second->count() > 0) ) continue;
+                Hash::data_t *dptr = (*di).second;
+                if( a == best_action ) {
+                    dptr->unmark();
+                    dptr->inc_count();
+                    graph.push_back(dptr);
+                    open.push_back(std::make_pair(outcomes[i].first, dptr));
+                } else {
+                    dptr->mark();
+                    fringe.push_back(std::make_pair(dptr, parent));
+                }
+            }
+        }
+    }
+
+    size_t graph_memory = graph.size() * (base_type::entry_bytes() + sizeof(void*));
+    if( graph_memory > max_memory_ ) {
+        std::cout << Utils::error() << "hash: max-memory=" << max_memory_
+                  << " is too small for the best partial graph of the root"
+                  << " (" << graph.size() << " state(s), " << graph_memory << " bytes)" << std::endl;
+        exit(1);
+    }
+
+    // candidates: solved states first, then least recently used, then
+    // the fringe
+    std::vector<std::pair<unsigned long long, iterator> > candidates;
+    for( di = this->begin(); di != this->end(); ++di ) {
+        const Hash::data_t *dptr = (*di).second;
+        if( dptr->count() > 0 ) continue;
+        unsigned long long tier = dptr->marked() ? 2 : (dptr->solved() ? 0 : 1);
+        candidates.push_back(std::make_pair((tier << 32) | dptr->stamp(), di));
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<unsigned long long, iterator> &p, const std::pair<unsigned long long, iterator> &q) { return p.first < q.first; });
+
+    // the buckets are shrunk after evicting, so each kept entry costs a
+    // bucket too
+    size_t target = max_memory_ / 4 * 3;
+    size_t keep = target / (base_type::entry_bytes() + sizeof(void*));
+    size_t n = Utils::min(candidates.size(), this->size() - Utils::min(keep, this->size()));
+    if( (graph_memory > target) && !warned_ ) {
+        std::cout << Utils::warning() << "hash: the best partial graph of the root uses " << graph_memory
+                  << " bytes of max-memory=" << max_memory_ << "; evictions will be frequent" << std::endl;
+        warned_ = true;
+    }
+
+    // without a cold store, states in the graph that lose a state of the
+    // fringe lose their labels (evicted states are the ones unmarked here,
+    // as fringe states that joined the graph have count 1)
+    typename base_type::cold_store_t *cold_store = this->cold_store();
+    for( size_t i = 0; i < n; ++i )
+        candidates[i].second->second->unmark();
+    for( size_t i = 0, isz = fringe.size(); (cold_store == 0) && (i < isz); ++i ) {
+        const Hash::data_t *dptr = fringe[i].first;
+        if( !dptr->marked() && (dptr->count() == 0) ) fringe[i].second->unsolve();
+    }
+
+    if( n > 0 ) this->reset_interned();
+    for( size_t i = 0; i < n; ++i ) {
+        if( cold_store != 0 ) cold_store->append(candidates[i].second->first, *candidates[i].second->second);
+        this->erase(candidates[i].second);
+    }
+    if( cold_store != 0 ) cold_store->flush();
+    evictions_ += n;
+    if( (cold_store == 0) && (evictions_ > 10 * (max_memory_ / base_type::entry_bytes())) && !thrashing_warned_ ) {
+        std::cout << Utils::warning() << "hash: " << evictions_ << " states evicted, over 10 times what max-memory="
+                  << max_memory_ << " holds; the solve may be thrashing (use a larger budget or spill=)" << std::endl;
+        thrashing_warned_ = true;
+    }
 
-    float qv = std::numeric_limits<float>::max();
-    for( unsigned i = 0; i < osize; ++i ) {
-        qv = Utils::min(qv, this->value(outcomes[i].first));
+    // without a cold store, only states in the graph keep their labels
+    for( size_t i = n, isz = candidates.size(); i < isz; ++i ) {
+        Hash::data_t *dptr = candidates[i].second->second;
+        dptr->unmark();
+        if( cold_store == 0 ) dptr->unsolve();
     }
-    return qv == std::numeric_limits<float>::max() ? std::numeric_limits<float>::max() : hash_t<T>::problem_.cost(s, a) + hash_t<T>::problem_.discount() * qv;
+    for( size_t i = 0, isz = graph.size(); i < isz; ++i )
+        graph[i]->clear_count();
+    if( n > 0 ) base_type::rehash(0); // shrink the buckets
+    this->set_epoch(1 + this->epoch());
 }
 
 }; // namespace Problem
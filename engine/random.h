@@ -27,15 +27,28 @@
 
 namespace Random {
 
+// Each thread owns its own 48-bit generator state so that parallel jobs
+// can draw numbers without interfering with each other. The sequences
+// are the same as those of drand48()/lrand48() for the same seed.
+inline unsigned short* _state() {
+    static thread_local unsigned short xsubi[3] = { 0x330E, 0xABCD, 0x1234 };
+    return xsubi;
+}
+
 inline void set_seed(int seed) {
-    unsigned short useed[3];
-    useed[0] = useed[1] = useed[2] = seed;
-    srand48((long int)seed);
-    seed48(useed);
+    unsigned short *xsubi = _state();
+    xsubi[0] = xsubi[1] = xsubi[2] = seed;
+}
+
+inline void set_seed48(unsigned long long seed) {
+    unsigned short *xsubi = _state();
+    xsubi[0] = seed & 0xFFFF;
+    xsubi[1] = (seed >> 16) & 0xFFFF;
+    xsubi[2] = (seed >> 32) & 0xFFFF;
 }
 
 inline float _random_float() {
-    float d = drand48();
+    float d = erand48(_state());
 #ifdef DEBUG
     std::cerr << "_random_float: " << d << std::endl;
 #endif
@@ -43,13 +56,81 @@ inline float _random_float() {
 }
 
 inline unsigned _random_unsigned() {
-    int r = lrand48();
+    int r = nrand48(_state());
 #ifdef DEBUG
     std::cerr << "_random_unsigned: " << r << std::endl;
 #endif
     return r;
 }
 
+// 48-bit seed for a job stream, drawn from the calling thread's generator
+inline unsigned long long seed48() {
+    unsigned long long hi = _random_unsigned();
+    unsigned long long lo = _random_unsigned();
+    return ((hi << 17) ^ lo) & 0xFFFFFFFFFFFFULL;
+}
+
+// 48-bit seed for the stream of the index-th job of a computation with
+// the given seed (e.g. a trial of an evaluation), which doesn't depend on
+// the generator state. Uses the finalizer of splitmix64.
+inline unsigned long long seed48(unsigned seed, unsigned index) {
+    unsigned long long z = ((unsigned long long)seed << 32) | index;
+    z += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+    return z & 0xFFFFFFFFFFFFULL;
+}
+
+// State of a generator kept apart from the thread's generator, for
+// randomness that must not be shared with other consumers (e.g. the
+// outcomes of actions in a trial, which must not depend on the number
+// of numbers drawn by the policy)
+struct stream_t {
+    unsigned short xsubi_[3];
+    stream_t(unsigned long long seed) {
+        xsubi_[0] = seed & 0xFFFF;
+        xsubi_[1] = (seed >> 16) & 0xFFFF;
+        xsubi_[2] = (seed >> 32) & 0xFFFF;
+    }
+};
+
+// Switches the calling thread to the stream given by a 48-bit seed (or to
+// a stream_t, which is advanced by the numbers drawn) and restores the
+// previous stream on destruction.
+class scoped_stream_t {
+    unsigned short saved_[3];
+    stream_t *stream_;
+  public:
+    scoped_stream_t(unsigned long long seed) : stream_(0) {
+        unsigned short *xsubi = _state();
+        saved_[0] = xsubi[0];
+        saved_[1] = xsubi[1];
+        saved_[2] = xsubi[2];
+        set_seed48(seed);
+    }
+    scoped_stream_t(stream_t &stream) : stream_(&stream) {
+        unsigned short *xsubi = _state();
+        saved_[0] = xsubi[0];
+        saved_[1] = xsubi[1];
+        saved_[2] = xsubi[2];
+        xsubi[0] = stream.xsubi_[0];
+        xsubi[1] = stream.xsubi_[1];
+        xsubi[2] = stream.xsubi_[2];
+    }
+    ~scoped_stream_t() {
+        unsigned short *xsubi = _state();
+        if( stream_ != 0 ) {
+            stream_->xsubi_[0] = xsubi[0];
+            stream_->xsubi_[1] = xsubi[1];
+            stream_->xsubi_[2] = xsubi[2];
+        }
+        xsubi[0] = saved_[0];
+        xsubi[1] = saved_[1];
+        xsubi[2] = saved_[2];
+    }
+};
+
 inline float real() {
     return _random_float();
 }
@@ -65,7 +146,7 @@ inline unsigned random(unsigned min, unsigned max) {
 }
 
 inline float uniform() {
-    return drand48();
+    return erand48(_state());
 }
 
 inline float uniform(float a, float b) {
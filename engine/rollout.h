@@ -105,6 +105,10 @@ template<typename T> class rollout_t : public improvement_t<T> {
            << std::endl;
         if( base_policy_ != 0 ) base_policy_->print_other_stats(os, 2 + indent);
     }
+    virtual void record_other_stats(Stats::record_t &record, const std::string &prefix) const {
+        policy_t<T>::record_other_stats(record, prefix);
+        if( base_policy_ != 0 ) base_policy_->record_other_stats(record, prefix + "base.");
+    }
     virtual void set_parameters(const std::multimap<std::string, std::string> &parameters, Dispatcher::dispatcher_t<T> &dispatcher) {
         std::multimap<std::string, std::string>::const_iterator it = parameters.find("width");
         if( it != parameters.end() ) width_ = strtol(it->second.c_str(), 0, 0);
@@ -137,10 +141,8 @@ template<typename T> class rollout_t : public improvement_t<T> {
             std::cout << Utils::error() << "(base) policy must be specified for rollout() policy!" << std::endl;
             exit(1);
         }
-        float start_time = Utils::read_time_in_seconds();
-        float value = Evaluation::evaluation(*base_policy_, s, 1, depth_);
-        policy_t<T>::base_policy_time_ += Utils::read_time_in_seconds() - start_time;
-        return value;
+        Utils::sampled_timer_t timer(policy_t<T>::base_policy_time_, policy_t<T>::base_policy_calls_++);
+        return Evaluation::evaluation(*base_policy_, s, 1, depth_);
     }
 
     friend nested_rollout_t<T>;
@@ -199,6 +201,11 @@ template<typename T> class nested_rollout_t : public improvement_t<T> {
         for( int i = 0; i < int(nested_policies_.size()); ++i )
             nested_policies_[i]->print_other_stats(os, 2 + indent);
     }
+    virtual void record_other_stats(Stats::record_t &record, const std::string &prefix) const {
+        record.add(prefix + "name", name());
+        for( int i = 0; i < int(nested_policies_.size()); ++i )
+            nested_policies_[i]->record_other_stats(record, prefix + "nested" + std::to_string(i) + ".");
+    }
     virtual void set_parameters(const std::multimap<std::string, std::string> &parameters, Dispatcher::dispatcher_t<T> &dispatcher) {
         std::multimap<std::string, std::string>::const_iterator it = parameters.find("width");
         if( it != parameters.end() ) width_ = strtol(it->second.c_str(), 0, 0);
@@ -230,10 +237,8 @@ template<typename T> class nested_rollout_t : public improvement_t<T> {
 
     float evaluate(const T &s) const {
         assert(!nested_policies_.empty());
-        float start_time = Utils::read_time_in_seconds();
-        float value = Evaluation::evaluation(*nested_policies_.bac(), s, 1, depth_);
-        policy_t<T>::base_policy_time_ += Utils::read_time_in_seconds() - start_time;
-        return value;
+        Utils::sampled_timer_t timer(policy_t<T>::base_policy_time_, policy_t<T>::base_policy_calls_++);
+        return Evaluation::evaluation(*nested_policies_.back(), s, 1, depth_);
     }
 
     void make_nested_policies() {
@@ -147,6 +147,7 @@ template<typename T> class simple_astar_t : public algorithm_t<T> {
             // expand state
             for( Problem::action_t a = 0; a < problem_.number_actions(n.first); ++a ) {
                 if( problem_.applicable(n.first, a) ) {
+                    COUNT(NextAlgorithm);
                     problem_.next(n.first, a, outcomes);
                     assert(outcomes.size() == 1);
                     Hash::data_t *ptr = hash.data_ptr(outcomes[0].first);
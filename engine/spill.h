@@ -0,0 +1,353 @@
+/*
+ *  Copyright (c) 2011-2016 Universidad Simon Bolivar
+ *
+ *  Permission is hereby granted to distribute this software for
+ *  non-commercial research purposes, provided that this copyright
+ *  notice is included with any such distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ *  EITHER EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE.  THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE
+ *  SOFTWARE IS WITH YOU.  SHOULD THE PROGRAM PROVE DEFECTIVE, YOU
+ *  ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ *
+ *  Blai Bonet, bonet@ldc.usb.ve
+ *
+ */
+
+#ifndef SPILL_H
+#define SPILL_H
+
+#include "hash.h"
+#include "problem.h"
+#include "utils.h"
+#include "value_file.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+//#define DEBUG
+
+// Out-of-core storage for the hash table. Entries evicted from the table
+// (see hash_t::evict) are appended in batches to a log on disk, and the
+// table faults them back in when they are accessed again, so a solve can
+// explore more states than fit in memory without losing any work.
+//
+// The log is append-only: a state that is evicted again gets a new record
+// and the latest one wins. Each batch is indexed by a run of (hash,
+// offset) pairs sorted by hash and written to its own file, which is
+// memory-mapped read-only; runs are merged LSM-style so that there are
+// O(log n) of them, and a lookup is a binary search per run plus a read of
+// the matching records. Merges drop the entries of superseded records,
+// and once these are half of the log, the live records are copied to a
+// new log indexed by a single run. Records use the layout of value files.
+// The log and the runs are scratch files: they are unlinked as soon as
+// they are created, so they go away when the process exits, even if it's
+// killed.
+
+namespace Spill {
+
+struct entry_t {
+    uint64_t hash_;
+    uint64_t offset_;
+    // by hash, latest record first
+    bool operator<(const entry_t &e) const {
+        return (hash_ < e.hash_) || ((hash_ == e.hash_) && (offset_ > e.offset_));
+    }
+};
+
+struct run_t {
+    std::string filename_;
+    const entry_t *entries_;
+    size_t size_;
+    const entry_t* begin() const { return entries_; }
+    const entry_t* end() const { return entries_ + size_; }
+};
+
+template<typename T> class store_t : public Hash::hash_map_t<T>::cold_store_t {
+  public:
+    typedef typename Hash::hash_map_t<T>::cold_store_t::callback_t callback_t;
+
+  protected:
+    const Problem::problem_t<T> &problem_;
+    std::string filename_;
+    int fd_;
+    size_t state_size_;
+    size_t record_size_;
+    uint64_t end_;                       // size of the log
+    size_t size_;
+    size_t garbage_;                     // superseded records in the log
+    size_t compactions_;
+    unsigned next_run_;
+    std::vector<char> buffer_;           // records of the batch
+    std::vector<entry_t> batch_;         // index of the batch
+    std::vector<run_t> runs_;            // oldest first
+    mutable std::vector<char> bytes_;
+    mutable std::vector<char> record_;
+
+    store_t(const store_t &store);
+
+    ValueFile::record_t* record() const { return reinterpret_cast<ValueFile::record_t*>(&record_[0]); }
+    bool read_record(uint64_t offset) const {
+        return pread(fd_, &record_[0], record_size_, offset) == ssize_t(record_size_);
+    }
+
+    // write entries to a new run file and map it
+    bool make_run(const std::vector<entry_t> &entries, run_t &run) {
+        run.filename_ = filename_ + ".run" + std::to_string(next_run_++);
+        run.entries_ = 0;
+        run.size_ = entries.size();
+        size_t size = entries.size() * sizeof(entry_t);
+        int fd = ::open(run.filename_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        bool ok = (fd != -1) && (::write(fd, &entries[0], size) == ssize_t(size));
+        void *map = ok ? mmap(0, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        if( fd != -1 ) ::close(fd);
+        unlink(run.filename_.c_str());
+        if( map == MAP_FAILED ) {
+            std::cout << Utils::error() << "spill: cannot write '" << run.filename_ << "'" << std::endl;
+            return false;
+        }
+        madvise(map, size, MADV_RANDOM);
+        run.entries_ = static_cast<const entry_t*>(map);
+        return true;
+    }
+    void remove_run(run_t &run) {
+        munmap(const_cast<entry_t*>(run.entries_), run.size_ * sizeof(entry_t));
+    }
+
+    // remove from sorted entries those of records superseded by a later
+    // record of the same state; returns how many were removed
+    size_t drop_superseded(std::vector<entry_t> &entries) const {
+        std::vector<char> states;
+        size_t j = 0;
+        for( size_t i = 0, isz = entries.size(); i < isz; ) {
+            size_t k = i + 1;
+            while( (k < isz) && (entries[k].hash_ == entries[i].hash_) ) ++k;
+            states.clear();
+            for( size_t m = i; m < k; ++m ) {
+                bool superseded = false;
+                if( (k - i > 1) && read_record(entries[m].offset_) ) {
+                    for( size_t o = 0; !superseded && (o < states.size()); o += state_size_ )
+                        superseded = memcmp(&states[o], record()->state(), state_size_) == 0;
+                    if( !superseded ) states.insert(states.end(), record()->state(), record()->state() + state_size_);
+                }
+                if( !superseded ) entries[j++] = entries[m];
+            }
+            i = k;
+        }
+        size_t dropped = entries.size() - j;
+        entries.resize(j);
+        return dropped;
+    }
+
+    // copy the live records to a new log, in the order of the old one,
+    // and index them with a single run
+    void compact() {
+        std::vector<entry_t> entries;
+        for( size_t i = 0; i < runs_.size(); ++i )
+            entries.insert(entries.end(), runs_[i].begin(), runs_[i].end());
+        std::sort(entries.begin(), entries.end());
+        garbage_ += drop_superseded(entries);
+        std::sort(entries.begin(), entries.end(), [](const entry_t &e, const entry_t &f) { return e.offset_ < f.offset_; });
+
+        int fd = ::open(filename_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if( fd == -1 ) {
+            std::cout << Utils::error() << "spill: cannot create '" << filename_ << "'" << std::endl;
+            exit(1);
+        }
+        unlink(filename_.c_str());
+        const size_t batch = Utils::max(size_t(1), (size_t(1) << 20) / record_size_);
+        std::vector<char> chunk;
+        chunk.reserve(batch * record_size_);
+        uint64_t end = 0;
+        for( size_t i = 0, isz = entries.size(); i < isz; ++i ) {
+            if( !read_record(entries[i].offset_) ) {
+                std::cout << Utils::error() << "spill: cannot read '" << filename_ << "'" << std::endl;
+                exit(1);
+            }
+            chunk.insert(chunk.end(), record_.begin(), record_.end());
+            entries[i].offset_ = end + chunk.size() - record_size_;
+            if( (chunk.size() == batch * record_size_) || (i + 1 == isz) ) {
+                if( pwrite(fd, &chunk[0], chunk.size(), end) != ssize_t(chunk.size()) ) {
+                    std::cout << Utils::error() << "spill: cannot write '" << filename_ << "'" << std::endl;
+                    exit(1);
+                }
+                end += chunk.size();
+                chunk.clear();
+            }
+        }
+        std::sort(entries.begin(), entries.end());
+
+        for( size_t i = 0; i < runs_.size(); ++i )
+            remove_run(runs_[i]);
+        runs_.clear();
+        ::close(fd_);
+        fd_ = fd;
+        end_ = end;
+        garbage_ = 0;
+        ++compactions_;
+        if( !entries.empty() ) {
+            run_t run;
+            if( !make_run(entries, run) ) exit(1);
+            runs_.push_back(run);
+        }
+#ifdef DEBUG
+        std::cout << "debug: spill: compacted log: #records=" << entries.size() << std::endl;
+#endif
+    }
+
+    // merge the last two runs while the older one isn't much larger
+    void merge_runs() {
+        while( (runs_.size() > 1) && (runs_[runs_.size() - 2].size_ <= 2 * runs_.back().size_) ) {
+            run_t &older = runs_[runs_.size() - 2], &newer = runs_.back();
+            std::vector<entry_t> entries(older.size_ + newer.size_);
+            std::merge(older.begin(), older.end(), newer.begin(), newer.end(), entries.begin());
+            garbage_ += drop_superseded(entries);
+            run_t run;
+            if( !make_run(entries, run) ) exit(1);
+            remove_run(older);
+            remove_run(newer);
+            runs_.pop_back();
+            runs_.back() = run;
+        }
+    }
+
+    // offset of the latest record of the state with the given bytes and
+    // hash, or end_ if there is none; the record is left in record_ unless
+    // it's the one at the known offset
+    uint64_t latest(const char *bytes, uint64_t hash, uint64_t known = ~uint64_t(0)) const {
+        entry_t key = { hash, ~uint64_t(0) };
+        for( size_t i = runs_.size(); i > 0; --i ) {
+            const run_t &run = runs_[i - 1];
+            for( const entry_t *e = std::lower_bound(run.begin(), run.end(), key); (e != run.end()) && (e->hash_ == hash); ++e ) {
+                if( e->offset_ == known ) return known;
+                if( !read_record(e->offset_) ) continue;
+                if( memcmp(record()->state(), bytes, state_size_) == 0 ) return e->offset_;
+            }
+        }
+        return end_;
+    }
+
+  public:
+    store_t(const Problem::problem_t<T> &problem, const std::string &filename)
+      : problem_(problem), filename_(filename), fd_(-1),
+        state_size_(problem.state_size()),
+        record_size_(ValueFile::record_size(state_size_)),
+        end_(0), size_(0), garbage_(0), compactions_(0), next_run_(0),
+        bytes_(state_size_), record_(record_size_) {
+    }
+    virtual ~store_t() {
+        for( size_t i = 0; i < runs_.size(); ++i )
+            remove_run(runs_[i]);
+        if( fd_ != -1 ) ::close(fd_);
+    }
+
+    // create the log; on errors, a message is printed and false is returned
+    bool open() {
+        if( state_size_ == 0 ) {
+            std::cout << Utils::error() << "spill: problem doesn't support serialization of states" << std::endl;
+            return false;
+        }
+        fd_ = ::open(filename_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if( fd_ == -1 ) {
+            std::cout << Utils::error() << "spill: cannot create '" << filename_ << "'" << std::endl;
+            return false;
+        }
+        unlink(filename_.c_str());
+        return true;
+    }
+
+    const std::string& filename() const { return filename_; }
+    uint64_t bytes() const { return end_; }
+    size_t num_runs() const { return runs_.size(); }
+    size_t compactions() const { return compactions_; }
+    virtual size_t size() const { return size_; }
+
+    virtual void append(const T &s, const Hash::data_t &data) {
+        size_t offset = buffer_.size();
+        buffer_.resize(offset + record_size_, 0);
+        ValueFile::record_t *record = reinterpret_cast<ValueFile::record_t*>(&buffer_[offset]);
+        problem_.serialize(s, record->state());
+        record->hash_ = ValueFile::hash_bytes(record->state(), state_size_);
+        record->value_ = data.value();
+        record->action_ = data.action();
+        record->flags_ = ValueFile::record_t::Used | (data.solved() ? ValueFile::record_t::Solved : 0);
+        entry_t entry = { record->hash_, end_ + offset };
+        batch_.push_back(entry);
+    }
+
+    // write the batch with one write and index it with a new run
+    virtual void flush() {
+        if( batch_.empty() ) return;
+        for( size_t offset = 0; offset < buffer_.size(); ) {
+            ssize_t n = pwrite(fd_, &buffer_[offset], buffer_.size() - offset, end_ + offset);
+            if( n <= 0 ) {
+                std::cout << Utils::error() << "spill: cannot write '" << filename_ << "'" << std::endl;
+                exit(1);
+            }
+            offset += n;
+        }
+        end_ += buffer_.size();
+        size_ += batch_.size();
+        std::sort(batch_.begin(), batch_.end());
+        run_t run;
+        if( !make_run(batch_, run) ) exit(1);
+        runs_.push_back(run);
+        merge_runs();
+        if( 2 * garbage_ * record_size_ > end_ ) compact();
+#ifdef DEBUG
+        std::cout << "debug: spill: flushed " << batch_.size() << " record(s): #records=" << size_ << ", #runs=" << runs_.size() << std::endl;
+#endif
+        buffer_.clear();
+        batch_.clear();
+    }
+
+    virtual bool fetch(const T &s, Hash::data_t &data) const {
+        if( runs_.empty() ) return false;
+        problem_.serialize(s, &bytes_[0]);
+        if( latest(&bytes_[0], ValueFile::hash_bytes(&bytes_[0], state_size_)) == end_ ) return false;
+        data = Hash::data_t(record()->value_, record()->solved());
+        data.set_action(record()->action_);
+        return true;
+    }
+
+    // stream the log sequentially and report the latest record of each state
+    virtual void scan(const callback_t &callback) const {
+        const size_t batch = Utils::max(size_t(1), (size_t(1) << 20) / record_size_);
+        std::vector<char> chunk(batch * record_size_);
+        T s;
+        for( uint64_t start = 0; start < end_; start += chunk.size() ) {
+            size_t size = Utils::min(uint64_t(chunk.size()), end_ - start);
+            if( pread(fd_, &chunk[0], size, start) != ssize_t(size) ) {
+                std::cout << Utils::error() << "spill: cannot read '" << filename_ << "'" << std::endl;
+                exit(1);
+            }
+            for( size_t offset = 0; offset < size; offset += record_size_ ) {
+                const ValueFile::record_t *r = reinterpret_cast<const ValueFile::record_t*>(&chunk[offset]);
+                if( latest(r->state(), r->hash_, start + offset) != start + offset ) continue;
+                if( !problem_.deserialize(r->state(), s) ) continue;
+                Hash::data_t data(r->value_, r->solved());
+                data.set_action(r->action_);
+                callback(s, data);
+            }
+        }
+    }
+};
+
+}; // namespace Spill
+
+#undef DEBUG
+
+#endif
+
@@ -0,0 +1,231 @@
+/*
+ *  Copyright (c) 2011-2016 Universidad Simon Bolivar
+ *
+ *  Permission is hereby granted to distribute this software for
+ *  non-commercial research purposes, provided that this copyright
+ *  notice is included with any such distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ *  EITHER EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE.  THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE
+ *  SOFTWARE IS WITH YOU.  SHOULD THE PROGRAM PROVE DEFECTIVE, YOU
+ *  ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ *
+ *  Blai Bonet, bonet@ldc.usb.ve
+ *
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//#define DEBUG
+
+namespace Stats {
+
+// A record is a flat sequence of fields with the same keys as the text
+// stats (e.g. type, name, eval.value). Values are either strings or
+// numbers; the latter are kept formatted, with enough digits to be read
+// back without loss.
+class record_t {
+  public:
+    struct field_t {
+        std::string key_;
+        std::string value_;
+        bool is_string_;
+        field_t(const std::string &key, const std::string &value, bool is_string)
+          : key_(key), value_(value), is_string_(is_string) {
+        }
+    };
+
+  protected:
+    std::vector<field_t> fields_;
+
+    template<typename N> void add_number(const std::string &key, N value) {
+        std::ostringstream os;
+        os.precision(std::numeric_limits<N>::digits10 + 2);
+        os << value;
+        fields_.push_back(field_t(key, os.str(), false));
+    }
+
+  public:
+    record_t() { }
+    record_t(const std::string &type) {
+        add("type", type);
+    }
+
+    const std::vector<field_t>& fields() const { return fields_; }
+    std::string type() const { return fields_.empty() ? std::string() : fields_[0].value_; }
+    std::string name() const {
+        for( int i = 0, isz = fields_.size(); i < isz; ++i ) {
+            if( fields_[i].key_ == "name" ) return fields_[i].value_;
+        }
+        return std::string();
+    }
+
+    record_t& add(const std::string &key, const std::string &value) {
+        fields_.push_back(field_t(key, value, true));
+        return *this;
+    }
+    record_t& add(const std::string &key, const char *value) {
+        return add(key, std::string(value));
+    }
+    record_t& add(const std::string &key, bool value) {
+        fields_.push_back(field_t(key, value ? "true" : "false", false));
+        return *this;
+    }
+    record_t& add(const std::string &key, float value) { add_number(key, value); return *this; }
+    record_t& add(const std::string &key, double value) { add_number(key, value); return *this; }
+    record_t& add(const std::string &key, int value) { add_number(key, value); return *this; }
+    record_t& add(const std::string &key, unsigned value) { add_number(key, value); return *this; }
+    record_t& add(const std::string &key, long value) { add_number(key, value); return *this; }
+    record_t& add(const std::string &key, unsigned long value) { add_number(key, value); return *this; }
+    record_t& add(const std::string &key, unsigned long long value) { add_number(key, value); return *this; }
+};
+
+// Abstract destination of stats records. Each record is written and
+// flushed as soon as it is produced, so outputs can be ingested while a
+// sweep of experiments is running.
+class sink_t {
+  protected:
+    std::ostream *os_;
+    bool owns_stream_;
+
+  public:
+    sink_t(std::ostream &os) : os_(&os), owns_stream_(false) { }
+    sink_t(const std::string &filename) : os_(0), owns_stream_(true) {
+        os_ = new std::ofstream(filename.c_str());
+    }
+    virtual ~sink_t() {
+        if( owns_stream_ ) delete os_;
+    }
+
+    bool good() const { return (os_ != 0) && os_->good(); }
+    virtual std::string name() const = 0;
+    virtual void write(const record_t &record) = 0;
+};
+
+// One JSON object per line (JSON lines)
+class json_sink_t : public sink_t {
+  public:
+    json_sink_t(std::ostream &os) : sink_t(os) { }
+    json_sink_t(const std::string &filename) : sink_t(filename) { }
+    virtual ~json_sink_t() { }
+
+    static void print_string(std::ostream &os, const std::string &str) {
+        os << '"';
+        for( int i = 0, isz = str.size(); i < isz; ++i ) {
+            char c = str[i];
+            if( (c == '"') || (c == '\\') ) {
+                os << '\\' << c;
+            } else if( (unsigned char)c < 0x20 ) {
+                const char *hex = "0123456789abcdef";
+                os << "\\u00" << hex[(c >> 4) & 0xF] << hex[c & 0xF];
+            } else {
+                os << c;
+            }
+        }
+        os << '"';
+    }
+
+    virtual std::string name() const { return "json"; }
+    virtual void write(const record_t &record) {
+        const std::vector<record_t::field_t> &fields = record.fields();
+        *os_ << "{";
+        for( int i = 0, isz = fields.size(); i < isz; ++i ) {
+            if( i > 0 ) *os_ << ",";
+            print_string(*os_, fields[i].key_);
+            *os_ << ":";
+            if( fields[i].is_string_ )
+                print_string(*os_, fields[i].value_);
+            else if( (fields[i].value_ == "nan") || (fields[i].value_ == "inf") || (fields[i].value_ == "-inf") )
+                *os_ << "null";
+            else
+                *os_ << fields[i].value_;
+        }
+        *os_ << "}" << std::endl;
+    }
+};
+
+// CSV in long format: one row per field with columns record,type,name,
+// key,value, where record numbers the records. Records of different types
+// have different fields, and this keeps a fixed header for all of them.
+class csv_sink_t : public sink_t {
+  protected:
+    unsigned records_;
+
+  public:
+    csv_sink_t(std::ostream &os) : sink_t(os), records_(0) { }
+    csv_sink_t(const std::string &filename) : sink_t(filename), records_(0) { }
+    virtual ~csv_sink_t() { }
+
+    static void print_cell(std::ostream &os, const std::string &str) {
+        if( str.find_first_of(",\"\n\r") == std::string::npos ) {
+            os << str;
+        } else {
+            os << '"';
+            for( int i = 0, isz = str.size(); i < isz; ++i ) {
+                if( str[i] == '"' ) os << '"';
+                os << str[i];
+            }
+            os << '"';
+        }
+    }
+
+    virtual std::string name() const { return "csv"; }
+    virtual void write(const record_t &record) {
+        if( records_ == 0 ) *os_ << "record,type,name,key,value" << std::endl;
+        const std::vector<record_t::field_t> &fields = record.fields();
+        std::string type = record.type(), name = record.name();
+        for( int i = 0, isz = fields.size(); i < isz; ++i ) {
+            if( (fields[i].key_ == "type") || (fields[i].key_ == "name") ) continue;
+            *os_ << records_ << ",";
+            print_cell(*os_, type);
+            *os_ << ",";
+            print_cell(*os_, name);
+            *os_ << ",";
+            print_cell(*os_, fields[i].key_);
+            *os_ << ",";
+            print_cell(*os_, fields[i].value_);
+            *os_ << "\n";
+        }
+        os_->flush();
+        ++records_;
+    }
+};
+
+// Sink for a specification <format>:<file> with format json or csv, and
+// file - for the standard output. Returns 0 for an invalid specification.
+inline sink_t* make_sink(const std::string &spec) {
+    std::string::size_type colon = spec.find(':');
+    if( (colon == std::string::npos) || (colon + 1 == spec.size()) ) return 0;
+    std::string format = spec.substr(0, colon);
+    std::string filename = spec.substr(colon + 1);
+
+    sink_t *sink = 0;
+    if( format == "json" )
+        sink = filename == "-" ? new json_sink_t(std::cout) : new json_sink_t(filename);
+    else if( format == "csv" )
+        sink = filename == "-" ? new csv_sink_t(std::cout) : new csv_sink_t(filename);
+
+    if( (sink != 0) && !sink->good() ) {
+        delete sink;
+        sink = 0;
+    }
+    return sink;
+}
+
+}; // namespace Stats
+
+#undef DEBUG
+
+#endif
+
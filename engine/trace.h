@@ -0,0 +1,213 @@
+/*
+ *  Copyright (c) 2011-2016 Universidad Simon Bolivar
+ *
+ *  Permission is hereby granted to distribute this software for
+ *  non-commercial research purposes, provided that this copyright
+ *  notice is included with any such distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ *  EITHER EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE.  THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE
+ *  SOFTWARE IS WITH YOU.  SHOULD THE PROGRAM PROVE DEFECTIVE, YOU
+ *  ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ *
+ *  Blai Bonet, bonet@ldc.usb.ve
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "utils.h"
+
+#include <atomic>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//#define DEBUG
+
+// Timeline of a run in the Chrome trace-event format, which can be opened
+// with chrome://tracing or ui.perfetto.dev. Each thread records its
+// events in its own ring buffer with no locks; when a buffer is full, the
+// oldest events are overwritten, so tracing can stay on in long runs and
+// the file keeps the last part of each thread. Events are recorded as
+// complete events (begin time and duration) when their scope ends, so
+// overwriting never leaves a begin without its end.
+
+namespace Trace {
+
+struct event_t {
+    const char *name_;
+    double begin_;
+    double end_;
+};
+
+// Single-writer ring buffer: only the owning thread pushes, and readers
+// read it once that thread is idle or finished (e.g. at the end of the run)
+class buffer_t {
+  protected:
+    std::vector<event_t> events_;
+    size_t mask_;
+    std::atomic<size_t> head_;
+    unsigned tid_;
+
+  public:
+    buffer_t(size_t capacity, unsigned tid) : mask_(capacity - 1), head_(0), tid_(tid) {
+        assert((capacity > 0) && ((capacity & mask_) == 0));
+        events_.resize(capacity);
+    }
+
+    unsigned tid() const { return tid_; }
+    size_t capacity() const { return mask_ + 1; }
+    size_t pushed() const { return head_.load(std::memory_order_acquire); }
+
+    void push(const char *name, double begin, double end) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        event_t &event = events_[head & mask_];
+        event.name_ = name;
+        event.begin_ = begin;
+        event.end_ = end;
+        head_.store(1 + head, std::memory_order_release);
+    }
+
+    // events still in the buffer, oldest first
+    void events(std::vector<event_t> &events) const {
+        size_t head = pushed();
+        size_t size = head < capacity() ? head : capacity();
+        for( size_t i = head - size; i < head; ++i )
+            events.push_back(events_[i & mask_]);
+    }
+};
+
+// Buffers are owned by the tracer, so events of threads that already
+// finished (e.g. workers of a thread pool) are kept until the trace is written
+class tracer_t {
+  protected:
+    std::mutex mutex_;
+    std::vector<buffer_t*> buffers_;
+    std::string filename_;
+    size_t capacity_;
+    double start_time_;
+
+  public:
+    tracer_t() : capacity_(0), start_time_(0) { }
+    ~tracer_t() {
+        for( int i = 0, isz = buffers_.size(); i < isz; ++i )
+            delete buffers_[i];
+    }
+
+    void open(const std::string &filename, size_t capacity) {
+        filename_ = filename;
+        capacity_ = 1;
+        while( capacity_ < capacity ) capacity_ <<= 1;
+        start_time_ = Utils::read_monotonic_time();
+    }
+
+    const std::string& filename() const { return filename_; }
+    double start_time() const { return start_time_; }
+
+    buffer_t* new_buffer() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers_.push_back(new buffer_t(capacity_, buffers_.size()));
+        return buffers_.back();
+    }
+
+    // write all events in JSON; returns the number of overwritten events
+    size_t write(std::ostream &os) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t dropped = 0;
+        bool first = true;
+        os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        os.precision(3);
+        os << std::fixed;
+        for( int i = 0, isz = buffers_.size(); i < isz; ++i ) {
+            const buffer_t &buffer = *buffers_[i];
+            os << (first ? "\n" : ",\n")
+               << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.tid()
+               << ",\"args\":{\"name\":\"" << (buffer.tid() == 0 ? std::string("main") : "thread " + std::to_string(buffer.tid())) << "\"}}";
+            first = false;
+
+            std::vector<event_t> events;
+            buffer.events(events);
+            dropped += buffer.pushed() - events.size();
+            for( int j = 0, jsz = events.size(); j < jsz; ++j ) {
+                const event_t &event = events[j];
+                os << ",\n{\"name\":\"" << event.name_ << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer.tid()
+                   << ",\"ts\":" << 1e6 * (event.begin_ - start_time_)
+                   << ",\"dur\":" << 1e6 * (event.end_ - event.begin_) << "}";
+            }
+        }
+        os << "\n]}" << std::endl;
+        return dropped;
+    }
+};
+
+inline bool& enabled_flag() {
+    static bool enabled = false;
+    return enabled;
+}
+
+inline bool enabled() {
+    return enabled_flag();
+}
+
+inline tracer_t& tracer() {
+    static tracer_t tracer;
+    return tracer;
+}
+
+inline buffer_t& local() {
+    static thread_local buffer_t *buffer = tracer().new_buffer();
+    return *buffer;
+}
+
+// Start tracing; capacity is the number of events kept for each thread
+inline void enable(const std::string &filename, size_t capacity = 1 << 18) {
+    tracer().open(filename, capacity);
+    enabled_flag() = true;
+    local();
+}
+
+// Write the trace file; should be called when worker threads are idle
+inline bool finish() {
+    if( !enabled() ) return true;
+    enabled_flag() = false;
+    std::ofstream os(tracer().filename().c_str());
+    if( !os ) {
+        std::cout << Utils::error() << "trace: cannot write '" << tracer().filename() << "'" << std::endl;
+        return false;
+    }
+    size_t dropped = tracer().write(os);
+    if( dropped > 0 )
+        std::cout << Utils::warning() << "trace: " << dropped << " oldest event(s) were overwritten" << std::endl;
+    return true;
+}
+
+// Records an event with the given name (a string literal, as only the
+// pointer is kept) that spans the lifetime of the object
+class scope_t {
+  protected:
+    const char *name_;
+    double begin_;
+
+  public:
+    scope_t(const char *name) : name_(name), begin_(0) {
+        if( enabled() ) begin_ = Utils::read_monotonic_time();
+        else name_ = 0;
+    }
+    ~scope_t() {
+        if( name_ != 0 ) local().push(name_, begin_, Utils::read_monotonic_time());
+    }
+};
+
+}; // namespace Trace
+
+#undef DEBUG
+
+#endif
+
@@ -20,6 +20,7 @@
 #define UCT_H
 
 #include "policy.h"
+#include "parallel.h"
 
 #include <iostream>
 #include <sstream>
@@ -59,7 +60,7 @@ template<typename T> struct node_t {
 
 template<typename T> struct map_functions_t {
     size_t operator()(const std::pair<unsigned, T> &p) const {
-        return p.second.hash();
+        return Hash::combine(p.second.hash(), p.first);
     }
 };
 
@@ -110,36 +111,76 @@ template<typename T> class uct_t : public improvement_t<T> {
     unsigned horizon_;
     float parameter_;
     bool random_ties_;
+    unsigned batch_size_;
+    unsigned num_threads_;
+    float virtual_loss_;
     mutable hash_t<T> table_;
+    mutable Hash::bucket_stats_t table_stats_;
+
+    // batched evaluation of leaves: a step in the path from the root to
+    // a new leaf, and the leaf itself with the data required for backup
+    struct step_t {
+        data_t *data_;
+        Problem::action_t action_;
+        float cost_;
+        int count_;
+        float value_before_loss_;
+        step_t(data_t *data, Problem::action_t action, float cost, int count, float value)
+          : data_(data), action_(action), cost_(cost), count_(count), value_before_loss_(value) { }
+    };
+    struct leaf_t {
+        std::vector<step_t> path_;
+        T state_;
+        unsigned depth_;
+        bool needs_evaluation_;
+        unsigned long long seed_;
+        float value_;
+    };
+    mutable std::vector<leaf_t> leaves_;
+    mutable Parallel::thread_pool_t *pool_;
+    mutable std::vector<const policy_t<T>*> worker_policies_;
 
     uct_t(const Problem::problem_t<T> &problem,
           const policy_t<T> *base_policy,
           unsigned width,
           unsigned horizon,
           float parameter,
-          bool random_ties)
+          bool random_ties,
+          unsigned batch_size,
+          unsigned num_threads,
+          float virtual_loss)
       : improvement_t<T>(problem, base_policy),
         width_(width),
         horizon_(horizon),
         parameter_(parameter),
-        random_ties_(random_ties) {
+        random_ties_(random_ties),
+        batch_size_(batch_size),
+        num_threads_(num_threads),
+        virtual_loss_(virtual_loss),
+        pool_(0) {
     }
 
   public:
     uct_t(const Problem::problem_t<T> &problem)
       : improvement_t<T>(problem, 0),
-        width_(0), horizon_(0), parameter_(0), random_ties_(false) {
+        width_(0), horizon_(0), parameter_(0), random_ties_(false),
+        batch_size_(1), num_threads_(1), virtual_loss_(0), pool_(0) {
+    }
+    virtual ~uct_t() {
+        clear_workers();
     }
-    virtual ~uct_t() { }
     virtual policy_t<T>* clone() const {
-        return new uct_t(problem_, base_policy_, width_, horizon_, parameter_, random_ties_);
+        return new uct_t(problem_, base_policy_, width_, horizon_, parameter_, random_ties_, batch_size_, num_threads_, virtual_loss_);
     }
     virtual std::string name() const {
         return std::string("uct(policy=") + (base_policy_ == 0 ? std::string("null") : base_policy_->name()) +
           std::string(",width=") + std::to_string(width_) +
           std::string(",horizon=") + std::to_string(horizon_) +
           std::string(",parameter=") + std::to_string(parameter_) +
-          std::string(",random-ties=") + (random_ties_ ? "true" : "false") + ")";
+          std::string(",random-ties=") + (random_ties_ ? "true" : "false") +
+          std::string(",batch=") + std::to_string(batch_size_) +
+          std::string(",threads=") + std::to_string(num_threads_) +
+          std::string(",virtual-loss=") + std::to_string(virtual_loss_) + ")";
     }
 
     virtual Problem::action_t operator()(const T &s) const {
@@ -152,9 +193,19 @@ template<typename T> class uct_t : public improvement_t<T> {
         if( horizon_ == 0 ) {
             return (*base_policy_)(s);
         } else {
+            if( Hash::stats_enabled() ) table_stats_.add(table_);
             table_.clear();
-            for( unsigned i = 0; i < width_; ++i )
-                search_tree(s, 0);
+            if( batch_size_ <= 1 ) {
+                for( unsigned i = 0; i < width_; ++i ) {
+                    search_tree(s, 0);
+                    COUNT(Trials);
+                }
+            } else {
+                for( unsigned i = 0; i < width_; i += batch_size_ ) {
+                    search_tree_batch(s, Utils::min(batch_size_, width_ - i));
+                    COUNT_ADD(Trials, Utils::min(batch_size_, width_ - i));
+                }
+            }
             typename hash_t<T>::iterator it = table_.find(std::make_pair(0, s));
             assert(it != table_.end());
             Problem::action_t action = select_action(s, it->second, 0, false, random_ties_);
@@ -167,6 +218,7 @@ template<typename T> class uct_t : public improvement_t<T> {
         policy_t<T>::base_policy_time_ = 0;
         policy_t<T>::heuristic_time_ = 0;
         problem_.clear_expansions();
+        table_stats_.clear();
         if( base_policy_ != 0 ) base_policy_->reset_stats();
     }
     virtual void print_other_stats(std::ostream &os, int indent) const {
@@ -174,8 +226,14 @@ template<typename T> class uct_t : public improvement_t<T> {
            << "other-stats: name=" << name()
            << " decisions=" << policy_t<T>::decisions_
            << std::endl;
+        if( Hash::stats_enabled() ) table_stats_.with(table_).print(os, 2 + indent, "uct");
         if( base_policy_ != 0 ) base_policy_->print_other_stats(os, 2 + indent);
     }
+    virtual void record_other_stats(Stats::record_t &record, const std::string &prefix) const {
+        policy_t<T>::record_other_stats(record, prefix);
+        if( Hash::stats_enabled() ) table_stats_.with(table_).record(record, prefix + "hash.");
+        if( base_policy_ != 0 ) base_policy_->record_other_stats(record, prefix + "base.");
+    }
     virtual void set_parameters(const std::multimap<std::string, std::string> &parameters, Dispatcher::dispatcher_t<T> &dispatcher) {
         std::multimap<std::string, std::string>::const_iterator it = parameters.find("width");
         if( it != parameters.end() ) width_ = strtol(it->second.c_str(), 0, 0);
@@ -185,12 +243,23 @@ template<typename T> class uct_t : public improvement_t<T> {
         if( it != parameters.end() ) parameter_ = strtod(it->second.c_str(), 0);
         it = parameters.find("random-ties");
         if( it != parameters.end() ) random_ties_ = it->second == "true";
+        it = parameters.find("batch");
+        if( it != parameters.end() ) batch_size_ = strtol(it->second.c_str(), 0, 0);
+        it = parameters.find("threads");
+        if( it != parameters.end() ) num_threads_ = strtol(it->second.c_str(), 0, 0);
+        if( (num_threads_ > 1) && !problem_.concurrent() ) {
+            std::cout << Utils::error() << "uct() policy with threads > 1 requires a problem that supports concurrent calls!" << std::endl;
+            exit(1);
+        }
+        it = parameters.find("virtual-loss");
+        if( it != parameters.end() ) virtual_loss_ = strtod(it->second.c_str(), 0);
         it = parameters.find("policy");
         if( it != parameters.end() ) {
             delete base_policy_;
             dispatcher.create_request(problem_, it->first, it->second);
             base_policy_ = dispatcher.fetch_policy(it->second);
         }
+        clear_workers();
         policy_t<T>::setup_time_ = base_policy_ == 0 ? 0 : base_policy_->setup_time();
 #ifdef DEBUG
         std::cout << "debug: uct(): params:"
@@ -198,6 +267,9 @@ template<typename T> class uct_t : public improvement_t<T> {
                   << " horizon=" << horizon_
                   << " parameter=" << parameter_
                   << " random-ties=" << (random_ties_ ? "true" : "false")
+                  << " batch=" << batch_size_
+                  << " threads=" << num_threads_
+                  << " virtual-loss=" << virtual_loss_
                   << " policy=" << (base_policy_ == 0 ? std::string("null") : base_policy_->name())
                   << std::endl;
 #endif
@@ -246,6 +318,7 @@ template<typename T> class uct_t : public improvement_t<T> {
             std::vector<float> values(1 + problem_.number_actions(s), 0);
             std::vector<int> counts(1 + problem_.number_actions(s), 0);
             table_.insert(std::make_pair(std::make_pair(depth, s), data_t(values, counts)));
+            COUNT(Expansions);
             float value = evaluate(s, depth);
 #ifdef DEBUG
             std::cout << " insert in tree w/ value=" << value << std::endl;
@@ -284,33 +357,33 @@ template<typename T> class uct_t : public improvement_t<T> {
                                     bool add_bonus,
                                     bool random_ties) const {
         float log_ns = logf(data.counts_[0]);
-        std::vector<Problem::action_t> best_actions;
-        int nactions = problem_.number_actions(state);
+        std::vector<Problem::action_t> actions, best_actions;
         float best_value = std::numeric_limits<float>::max();
 
-        best_actions.reserve(random_ties ? nactions : 1);
-        for( Problem::action_t a = 0; a < nactions; ++a ) {
-            if( problem_.applicable(state, a) ) {
-                // if this action has never been taken in this node, select it
-                if( data.counts_[1+a] == 0 ) {
-                    return a;
-                }
+        problem_.applicable_actions(state, actions);
+        best_actions.reserve(random_ties ? actions.size() : 1);
+        for( size_t k = 0, ksz = actions.size(); k < ksz; ++k ) {
+            Problem::action_t a = actions[k];
+
+            // if this action has never been taken in this node, select it
+            if( data.counts_[1+a] == 0 ) {
+                return a;
+            }
 
-                // compute score of action adding bonus (if applicable)
-                assert(data.counts_[0] > 0);
-                float par = parameter_ == 0 ? -data.values_[1+a] : parameter_;
-                float bonus = add_bonus ? par * sqrtf(2 * log_ns / data.counts_[1+a]) : 0;
-                float value = data.values_[1+a] + bonus;
-
-                // update best action so far
-                if( value <= best_value ) {
-                    if( value < best_value ) {
-                        best_value = value;
-                        best_actions.clear();
-                    }
-                    if( random_ties || best_actions.empty() )
-                        best_actions.push_back(a);
+            // compute score of action adding bonus (if applicable)
+            assert(data.counts_[0] > 0);
+            float par = parameter_ == 0 ? -data.values_[1+a] : parameter_;
+            float bonus = add_bonus ? par * sqrtf(2 * log_ns / data.counts_[1+a]) : 0;
+            float value = data.values_[1+a] + bonus;
+
+            // update best action so far
+            if( value <= best_value ) {
+                if( value < best_value ) {
+                    best_value = value;
+                    best_actions.clear();
                 }
+                if( random_ties || best_actions.empty() )
+                    best_actions.push_back(a);
             }
         }
         assert(!best_actions.empty());
@@ -319,10 +392,121 @@ template<typename T> class uct_t : public improvement_t<T> {
 
     float evaluate(const T &s, unsigned depth) const {
         assert(base_policy_ != 0);
-        float start_time = Utils::read_time_in_seconds();
-        float value = Evaluation::evaluation(*base_policy_, s, 1, horizon_ - depth);
-        policy_t<T>::base_policy_time_ += Utils::read_time_in_seconds() - start_time;
-        return value;
+        Utils::sampled_timer_t timer(policy_t<T>::base_policy_time_, policy_t<T>::base_policy_calls_++);
+        Trace::scope_t scope("rollout");
+        COUNT(Rollouts);
+        return Evaluation::evaluation(*base_policy_, s, 1, horizon_ - depth);
+    }
+
+    // Batched version of search_tree(): descend batch_size times from the
+    // root collecting the new leaves, evaluate all of them at once (in
+    // parallel when threads > 1), and then back up the values in the same
+    // order as the descents. Pending visits increase counts during the
+    // descents and, if virtual_loss > 0, temporarily increase the value of
+    // the selected actions so that concurrent descents spread out.
+    void search_tree_batch(const T &s, unsigned batch_size) const {
+        Trace::scope_t scope("expansion-batch");
+        if( leaves_.size() < batch_size ) leaves_.resize(batch_size);
+        for( unsigned i = 0; i < batch_size; ++i )
+            select_leaf(s, leaves_[i]);
+
+        // remove virtual losses in reverse order so values are restored exactly
+        if( virtual_loss_ != 0 ) {
+            for( unsigned i = batch_size; i > 0; --i ) {
+                const std::vector<step_t> &path = leaves_[i - 1].path_;
+                for( unsigned k = 0; k < path.size(); ++k )
+                    path[k].data_->values_[1+path[k].action_] = path[k].value_before_loss_;
+            }
+        }
+
+        evaluate_leaves(batch_size);
+
+        for( unsigned i = 0; i < batch_size; ++i ) {
+            const leaf_t &leaf = leaves_[i];
+            float new_value = leaf.value_;
+            for( unsigned k = leaf.path_.size(); k > 0; --k ) {
+                const step_t &step = leaf.path_[k - 1];
+                new_value = step.cost_ + problem_.discount() * new_value;
+                float &old_value = step.data_->values_[1+step.action_];
+                old_value += (new_value - old_value) / step.count_;
+            }
+        }
+    }
+
+    void select_leaf(const T &s, leaf_t &leaf) const {
+        T state = s;
+        unsigned depth = 0;
+        leaf.path_.clear();
+        leaf.needs_evaluation_ = false;
+        leaf.value_ = 0;
+        for( ;; ) {
+            if( (depth == horizon_) || problem_.terminal(state) ) {
+                leaf.value_ = 0;
+                return;
+            }
+
+            if( problem_.dead_end(state) ) {
+                leaf.value_ = problem_.dead_end_value();
+                return;
+            }
+
+            typename hash_t<T>::iterator it = table_.find(std::make_pair(depth, state));
+            if( it == table_.end() ) {
+                std::vector<float> values(1 + problem_.number_actions(state), 0);
+                std::vector<int> counts(1 + problem_.number_actions(state), 0);
+                table_.insert(std::make_pair(std::make_pair(depth, state), data_t(values, counts)));
+                COUNT(Expansions);
+                leaf.state_ = state;
+                leaf.depth_ = depth;
+                leaf.needs_evaluation_ = true;
+                leaf.seed_ = Random::seed48();
+                return;
+            }
+
+            // select action for this node, increase counts and apply virtual loss
+            Problem::action_t a = select_action(state, it->second, depth, true, random_ties_);
+            ++it->second.counts_[0];
+            ++it->second.counts_[1+a];
+            float &value = it->second.values_[1+a];
+            leaf.path_.push_back(step_t(&it->second, a, problem_.cost(state, a), it->second.counts_[1+a], value));
+            value += virtual_loss_;
+
+            std::pair<const T, bool> p = problem_.sample(state, a);
+            state = p.first;
+            ++depth;
+        }
+    }
+
+    void evaluate_leaves(unsigned batch_size) const {
+        assert(base_policy_ != 0);
+        setup_workers();
+        Utils::scoped_timer_t timer(policy_t<T>::base_policy_time_);
+        pool_->run(batch_size, [&](unsigned job, unsigned worker) {
+            leaf_t &leaf = leaves_[job];
+            if( leaf.needs_evaluation_ ) {
+                Random::scoped_stream_t stream(leaf.seed_);
+                Trace::scope_t scope("rollout");
+                COUNT(Rollouts);
+                leaf.value_ = Evaluation::evaluation(*worker_policies_[worker], leaf.state_, 1, horizon_ - leaf.depth_);
+            }
+        });
+    }
+
+    // each worker thread evaluates leaves with its own copy of base policy
+    void setup_workers() const {
+        if( pool_ == 0 ) {
+            pool_ = new Parallel::thread_pool_t(Utils::max(1u, num_threads_));
+            worker_policies_.push_back(base_policy_);
+            for( unsigned worker = 1; worker < pool_->num_threads(); ++worker )
+                worker_policies_.push_back(base_policy_->clone());
+        }
+    }
+    void clear_workers() const {
+        for( unsigned worker = 1; worker < worker_policies_.size(); ++worker )
+            delete worker_policies_[worker];
+        worker_policies_.clear();
+        delete pool_;
+        pool_ = 0;
     }
 };
 
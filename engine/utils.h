@@ -19,13 +19,16 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <atomic>
 #include <cassert>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <math.h>
 
 #include <sys/resource.h>
 #include <sys/time.h>
+#include <time.h>
 
 #include "random.h"
 
@@ -34,6 +37,7 @@
 namespace Utils {
 
 extern bool g_use_colors;
+extern unsigned g_timer_period;
 
 #if 0 // kappa stuff
 extern float kappa_log;
@@ -63,6 +67,71 @@ inline float read_time_in_seconds() {
     return time;
 }
 
+// Monotonic (wall-clock) time in seconds. clock_gettime() is served by the
+// vDSO without entering the kernel, so this is cheap enough for timing
+// hot paths, and time stats use it throughout so that they can be
+// subtracted from each other.
+inline double read_monotonic_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Adds the monotonic time elapsed in its scope to the accumulator
+class scoped_timer_t {
+    float &accumulator_;
+    double start_time_;
+
+  public:
+    scoped_timer_t(float &accumulator)
+      : accumulator_(accumulator), start_time_(read_monotonic_time()) {
+    }
+    ~scoped_timer_t() {
+        accumulator_ += read_monotonic_time() - start_time_;
+    }
+};
+
+// Scoped timer that only times one out of every g_timer_period calls, as
+// given by the number of the call, and adds the elapsed time scaled by the
+// period as an estimate of the time of all of them. Accumulators shared by
+// threads (e.g. of heuristics) are atomic.
+class sampled_timer_t {
+    float *accumulator_;
+    std::atomic<float> *shared_accumulator_;
+    unsigned period_;
+    double start_time_;
+
+    bool sampled(size_t call) const {
+        return (period_ <= 1) || (call % period_ == 0);
+    }
+
+  public:
+    sampled_timer_t(float &accumulator, size_t call)
+      : accumulator_(0), shared_accumulator_(0), period_(g_timer_period), start_time_(0) {
+        if( sampled(call) ) {
+            accumulator_ = &accumulator;
+            start_time_ = read_monotonic_time();
+        }
+    }
+    sampled_timer_t(std::atomic<float> &accumulator, size_t call)
+      : accumulator_(0), shared_accumulator_(0), period_(g_timer_period), start_time_(0) {
+        if( sampled(call) ) {
+            shared_accumulator_ = &accumulator;
+            start_time_ = read_monotonic_time();
+        }
+    }
+    ~sampled_timer_t() {
+        if( (accumulator_ == 0) && (shared_accumulator_ == 0) ) return;
+        float elapsed = (period_ <= 1 ? 1 : period_) * (read_monotonic_time() - start_time_);
+        if( accumulator_ != 0 ) {
+            *accumulator_ += elapsed;
+        } else {
+            float value = shared_accumulator_->load();
+            while( !shared_accumulator_->compare_exchange_weak(value, value + elapsed) );
+        }
+    }
+};
+
 template<typename T> inline T min(const T a, const T b) {
     return a <= b ? a : b;
 }
@@ -75,6 +144,16 @@ template<typename T> inline T abs(const T a) {
     return a < 0 ? -a : a;
 }
 
+// number of bytes with an optional suffix K, M or G (powers of 1024)
+inline size_t parse_bytes(const std::string &str) {
+    char *end = 0;
+    double bytes = strtod(str.c_str(), &end);
+    if( (*end == 'k') || (*end == 'K') ) bytes *= 1024.0;
+    else if( (*end == 'm') || (*end == 'M') ) bytes *= 1024.0 * 1024.0;
+    else if( (*end == 'g') || (*end == 'G') ) bytes *= 1024.0 * 1024.0 * 1024.0;
+    return size_t(bytes);
+}
+
 inline void split_request(const std::string &request, std::string &name, std::string &parameter_str) {
     size_t first = request.find_first_of("(");
     size_t last = request.find_last_of(")");
@@ -180,6 +259,79 @@ inline void stochastic_universal_sampling(int n, const float *cdf, int k, std::v
     assert(k == int(indices.size()));
 }
 
+// Accumulator of the mean and variance of a stream of values (Welford's
+// method), which is numerically stable and needs no storage
+class mean_variance_t {
+    unsigned n_;
+    double mean_;
+    double m2_;
+
+  public:
+    mean_variance_t() : n_(0), mean_(0), m2_(0) { }
+
+    void clear() {
+        n_ = 0;
+        mean_ = 0;
+        m2_ = 0;
+    }
+    void add(double x) {
+        ++n_;
+        double delta = x - mean_;
+        mean_ += delta / n_;
+        m2_ += delta * (x - mean_);
+    }
+
+    unsigned n() const { return n_; }
+    double mean() const { return mean_; }
+    double variance() const { return n_ < 2 ? 0 : m2_ / (n_ - 1); }
+    double stdev() const { return sqrt(variance()); }
+    double stderror() const { return n_ == 0 ? 0 : stdev() / sqrt(double(n_)); }
+};
+
+// Quantile of the standard normal distribution (Acklam's approximation,
+// relative error < 1.2e-9)
+inline double normal_quantile(double p) {
+    assert((0 < p) && (p < 1));
+    static const double a[] = { -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                                1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+    static const double b[] = { -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                                6.680131188771972e+01, -1.328068155288572e+01 };
+    static const double c[] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                                -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+    static const double d[] = { 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                                3.754408661907416e+00 };
+    if( p < 0.02425 ) {
+        double q = sqrt(-2 * log(p));
+        return (((((c[0]*q+c[1])*q+c[2])*q+c[3])*q+c[4])*q+c[5]) / ((((d[0]*q+d[1])*q+d[2])*q+d[3])*q+1);
+    } else if( p <= 1 - 0.02425 ) {
+        double q = p - 0.5, r = q * q;
+        return (((((a[0]*r+a[1])*r+a[2])*r+a[3])*r+a[4])*r+a[5])*q / (((((b[0]*r+b[1])*r+b[2])*r+b[3])*r+b[4])*r+1);
+    } else {
+        double q = sqrt(-2 * log(1 - p));
+        return -(((((c[0]*q+c[1])*q+c[2])*q+c[3])*q+c[4])*q+c[5]) / ((((d[0]*q+d[1])*q+d[2])*q+d[3])*q+1);
+    }
+}
+
+// Quantile of Student's t distribution with dof degrees of freedom, from
+// the normal quantile with the Cornish-Fisher expansion (accurate to about
+// 1e-3 for dof >= 5)
+inline double student_t_quantile(double p, unsigned dof) {
+    assert(dof > 0);
+    double z = normal_quantile(p), z2 = z * z, v = dof;
+    double g1 = (z2 + 1) * z / 4;
+    double g2 = ((5 * z2 + 16) * z2 + 3) * z / 96;
+    double g3 = (((3 * z2 + 19) * z2 + 17) * z2 - 15) * z / 384;
+    double g4 = ((((79 * z2 + 776) * z2 + 1482) * z2 - 1920) * z2 - 945) * z / 92160;
+    return z + g1 / v + g2 / (v * v) + g3 / (v * v * v) + g4 / (v * v * v * v);
+}
+
+// Half-width of the confidence interval for the mean of the accumulated
+// values with the given confidence level (e.g. 0.95)
+inline double confidence_halfwidth(const mean_variance_t &stats, double confidence) {
+    if( stats.n() < 2 ) return std::numeric_limits<double>::infinity();
+    return student_t_quantile((1 + confidence) / 2, stats.n() - 1) * stats.stderror();
+}
+
 }; // end of namespace
 
 #undef DEBUG
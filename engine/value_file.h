@@ -0,0 +1,300 @@
+/*
+ *  Copyright (c) 2011-2016 Universidad Simon Bolivar
+ *
+ *  Permission is hereby granted to distribute this software for
+ *  non-commercial research purposes, provided that this copyright
+ *  notice is included with any such distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ *  EITHER EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE.  THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE
+ *  SOFTWARE IS WITH YOU.  SHOULD THE PROGRAM PROVE DEFECTIVE, YOU
+ *  ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ *
+ *  Blai Bonet, bonet@ldc.usb.ve
+ *
+ */
+
+#ifndef VALUE_FILE_H
+#define VALUE_FILE_H
+
+#include "problem.h"
+#include "utils.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//#define DEBUG
+
+// Value files store a hash table of values (value, best action and solved
+// label of each state) so that a solution computed once can be reused by
+// other runs. The file is an open-addressing table with fixed-size records
+// keyed by the serialized states, so it is used in place through a
+// read-only memory map: there is nothing to rebuild when it is opened, and
+// processes that map the same file share its pages in the page cache.
+//
+// Layout: header_t, then num_buckets_ records of record_size_ bytes each,
+// made of a record_t followed by the state bytes (padded to 8 bytes).
+// Files are written in the byte order of the host and rejected elsewhere.
+
+namespace ValueFile {
+
+const char magic[8] = { 'M', 'D', 'P', 'V', 'A', 'L', 'U', 'E' };
+const uint32_t version = 1;
+const uint32_t byte_order = 0x01020304;
+
+struct header_t {
+    char magic_[8];
+    uint32_t version_;
+    uint32_t byte_order_;
+    uint32_t state_size_;
+    uint32_t record_size_;
+    uint64_t num_records_;
+    uint64_t num_buckets_;  // power of two
+    uint64_t data_offset_;
+    uint64_t reserved_[2];
+};
+
+struct record_t {
+    enum { Used = 1, Solved = 2 };
+    uint64_t hash_;         // hash of the state bytes
+    float value_;
+    int32_t action_;
+    uint32_t flags_;
+    uint32_t reserved_;
+
+    bool used() const { return (flags_ & Used) != 0; }
+    bool solved() const { return (flags_ & Solved) != 0; }
+    const char* state() const { return reinterpret_cast<const char*>(this + 1); }
+    char* state() { return reinterpret_cast<char*>(this + 1); }
+};
+
+inline uint32_t record_size(size_t state_size) {
+    return sizeof(record_t) + ((state_size + 7) & ~size_t(7));
+}
+
+// FNV-1a with a final mix so that the low bits, which select the bucket,
+// depend on all bytes of the state
+inline uint64_t hash_bytes(const char *bytes, size_t size) {
+    uint64_t h = 14695981039346656037ULL;
+    for( size_t i = 0; i < size; ++i ) {
+        h ^= (unsigned char)bytes[i];
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Write the states in the hash table to a value file. States without a
+// stored action get the greedy action with respect to the table. The file
+// is written under a temporary name and renamed, so processes that have
+// the old file mapped keep reading a consistent table.
+template<typename T> bool save(const Problem::hash_t<T> &hash, const std::string &filename) {
+    const Problem::problem_t<T> &problem = hash.problem();
+    size_t state_size = problem.state_size();
+    if( state_size == 0 ) {
+        std::cout << Utils::error() << "value-file: problem doesn't support serialization of states" << std::endl;
+        return false;
+    }
+
+    header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic_, magic, sizeof(magic));
+    header.version_ = version;
+    header.byte_order_ = byte_order;
+    header.state_size_ = state_size;
+    header.record_size_ = record_size(state_size);
+
+    // states spilled to the cold store of the table are included; greedy
+    // actions are computed afterwards as they may fault states in
+    std::vector<char> records;
+    std::vector<std::pair<size_t, T> > greedy;
+    records.reserve(hash.size() * header.record_size_);
+    hash.for_each([&](const T &s, const Hash::data_t &data) {
+        size_t offset = records.size();
+        records.resize(offset + header.record_size_, 0);
+        record_t *record = reinterpret_cast<record_t*>(&records[offset]);
+        problem.serialize(s, record->state());
+        record->hash_ = hash_bytes(record->state(), state_size);
+        record->value_ = data.value();
+        record->action_ = data.action();
+        record->flags_ = record_t::Used | (data.solved() ? record_t::Solved : 0);
+        if( (data.action() == Problem::noop) && !problem.terminal(s) && !problem.dead_end(s) )
+            greedy.push_back(std::make_pair(offset, s));
+    });
+    for( size_t i = 0; i < greedy.size(); ++i )
+        reinterpret_cast<record_t*>(&records[greedy[i].first])->action_ = hash.best_q_value(greedy[i].second).first;
+
+    header.num_records_ = records.size() / header.record_size_;
+    header.num_buckets_ = 2;
+    while( header.num_buckets_ < 2 * header.num_records_ ) header.num_buckets_ <<= 1;
+    header.data_offset_ = sizeof(header_t);
+
+    std::vector<char> data(header.num_buckets_ * header.record_size_, 0);
+    uint64_t mask = header.num_buckets_ - 1;
+    for( size_t offset = 0; offset < records.size(); offset += header.record_size_ ) {
+        const record_t *record = reinterpret_cast<const record_t*>(&records[offset]);
+        uint64_t bucket = record->hash_ & mask;
+        while( reinterpret_cast<const record_t*>(&data[bucket * header.record_size_])->used() )
+            bucket = (1 + bucket) & mask;
+        memcpy(&data[bucket * header.record_size_], record, header.record_size_);
+    }
+
+    std::string tmp_filename = filename + ".tmp";
+    std::ofstream os(tmp_filename.c_str(), std::ios::binary);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(&data[0], data.size());
+    os.close();
+    if( !os || (rename(tmp_filename.c_str(), filename.c_str()) != 0) ) {
+        std::cout << Utils::error() << "value-file: cannot write '" << filename << "'" << std::endl;
+        unlink(tmp_filename.c_str());
+        return false;
+    }
+    std::cout << "value-file: saved " << header.num_records_ << " state(s) in '" << filename << "'" << std::endl;
+    return true;
+}
+
+// Read-only view of a value file
+template<typename T> class table_t {
+  protected:
+    const Problem::problem_t<T> &problem_;
+    std::string filename_;
+    const char *map_;
+    size_t map_size_;
+    const header_t *header_;
+    const char *data_;
+    uint64_t mask_;
+
+    table_t(const table_t &table);
+
+  public:
+    table_t(const Problem::problem_t<T> &problem)
+      : problem_(problem), map_(0), map_size_(0), header_(0), data_(0), mask_(0) {
+    }
+    ~table_t() { close(); }
+
+    const std::string& filename() const { return filename_; }
+    bool is_open() const { return map_ != 0; }
+    size_t size() const { return header_ == 0 ? 0 : header_->num_records_; }
+    size_t num_buckets() const { return header_ == 0 ? 0 : header_->num_buckets_; }
+    const record_t* bucket(size_t i) const {
+        return reinterpret_cast<const record_t*>(data_ + i * header_->record_size_);
+    }
+
+    // map the file; on errors, a message is printed and false is returned
+    bool open(const std::string &filename) {
+        close();
+        filename_ = filename;
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        struct stat st;
+        if( (fd == -1) || (fstat(fd, &st) != 0) ) {
+            std::cout << Utils::error() << "value-file: cannot open '" << filename << "'" << std::endl;
+            if( fd != -1 ) ::close(fd);
+            return false;
+        }
+        if( size_t(st.st_size) < sizeof(header_t) ) {
+            std::cout << Utils::error() << "value-file: '" << filename << "' is not a value file" << std::endl;
+            ::close(fd);
+            return false;
+        }
+        void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if( map == MAP_FAILED ) {
+            std::cout << Utils::error() << "value-file: cannot map '" << filename << "'" << std::endl;
+            return false;
+        }
+        map_ = static_cast<const char*>(map);
+        map_size_ = st.st_size;
+        header_ = reinterpret_cast<const header_t*>(map_);
+
+        std::string reason;
+        if( memcmp(header_->magic_, magic, sizeof(magic)) != 0 )
+            reason = "is not a value file";
+        else if( header_->version_ != version )
+            reason = "has version " + std::to_string(header_->version_) + " (expected " + std::to_string(version) + ")";
+        else if( header_->byte_order_ != byte_order )
+            reason = "was written on a host with another byte order";
+        else if( header_->state_size_ != problem_.state_size() )
+            reason = "has states of " + std::to_string(header_->state_size_) + " bytes (expected " + std::to_string(problem_.state_size()) + ")";
+        else if( (header_->record_size_ != record_size(header_->state_size_)) ||
+                 (header_->num_buckets_ == 0) || ((header_->num_buckets_ & (header_->num_buckets_ - 1)) != 0) ||
+                 (header_->data_offset_ + header_->num_buckets_ * header_->record_size_ != map_size_) )
+            reason = "is truncated or corrupt";
+        if( !reason.empty() ) {
+            std::cout << Utils::error() << "value-file: '" << filename << "' " << reason << std::endl;
+            close();
+            return false;
+        }
+
+        data_ = map_ + header_->data_offset_;
+        mask_ = header_->num_buckets_ - 1;
+        madvise(const_cast<char*>(map_), map_size_, MADV_RANDOM);
+#ifdef DEBUG
+        std::cout << "debug: value-file: mapped '" << filename << "': #records=" << size() << ", #buckets=" << num_buckets() << std::endl;
+#endif
+        return true;
+    }
+
+    void close() {
+        if( map_ != 0 ) munmap(const_cast<char*>(map_), map_size_);
+        map_ = 0;
+        map_size_ = 0;
+        header_ = 0;
+        data_ = 0;
+        mask_ = 0;
+    }
+
+    // record of the state, or 0 if the state isn't in the file
+    const record_t* find(const T &s) const {
+        if( map_ == 0 ) return 0;
+        static thread_local std::vector<char> bytes;
+        size_t state_size = header_->state_size_;
+        bytes.resize(state_size);
+        problem_.serialize(s, &bytes[0]);
+        uint64_t h = hash_bytes(&bytes[0], state_size);
+        for( uint64_t i = h & mask_; ; i = (1 + i) & mask_ ) {
+            const record_t *record = bucket(i);
+            if( !record->used() ) return 0;
+            if( (record->hash_ == h) && (memcmp(record->state(), &bytes[0], state_size) == 0) )
+                return record;
+        }
+    }
+
+    void dump(std::ostream &os) const {
+        for( size_t i = 0; i < num_buckets(); ++i ) {
+            const record_t *record = bucket(i);
+            if( record->used() ) {
+                T s;
+                if( problem_.deserialize(record->state(), s) )
+                    os << s;
+                else
+                    os << "#" << record->hash_;
+                os << " : (" << record->value_
+                   << ", " << (record->solved() ? 1 : 0)
+                   << ", " << record->action_
+                   << ")" << std::endl;
+            }
+        }
+    }
+};
+
+}; // namespace ValueFile
+
+#undef DEBUG
+
+#endif
+
@@ -21,7 +21,6 @@
 
 #include "algorithm.h"
 
-#include <list>
 #include <string>
 #include <vector>
 
@@ -35,32 +34,36 @@ template<typename T> struct state_space_t {
     state_space_t(const Problem::problem_t<T> &problem) : problem_(problem) {
     }
 
+    // Breadth-first generation of the states reachable from s. The open
+    // queue holds interned ids; in a cleared table, the ids of the states
+    // follow the order in which they were found.
     void generate_space(const T &s, Problem::hash_t<T> &hash) {
-        std::list<std::pair<T, Hash::data_t*> > open;
+        std::vector<unsigned> open;
+        Hash::id_array_t<bool> marked(false);
 
         std::vector<std::pair<T, float> > outcomes;
-        Hash::data_t *dptr = hash.data_ptr(s);
-        open.push_back(std::make_pair(s, dptr));
-        dptr->mark();
+        unsigned id = hash.intern(s);
+        open.push_back(id);
+        marked.set(id, true);
 
 #ifdef DEBUG
         std::cout << "debug: generate-space(): marking " << s << std::endl;
 #endif
 
-        while( !open.empty() ) {
-            std::pair<T, Hash::data_t*> n = open.front();
-            open.pop_front();
-            if( problem_.terminal(n.first) ) continue;
+        for( size_t head = 0; head < open.size(); ++head ) {
+            const T &t = hash.state(open[head]);
+            if( problem_.terminal(t) ) continue;
 
-            for( Problem::action_t a = 0; a < problem_.number_actions(n.first); ++a ) {
-                if( problem_.applicable(n.first, a) ) {
-                    problem_.next(n.first, a, outcomes);
+            for( Problem::action_t a = 0; a < problem_.number_actions(t); ++a ) {
+                if( problem_.applicable(t, a) ) {
+                    COUNT(NextAlgorithm);
+                    problem_.next(t, a, outcomes);
                     unsigned osize = outcomes.size();
                     for( unsigned i = 0; i < osize; ++i ) {
-                        Hash::data_t *ptr = hash.data_ptr(outcomes[i].first);
-                        if( !ptr->marked() ) {
-                            open.push_back(std::make_pair(outcomes[i].first, ptr));
-                            ptr->mark();
+                        unsigned oid = hash.intern(outcomes[i].first);
+                        if( !marked[oid] ) {
+                            open.push_back(oid);
+                            marked.set(oid, true);
 #ifdef DEBUG
                             std::cout << "debug: generate-space(): marking " << outcomes[i].first << std::endl;
 #endif
@@ -69,7 +72,6 @@ template<typename T> struct state_space_t {
                 }
             }
         }
-        hash.unmark_all();
     }
 };
 
@@ -78,8 +80,6 @@ template<typename T> class value_iteration_t : public algorithm_t<T> {
   using algorithm_t<T>::heuristic_;
   using algorithm_t<T>::seed_;
   protected:
-    typedef typename Problem::hash_t<T>::iterator hash_iterator;
-
     float epsilon_;
     unsigned max_number_iterations_;
 
@@ -150,17 +150,20 @@ template<typename T> class value_iteration_t : public algorithm_t<T> {
         while( residual > epsilon_ ) {
             if( iters > max_number_iterations_ ) break;
             residual = 0;
-            for( hash_iterator hi = hash.begin(); hi != hash.end(); ++hi ) {
-                float hv = hi->second->value();
-                std::pair<Problem::action_t, float> p = hash.best_q_value(hi->first);
+            // sweep in reverse id order, so that the states far from s
+            // are updated first
+            for( unsigned id = hash.num_interned(); id-- > 0; ) {
+                Hash::data_t *dptr = hash.data(id);
+                float hv = dptr->value();
+                std::pair<Problem::action_t, float> p = hash.best_q_value(hash.state(id));
                 float res = (float)fabs(p.second - hv);
                 residual = Utils::max(residual, res);
-                hi->second->update(p.second);
+                dptr->update(p.second);
                 hash.inc_updates();
 
 #ifdef DEBUG
                 if( res > epsilon_ ) {
-                    std::cout << "debug: value-iteration(): value for " << hi->first
+                    std::cout << "debug: value-iteration(): value for " << hash.state(id)
                               << " changed from " << hv
                               << " to " << p.second
                               << std::endl;
@@ -168,6 +171,7 @@ template<typename T> class value_iteration_t : public algorithm_t<T> {
 #endif
             }
             ++iters;
+            COUNT(Iterations);
 
 #ifdef DEBUG
             std::cout << "debug: value-iteration(): residual=" << residual << std::endl;
@@ -33,7 +33,7 @@ class state_t {
     state_t(unsigned d0 = 0, unsigned d1 = 0, unsigned d2 = 0) : d0_(d0), d1_(d1), d2_(d2) { }
     state_t(const state_t &s) : d0_(s.d0_), d1_(s.d1_), d2_(s.d2_) { }
     ~state_t() { }
-    size_t hash() const { return d1_ ^ d2_; }
+    size_t hash() const { return (size_t(d1_) << 32) | d2_; }
     unsigned rows() const { return (d0_>>4) & 0xF; }
     unsigned cols() const { return (d0_>>8) & 0xF; }
     bool applicable(unsigned rows, unsigned cols, Problem::action_t a) const {
@@ -164,7 +164,7 @@ inline std::ostream& operator<<(std::ostream &os, const state_t &s) {
     return os;
 }
 
-class problem_t : public Problem::problem_t<state_t> {
+class problem_t final : public Problem::static_problem_t<state_t, problem_t> {
     unsigned rows_;
     unsigned cols_;
     float p_;
@@ -173,7 +173,7 @@ class problem_t : public Problem::problem_t<state_t> {
 
   public:
     problem_t(unsigned rows, unsigned cols, const state_t &init, float p = 1.0)
-      : Problem::problem_t<state_t>(),
+      : Problem::static_problem_t<state_t, problem_t>(),
         rows_(rows), cols_(cols), p_(p), init_(init) {
         goal_.set_goal(rows_, cols_);
     }
@@ -223,6 +223,17 @@ class problem_t : public Problem::problem_t<state_t> {
             outcomes.push_back(std::make_pair(s, 1 - p_));
         }
     }
+    virtual size_t state_size() const { return 3 * sizeof(unsigned); }
+    virtual void serialize(const state_t &s, char *bytes) const {
+        unsigned fields[] = { s.d0_, s.d1_, s.d2_ };
+        memcpy(bytes, fields, sizeof(fields));
+    }
+    virtual bool deserialize(const char *bytes, state_t &s) const {
+        unsigned fields[3];
+        memcpy(fields, bytes, sizeof(fields));
+        s = state_t(fields[0], fields[1], fields[2]);
+        return true;
+    }
     virtual void print(std::ostream &os) const { }
 };
 
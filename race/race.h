@@ -35,7 +35,8 @@ class state_t {
     short dy() const { return dy_; }
 
     size_t hash() const {
-        return (x_ | (y_<<16)) ^ (dx_ | (dy_<<16));
+        return size_t((unsigned short)x_) | (size_t((unsigned short)y_) << 16) |
+               (size_t((unsigned short)dx_) << 32) | (size_t((unsigned short)dy_) << 48);
     }
 
     const state_t& operator=(const state_t &s) {
@@ -71,7 +72,7 @@ inline std::ostream& operator<<(std::ostream &os, const state_t &s) {
 class ecache_t : public std::unordered_map<size_t, std::pair<state_t, state_t> > { };
 //class ecache_t : public map<size_t,pair<state_t,state_t> > { };
 
-class problem_t : public Problem::problem_t<state_t> {
+class problem_t final : public Problem::static_problem_t<state_t, problem_t> {
     const grid_t &grid_;
     float p_;
     size_t rows_;
@@ -80,13 +81,15 @@ class problem_t : public Problem::problem_t<state_t> {
     std::vector<state_t> inits_;
     std::vector<state_t> goals_;
     mutable ecache_t *ecache_[9];
+    bool caching_;
 
   public:
-    problem_t(grid_t &grid, float p = 1.0, float dead_end_value = 1e3)
-      : Problem::problem_t<state_t>(DISCOUNT, dead_end_value),
+    problem_t(grid_t &grid, float p = 1.0, float dead_end_value = 1e3, bool caching = true)
+      : Problem::static_problem_t<state_t, problem_t>(DISCOUNT, dead_end_value),
         grid_(grid), p_(p), rows_(grid.rows()), cols_(grid.cols()),
         init_(std::numeric_limits<short>::max(), std::numeric_limits<short>::max(),
-              std::numeric_limits<short>::max(), std::numeric_limits<short>::max()) {
+              std::numeric_limits<short>::max(), std::numeric_limits<short>::max()),
+        caching_(caching) {
         for( size_t i = 0; i < grid_.starts().size(); ++i ) {
             size_t s = grid_.start(i);
             inits_.push_back(state_t(s / cols_, s % cols_));
@@ -138,7 +141,7 @@ class problem_t : public Problem::problem_t<state_t> {
             outcomes.reserve(2);
             size_t off = s.x() * cols_ + s.y();
             size_t key = (((unsigned short)s.dx()) << 16) | (unsigned short)s.dy();
-            ecache_t::const_iterator ci = ecache_[a][off].find(key);
+            ecache_t::const_iterator ci = caching_ ? ecache_[a][off].find(key) : ecache_[a][off].end();
             if( ci != ecache_[a][off].end() ) {
                 if( p_ > 0.0 ) {
                     outcomes.push_back(std::make_pair(ci->second.first, p_));
@@ -175,10 +178,32 @@ class problem_t : public Problem::problem_t<state_t> {
                     assert(grid_.valid_pos(entry.first.x(), entry.first.y()));
                     outcomes.push_back(std::make_pair(entry.second, 1 - p_));
                 }
-                ecache_[a][off].insert(std::make_pair(key, entry));
+                if( caching_ ) ecache_[a][off].insert(std::make_pair(key, entry));
             }
         }
     }
+    // the successor cache is filled by next()
+    virtual bool concurrent() const { return !caching_; }
+    virtual size_t state_size() const { return 4 * sizeof(short); }
+    virtual void serialize(const state_t &s, char *bytes) const {
+        short fields[] = { s.x_, s.y_, s.dx_, s.dy_ };
+        memcpy(bytes, fields, sizeof(fields));
+    }
+    virtual bool deserialize(const char *bytes, state_t &s) const {
+        short fields[4];
+        memcpy(fields, bytes, sizeof(fields));
+        s = state_t(fields[0], fields[1], fields[2], fields[3]);
+        return true;
+    }
+    virtual size_t num_states() const {
+        // speeds are bounded by the grid as every move ends in it; index 0
+        // is the initial state
+        return 1 + rows_ * cols_ * (2 * rows_ - 1) * (2 * cols_ - 1);
+    }
+    virtual size_t state_index(const state_t &s) const {
+        if( s == init_ ) return 0;
+        return 1 + ((s.x_ * cols_ + s.y_) * (2 * rows_ - 1) + (s.dx_ + rows_ - 1)) * (2 * cols_ - 1) + (s.dy_ + cols_ - 1);
+    }
     virtual void print(std::ostream &os) const { }
 };
 
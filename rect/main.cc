@@ -17,19 +17,25 @@ namespace Online {
 
 namespace Utils {
   bool g_use_colors = true;
+  unsigned g_timer_period = 1;
 };
 
 using namespace std;
 
 void usage(ostream &os) {
-    os << "usage: rect [--no-colors] [{-r | --request} <request>]* [{-s | --seed} <default-seed>] [{-t | --trials} <num-trials>] <x-dim> <y-dim> [<p>]" << endl;
+    os << "usage: rect [--no-colors] [{-r | --request} <request>]* [{-s | --seed} <default-seed>] [{-t | --trials} {<num-trials> | auto}] [--ci <confidence>] [--halfwidth <halfwidth>] [--max-trials <max-trials>] [{-j | --threads} <num-threads>] [--paired] [--timer-period <n>] [--perf] [--hash-stats] [--trace <file>] [--stats {json | csv}:{<file> | -}] [--checkpoint <file>] [--checkpoint-period <seconds>] <x-dim> <y-dim> [<p>]" << endl;
 }
 
 int main(int argc, const char **argv) {
     unsigned xdim = 0;
     unsigned ydim = 0;
     float p = 1.0;
-    unsigned num_trials = 1;
+    Online::Evaluation::trials_t trials;
+    unsigned num_threads = 0;
+    bool paired = false;
+    Stats::sink_t *sink = 0;
+    string checkpoint_filename;
+    float checkpoint_period = 600;
 
     vector<string> requests;
 
@@ -50,7 +56,58 @@ int main(int argc, const char **argv) {
             ++argv;
             --argc;
         } else if( ((*argv)[1] == 't') || (string(*argv) == "--trials") ) {
-            num_trials = strtoul(argv[1], 0, 0);
+            if( string(argv[1]) == "auto" )
+                trials.automatic_ = true;
+            else
+                trials.number_ = strtoul(argv[1], 0, 0);
+            ++argv;
+            --argc;
+        } else if( string(*argv) == "--ci" ) {
+            trials.confidence_ = strtod(argv[1], 0);
+            ++argv;
+            --argc;
+        } else if( string(*argv) == "--halfwidth" ) {
+            trials.halfwidth_ = strtod(argv[1], 0);
+            ++argv;
+            --argc;
+        } else if( string(*argv) == "--max-trials" ) {
+            trials.max_trials_ = strtoul(argv[1], 0, 0);
+            ++argv;
+            --argc;
+        } else if( ((*argv)[1] == 'j') || (string(*argv) == "--threads") ) {
+            num_threads = strtoul(argv[1], 0, 0);
+            ++argv;
+            --argc;
+        } else if( string(*argv) == "--paired" ) {
+            paired = true;
+        } else if( string(*argv) == "--timer-period" ) {
+            Utils::g_timer_period = strtoul(argv[1], 0, 0);
+            ++argv;
+            --argc;
+        } else if( string(*argv) == "--perf" ) {
+            if( !Perf::enable() )
+                cout << Utils::warning() << "perf: no hardware counters available; continuing without them" << endl;
+        } else if( string(*argv) == "--hash-stats" ) {
+            Hash::enable_stats();
+        } else if( string(*argv) == "--trace" ) {
+            Trace::enable(argv[1]);
+            ++argv;
+            --argc;
+        } else if( string(*argv) == "--stats" ) {
+            delete sink;
+            sink = Stats::make_sink(argv[1]);
+            if( sink == 0 ) {
+                cout << Utils::error() << "invalid stats sink '" << argv[1] << "' (expected json:<file> or csv:<file>)" << endl;
+                exit(-1);
+            }
+            ++argv;
+            --argc;
+        } else if( string(*argv) == "--checkpoint" ) {
+            checkpoint_filename = argv[1];
+            ++argv;
+            --argc;
+        } else if( string(*argv) == "--checkpoint-period" ) {
+            checkpoint_period = strtod(argv[1], 0);
             ++argv;
             --argc;
         } else {
@@ -58,6 +115,10 @@ int main(int argc, const char **argv) {
             exit(-1);
         }
     }
+    if( trials.automatic_ && ((trials.halfwidth_ <= 0) || (trials.confidence_ <= 0) || (trials.confidence_ >= 1)) ) {
+        cout << Utils::error() << "automatic number of trials requires --halfwidth > 0 and 0 < --ci < 1" << endl;
+        exit(-1);
+    }
 
     // read problem parameters
     if( argc >= 2 ) {
@@ -78,6 +139,8 @@ int main(int argc, const char **argv) {
     vector<pair<string, Online::Policy::policy_t<state_t>*> > policies;
     vector<pair<string, Algorithm::algorithm_t<state_t>*> > algorithms;
     Dispatcher::dispatcher_t<state_t> dispatcher;
+    dispatcher.set_stats_sink(sink);
+    dispatcher.set_checkpoint(checkpoint_filename, checkpoint_period);
     for( int i = 0; i < int(requests.size()); ++i ) {
         const string &request_str = requests[i];
         std::multimap<std::string, std::string> request;
@@ -113,12 +176,17 @@ int main(int argc, const char **argv) {
 
     // evaluate requested policies
     vector<Dispatcher::dispatcher_t<state_t>::evaluate_result_t> evaluate_results;
-    for( int i = 0; i < int(policies.size()); ++i ) {
-        const string &request = policies[i].first;
-        const Online::Policy::policy_t<state_t> &policy = *policies[i].second;
-        Dispatcher::dispatcher_t<state_t>::evaluate_result_t result;
-        dispatcher.evaluate(request, policy, problem.init(), result, num_trials, 100, true);
-        evaluate_results.push_back(result);
+    vector<Dispatcher::dispatcher_t<state_t>::paired_result_t> paired_results;
+    if( paired ) {
+        dispatcher.evaluate_paired(policies, problem.init(), evaluate_results, paired_results, trials, 100, true, num_threads);
+    } else {
+        for( int i = 0; i < int(policies.size()); ++i ) {
+            const string &request = policies[i].first;
+            const Online::Policy::policy_t<state_t> &policy = *policies[i].second;
+            Dispatcher::dispatcher_t<state_t>::evaluate_result_t result;
+            dispatcher.evaluate(request, policy, problem.init(), result, trials, 100, true, num_threads);
+            evaluate_results.push_back(result);
+        }
     }
 
     cout << Utils::warning() << "the following stats may aggregate figures when elements are shared among policies" << endl;
@@ -127,8 +195,13 @@ int main(int argc, const char **argv) {
             dispatcher.print_stats(cout, evaluate_results[i]);
         }
     }
+    for( int i = 0; i < int(paired_results.size()); ++i ) {
+        dispatcher.print_stats(cout, paired_results[i]);
+    }
 
     cout << "main: total-time=" << Utils::read_time_in_seconds() - start_time << endl;
+    Trace::finish();
+    delete sink;
     return 0;
 }
 
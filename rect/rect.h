@@ -19,7 +19,7 @@ class state_t {
     state_t(ushort_t row = 0, ushort_t col = 0) : row_(row), col_(col) { }
     state_t(const state_t &s) : row_(s.row_), col_(s.col_) { }
     ~state_t() { }
-    size_t hash() const { return row_ ^ col_; }
+    size_t hash() const { return (size_t(row_) << 16) | col_; }
     unsigned row() const { return row_; }
     unsigned col() const { return col_; }
     void fwd(unsigned rows) { if( row() < rows - 1 ) ++row_; }
@@ -50,7 +50,7 @@ inline std::ostream& operator<<(std::ostream &os, const state_t &s) {
     return os;
 }
 
-class problem_t : public Problem::problem_t<state_t> {
+class problem_t final : public Problem::static_problem_t<state_t, problem_t> {
     unsigned rows_;
     unsigned cols_;
     float p_;
@@ -111,6 +111,19 @@ class problem_t : public Problem::problem_t<state_t> {
             }
         }
     }
+    virtual size_t state_size() const { return 2 * sizeof(ushort_t); }
+    virtual void serialize(const state_t &s, char *bytes) const {
+        ushort_t fields[] = { s.row_, s.col_ };
+        memcpy(bytes, fields, sizeof(fields));
+    }
+    virtual bool deserialize(const char *bytes, state_t &s) const {
+        ushort_t fields[2];
+        memcpy(fields, bytes, sizeof(fields));
+        s = state_t(fields[0], fields[1]);
+        return true;
+    }
+    virtual size_t num_states() const { return rows_ * cols_; }
+    virtual size_t state_index(const state_t &s) const { return s.row_ * cols_ + s.col_; }
     virtual void print(std::ostream &os) const { }
 };
 
@@ -77,7 +77,7 @@ inline std::ostream& operator<<(std::ostream &os, const state_t &s) {
     return os;
 }
 
-class problem_t : public Problem::problem_t<state_t> {
+class problem_t final : public Problem::static_problem_t<state_t, problem_t> {
     int rows_;
     int cols_;
     float wind_transition_[64];
@@ -96,7 +96,7 @@ class problem_t : public Problem::problem_t<state_t> {
               int goal_x = std::numeric_limits<int>::max(),
               int goal_y = std::numeric_limits<int>::max(),
               float *wind_transition = 0, float *costs = 0)
-      : Problem::problem_t<state_t>(DISCOUNT),
+      : Problem::static_problem_t<state_t, problem_t>(DISCOUNT),
         rows_(rows), cols_(cols), init_(init_x, init_y), goal_(goal_x, goal_y) {
 
         if( (goal_x == std::numeric_limits<int>::max()) ||
@@ -172,6 +172,21 @@ class problem_t : public Problem::problem_t<state_t> {
             outcomes.push_back(std::make_pair(next_s, p.second));
         }
     }
+    virtual size_t state_size() const { return 3 * sizeof(short); }
+    virtual void serialize(const state_t &s, char *bytes) const {
+        short fields[] = { s.x_, s.y_, s.wind_ };
+        memcpy(bytes, fields, sizeof(fields));
+    }
+    virtual bool deserialize(const char *bytes, state_t &s) const {
+        short fields[3];
+        memcpy(fields, bytes, sizeof(fields));
+        s = state_t(fields[0], fields[1], fields[2]);
+        return true;
+    }
+    virtual size_t num_states() const { return rows_ * cols_ * 8; }
+    virtual size_t state_index(const state_t &s) const {
+        return (s.x_ * cols_ + s.y_) * 8 + s.wind_;
+    }
     virtual void print(std::ostream &os) const { }
 };
 
@@ -34,7 +34,7 @@ class state_t {
     state_t() : data1_(0), data2_(0) { }
     state_t(const state_t &s) : data1_(s.data1_), data2_(s.data2_) { }
     ~state_t() { }
-    size_t hash() const { return data1_ ^ data2_; }
+    size_t hash() const { return (size_t(data1_) << 32) | data2_; }
     unsigned depth() const { return data1_ >> 26; }
     unsigned branch1() const { return data1_ & ~(63 << 26); }
     std::pair<unsigned, unsigned> branch() const {
@@ -108,7 +108,7 @@ inline std::ostream& operator<<(std::ostream &os, const state_t &s) {
     return os;
 }
 
-class problem_t : public Problem::problem_t<state_t> {
+class problem_t final : public Problem::static_problem_t<state_t, problem_t> {
     unsigned n_;
     float p_;
     float q_;
@@ -186,6 +186,18 @@ class problem_t : public Problem::problem_t<state_t> {
             if( 1 - p > 0 ) outcomes[j++].first.onebwd();
         }
     }
+    virtual size_t state_size() const { return 2 * sizeof(unsigned); }
+    virtual void serialize(const state_t &s, char *bytes) const {
+        unsigned fields[] = { s.data1_, s.data2_ };
+        memcpy(bytes, fields, sizeof(fields));
+    }
+    virtual bool deserialize(const char *bytes, state_t &s) const {
+        unsigned fields[2];
+        memcpy(fields, bytes, sizeof(fields));
+        s.data1_ = fields[0];
+        s.data2_ = fields[1];
+        return true;
+    }
     virtual void print(std::ostream &os) const { }
 };
 
@@ -79,7 +79,7 @@ inline std::ostream& operator<<(std::ostream &os, const state_t &s) {
     return os;
 }
 
-class problem_t : public Problem::problem_t<state_t> {
+class problem_t final : public Problem::static_problem_t<state_t, problem_t> {
     size_t size_;
     state_t init_;
     state_t goal_;
@@ -93,7 +93,7 @@ class problem_t : public Problem::problem_t<state_t> {
         for( size_t x = 0; x < size_; ++x )
             for( size_t y = 0; y < size_; ++y )
                 if( Random::real() < p_ )
-                    water_[(x * size_) + y] = 1 + (lrand48() % (XVER ? 2 : 3));
+                    water_[(x * size_) + y] = 1 + Random::random(XVER ? 2 : 3);
     }
     virtual ~problem_t() { delete[] water_; }
     size_t size() const { return size_; }
@@ -153,6 +153,19 @@ class problem_t : public Problem::problem_t<state_t> {
             if( e2 > 0.0 ) outcomes.push_back(std::make_pair(s, 2 * e2));                              // kappa = 2
         }
     }
+    virtual size_t state_size() const { return 1 * sizeof(unsigned); }
+    virtual void serialize(const state_t &s, char *bytes) const {
+        unsigned fields[] = { s.s_ };
+        memcpy(bytes, fields, sizeof(fields));
+    }
+    virtual bool deserialize(const char *bytes, state_t &s) const {
+        unsigned fields[1];
+        memcpy(fields, bytes, sizeof(fields));
+        s = state_t(fields[0]);
+        return true;
+    }
+    virtual size_t num_states() const { return size_ * size_; }
+    virtual size_t state_index(const state_t &s) const { return s.s_; }
     virtual void print(std::ostream &os) const {
         os << "size = " << size_ << std::endl
            << "init = " << init_ << std::endl